@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+#  File Name: bench-converge.sh
+#
+#  Purpose: Measures convergence of generated topologies in the simulator. For each
+#  topology and size the routers first converge from a cold start, then the cheapest
+#  link of the topology, the one most likely to carry shortest paths, fails and they
+#  converge again around it.
+#
+#  Usage: bench-converge.sh [routers ...]   (default 10 100 1000)
+#
+#  TOPOLOGIES overrides the topologies run, SIM_FLAGS is passed on to sim, for
+#  example SIM_FLAGS="-p 1000" to add periodic full updates. The CSV goes to stdout,
+#  converge_ms of the link-failure rows counts from the failure.
+
+SIZES=${*:-"10 100 1000"}
+TOPOLOGIES=${TOPOLOGIES:-"ring grid random scalefree"}
+SIM_FLAGS=${SIM_FLAGS:-"-p 0"}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+echo "topology,scenario,routers,links,converge_ms,messages,bytes,lost,table_changes,wall_ms"
+for topology in $TOPOLOGIES; do
+    for routers in $SIZES; do
+        "$DIR/topogen" "$topology" "$routers" 1 > "$TMP/topology" || exit 1
+        awk 'NR > 1 && (cost == "" || $3 < cost) { cost = $3; link = $1 " " $2 }
+             END { print "0 down " link }' "$TMP/topology" > "$TMP/script"
+        "$DIR/sim" $SIM_FLAGS -S "$TMP/script" "$TMP/topology" > "$TMP/result" || exit 1
+        sed -n -e "s/^initial,/$topology,cold-start,/p" -e "s/^events,/$topology,link-failure,/p" "$TMP/result"
+    done
+done
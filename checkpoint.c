@@ -0,0 +1,222 @@
+  /*
+   *  File Name: checkpoint.c
+   *
+   *  Purpose: Saves the routing table and neighbor state to the memory mapped
+   *  file of checkpoint.h, a route at a time as the table changes.
+   */
+
+
+#include "ne.h"
+#include "router.h"
+#include "checkpoint.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NO_RECORD -1 /* marks an unused bucket in the dest_id index */
+
+// Bytes of a file with room for capacity routes
+static size_t CheckpointBytes(unsigned int capacity)
+{
+    return sizeof(struct checkpoint_header) + (size_t)capacity * sizeof(struct checkpoint_route);
+}
+
+// Sizes the file to size bytes and maps it again
+static int MapCheckpoint(struct checkpoint *checkpoint, size_t size)
+{
+    if (checkpoint->header != NULL)
+    {
+        munmap(checkpoint->header, checkpoint->size);
+        checkpoint->header = NULL;
+    }
+    if (ftruncate(checkpoint->fd, size) < 0)
+    {
+        return -1;
+    }
+    void *mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, checkpoint->fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+        return -1;
+    }
+    checkpoint->size = size;
+    checkpoint->header = mapped;
+    checkpoint->routes = (struct checkpoint_route *)(checkpoint->header + 1);
+    return 0;
+}
+
+// Tells whether the mapped file holds a checkpoint of this router that is safe to read back.
+// The index masks hashes with twice the capacity, so the capacity must be a power of two.
+static int IsRestorable(const struct checkpoint *checkpoint, int myID)
+{
+    const struct checkpoint_header *header = checkpoint->header;
+    return header->magic == CHECKPOINT_MAGIC && header->router_id == (unsigned int)myID &&
+           header->no_nbr <= MAX_ROUTERS && header->no_routes <= header->capacity &&
+           header->capacity > 0 && (header->capacity & (header->capacity - 1)) == 0 &&
+           CheckpointBytes(header->capacity) <= checkpoint->size;
+}
+
+// Fibonacci hash of a router id into the index
+static unsigned int HashDest(const struct checkpoint *checkpoint, unsigned int dest_id)
+{
+    return (dest_id * 2654435761u) & checkpoint->index_mask;
+}
+
+// Rebuilds the index over the records in use, with room for twice capacity
+static void BuildIndex(struct checkpoint *checkpoint)
+{
+    free(checkpoint->index);
+    checkpoint->index_mask = 2 * checkpoint->header->capacity - 1;
+    checkpoint->index = malloc(2 * (size_t)checkpoint->header->capacity * sizeof(int));
+    if (checkpoint->index == NULL)
+    {
+        printf("Failed to index a checkpoint of %u routes\n", checkpoint->header->capacity);
+        exit(EXIT_FAILURE);
+    }
+    memset(checkpoint->index, 0xff, 2 * (size_t)checkpoint->header->capacity * sizeof(int));
+    unsigned int record;
+    for (record = 0; record < checkpoint->header->no_routes; record++)
+    {
+        unsigned int bucket = HashDest(checkpoint, checkpoint->routes[record].dest_id);
+        while (checkpoint->index[bucket] != NO_RECORD)
+        {
+            bucket = (bucket + 1) & checkpoint->index_mask;
+        }
+        checkpoint->index[bucket] = record;
+    }
+}
+
+// Writes one route over its record, appending a record for a destination not saved yet
+static void SaveRoute(struct checkpoint *checkpoint, const struct route_entry *route)
+{
+    unsigned int bucket = HashDest(checkpoint, route->dest_id);
+    while (checkpoint->index[bucket] != NO_RECORD &&
+           checkpoint->routes[checkpoint->index[bucket]].dest_id != route->dest_id)
+    {
+        bucket = (bucket + 1) & checkpoint->index_mask;
+    }
+    if (checkpoint->index[bucket] == NO_RECORD)
+    {
+        struct checkpoint_header *header = checkpoint->header;
+        if (header->no_routes == header->capacity)
+        {
+            unsigned int capacity = 2 * header->capacity;
+            if (MapCheckpoint(checkpoint, CheckpointBytes(capacity)) < 0)
+            {
+                printf("Failed to grow the checkpoint to %u routes with errno: %d\n", capacity, errno);
+                exit(EXIT_FAILURE);
+            }
+            checkpoint->header->capacity = capacity;
+            BuildIndex(checkpoint);
+            SaveRoute(checkpoint, route);
+            return;
+        }
+        checkpoint->routes[header->no_routes].dest_id = route->dest_id;
+        checkpoint->index[bucket] = header->no_routes;
+        header->no_routes += 1;
+    }
+    struct checkpoint_route *record = &checkpoint->routes[checkpoint->index[bucket]];
+    record->next_hop = route->next_hop;
+    record->cost = route->cost;
+}
+
+struct checkpoint *CheckpointOpen(const char *fileName, int myID)
+{
+    struct checkpoint *checkpoint = calloc(1, sizeof(struct checkpoint));
+    if (checkpoint == NULL)
+    {
+        return NULL;
+    }
+    struct stat fileStat;
+    checkpoint->fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if (checkpoint->fd < 0 || fstat(checkpoint->fd, &fileStat) < 0)
+    {
+        free(checkpoint);
+        return NULL;
+    }
+
+    // A file too short for a header is started over
+    size_t size = fileStat.st_size;
+    if (size < CheckpointBytes(CHECKPOINT_INITIAL_ROUTES))
+    {
+        size = CheckpointBytes(CHECKPOINT_INITIAL_ROUTES);
+    }
+    if (MapCheckpoint(checkpoint, size) < 0)
+    {
+        close(checkpoint->fd);
+        free(checkpoint);
+        return NULL;
+    }
+    checkpoint->restorable = (size_t)fileStat.st_size >= sizeof(struct checkpoint_header) &&
+                             IsRestorable(checkpoint, myID);
+    if (!checkpoint->restorable)
+    {
+        // Anything else in the file is started over at the initial size
+        if (size != CheckpointBytes(CHECKPOINT_INITIAL_ROUTES) &&
+            MapCheckpoint(checkpoint, CheckpointBytes(CHECKPOINT_INITIAL_ROUTES)) < 0)
+        {
+            close(checkpoint->fd);
+            free(checkpoint);
+            return NULL;
+        }
+        memset(checkpoint->header, 0, sizeof(struct checkpoint_header));
+        checkpoint->header->magic = CHECKPOINT_MAGIC;
+        checkpoint->header->router_id = myID;
+        checkpoint->header->capacity = CHECKPOINT_INITIAL_ROUTES;
+    }
+    return checkpoint;
+}
+
+int CheckpointSync(struct checkpoint *checkpoint, const struct checkpoint_nbr *nbrs, int no_nbr)
+{
+    struct checkpoint_header *header = checkpoint->header;
+    unsigned int tableVersion = GetTableVersion();
+    unsigned int sinceVersion = checkpoint->version;
+
+    // The first sync, or one after the table was initialized again, rewrites every route. The
+    // neighbor states go first, they vouch for routes that are about to be replaced.
+    if (checkpoint->index == NULL || tableVersion < checkpoint->version)
+    {
+        header->no_nbr = 0;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        header->no_routes = 0;
+        BuildIndex(checkpoint);
+        checkpoint->restorable = 0;
+        sinceVersion = 0;
+    }
+
+    // Routes come off the change list a fragment at a time
+    int written = 0;
+    if (tableVersion != sinceVersion)
+    {
+        struct pkt_RT_UPDATE changes;
+        int routeCount = CountRouteChanges(sinceVersion);
+        int cursor = -1;
+        while (written < routeCount)
+        {
+            int changeCount = ConvertChangestoFragment(&changes, 0, sinceVersion, &cursor);
+            if (changeCount == 0)
+                break;
+            int i;
+            for (i = 0; i < changeCount; i++)
+            {
+                SaveRoute(checkpoint, &changes.route[i]);
+            }
+            written += changeCount;
+        }
+        checkpoint->version = tableVersion;
+        header = checkpoint->header;
+    }
+
+    // Only once the routes are in may the neighbor states claim them
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    memcpy(header->nbrs, nbrs, no_nbr * sizeof(struct checkpoint_nbr));
+    header->no_nbr = no_nbr;
+    return written;
+}
+
+void CheckpointClose(struct checkpoint *checkpoint)
+{
+    munmap(checkpoint->header, checkpoint->size);
+    close(checkpoint->fd);
+    free(checkpoint->index);
+    free(checkpoint);
+}
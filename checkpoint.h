@@ -0,0 +1,85 @@
+/*checkpoint.h*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+  /*
+   *  File Name: checkpoint.h
+   *
+   *  Purpose: Keeps the routing table and the neighbor state in a memory mapped
+   *  file so a restarted router can pick up where it left off (router -w). Like the
+   *  FIB it follows the routing table's change list, so a sync writes the routes
+   *  changed since the previous one. Writes land in the page cache as they are
+   *  made, the file survives the router being killed at any point, not the host
+   *  going down.
+   *
+   *  The file is a checkpoint_header followed by capacity checkpoint_route records,
+   *  no_routes of them in use. Words are in host byte order. Neighbor states are
+   *  written after the routes they vouch for, so a router killed mid sync leaves
+   *  at worst an older applied_version, never a newer one.
+   */
+
+#define CHECKPOINT_MAGIC 0x54504b43 /* "CKPT" */
+#define CHECKPOINT_INITIAL_ROUTES 1024 /* routes a new file has room for, the file doubles as the table grows */
+
+struct checkpoint_nbr {
+  unsigned int nbr; /* neighbor id */
+  unsigned int cost; /* link cost to the neighbor */
+  unsigned int epoch; /* epoch the neighbor last announced */
+  unsigned int applied_version; /* last version of the neighbor's table the saved routes hold */
+};
+
+struct checkpoint_header {
+  unsigned int magic; /* CHECKPOINT_MAGIC */
+  unsigned int router_id; /* router that wrote the file */
+  unsigned int capacity; /* checkpoint_route records the file has room for */
+  unsigned int no_routes; /* records in use */
+  unsigned int no_nbr; /* entries of nbrs in use */
+  struct checkpoint_nbr nbrs[MAX_ROUTERS];
+};
+
+struct checkpoint_route {
+  unsigned int dest_id; /* destination router id */
+  unsigned int next_hop; /* next hop to dest_id */
+  unsigned int cost; /* cost to dest_id */
+};
+
+struct checkpoint {
+  int fd; /* the file */
+  size_t size; /* bytes mapped */
+  struct checkpoint_header *header; /* the mapped file */
+  struct checkpoint_route *routes; /* records behind the header */
+  int restorable; /* 1 while the file still holds the checkpoint it was opened with */
+  unsigned int version; /* routing table version saved */
+  int *index; /* open addressed dest_id -> record, kept at most half full */
+  unsigned int index_mask;
+};
+
+/* Routine Name    : CheckpointOpen
+ * INPUT ARGUMENTS : 1. (const char *) - Name of the checkpoint file, created if it does not exist
+ *                   2. int - My router's id
+ * RETURN VALUE    : struct checkpoint * - The mapped checkpoint, NULL if the file could not be mapped
+ * USAGE           : If the file holds a checkpoint of this router, restorable is set and header and
+ *                   routes may be read back until the first CheckpointSync replaces them.
+ */
+struct checkpoint *CheckpointOpen(const char *fileName, int myID);
+
+/* Routine Name    : CheckpointSync
+ * INPUT ARGUMENTS : 1. (struct checkpoint *) - The checkpoint
+ *                   2. (const struct checkpoint_nbr *) - State of every neighbor
+ *                   3. int - The number of neighbors, at most MAX_ROUTERS
+ * RETURN VALUE    : int - The number of routes written
+ * USAGE           : Saves the routes of the selected routing context changed since the previous sync,
+ *                   every route the first time or after InitRoutingTbl, then the neighbor states.
+ *                   Costs a few word copies when the table has not changed.
+ */
+int CheckpointSync(struct checkpoint *checkpoint, const struct checkpoint_nbr *nbrs, int no_nbr);
+
+/* Routine Name    : CheckpointClose
+ * INPUT ARGUMENTS : 1. (struct checkpoint *) - The checkpoint
+ * RETURN VALUE    : void
+ * USAGE           : Unmaps the file, which keeps the last sync for the next warm start.
+ */
+void CheckpointClose(struct checkpoint *checkpoint);
+
+#endif
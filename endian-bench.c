@@ -0,0 +1,101 @@
+  /*
+   *  File Name: endian-bench.c
+   *
+   *  Purpose: Measures the byte order conversion of full RT_UPDATE packets and of
+   *  a large route array with every swap kernel the CPU supports.
+   *
+   *  Usage: endian-bench [routes]
+   */
+
+
+#include <time.h>
+#include "ne.h"
+
+#define DEFAULT_ROUTES 100000
+#define MIN_RUN_NS 200000000LL /* each measurement runs for at least 0.2 s */
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Returns the ns per round trip (ntoh + hton) of a packet carrying ROUTES_PER_PKT routes
+static double benchPacket(void)
+{
+    struct pkt_RT_UPDATE pkt;
+    bzero((char *)&pkt, sizeof(pkt));
+    pkt.no_routes = htonl(ROUTES_PER_PKT);
+
+    long long iterations = 0;
+    long long start = nowNs();
+    long long elapsed;
+    do
+    {
+        int i;
+        for (i = 0; i < 1000; i++)
+        {
+            ntoh_pkt_RT_UPDATE(&pkt);
+            hton_pkt_RT_UPDATE(&pkt);
+        }
+        iterations += 1000;
+        elapsed = nowNs() - start;
+    } while (elapsed < MIN_RUN_NS);
+    return (double)elapsed / iterations;
+}
+
+// Returns the ns per route of swapping a route array in bulk
+static double benchRoutes(struct route_entry *routes, int routeCount)
+{
+    int words = routeCount * (sizeof(struct route_entry) / sizeof(unsigned int));
+    long long iterations = 0;
+    long long start = nowNs();
+    long long elapsed;
+    do
+    {
+        swap_words((unsigned int *)routes, words);
+        iterations += 1;
+        elapsed = nowNs() - start;
+    } while (elapsed < MIN_RUN_NS);
+    return (double)elapsed / iterations / routeCount;
+}
+
+int main(int argc, char *argv[])
+{
+    int routeCount = (argc > 1) ? atoi(argv[1]) : DEFAULT_ROUTES;
+    if (routeCount <= 0)
+    {
+        printf("Usage: endian-bench [routes]\n");
+        return EXIT_FAILURE;
+    }
+    struct route_entry *routes = calloc(routeCount, sizeof(struct route_entry));
+    if (routes == NULL)
+    {
+        printf("Failed to allocate %d routes\n", routeCount);
+        return EXIT_FAILURE;
+    }
+
+    const int kernels[] = {SWAP_KERNEL_SCALAR, SWAP_KERNEL_SSSE3, SWAP_KERNEL_AVX2};
+    double scalarPacket = 0, scalarRoute = 0;
+    int k;
+    printf("kernel,packet_ns,route_ns,packet_speedup,route_speedup\n");
+    for (k = 0; k < (int)(sizeof(kernels) / sizeof(kernels[0])); k++)
+    {
+        if (!select_swap_kernel(kernels[k]))
+        {
+            continue;
+        }
+        double packetNs = benchPacket();
+        double routeNs = benchRoutes(routes, routeCount);
+        if (kernels[k] == SWAP_KERNEL_SCALAR)
+        {
+            scalarPacket = packetNs;
+            scalarRoute = routeNs;
+        }
+        printf("%s,%.1f,%.3f,%.2f,%.2f\n", swap_kernel_name(), packetNs, routeNs,
+               scalarPacket / packetNs, scalarRoute / routeNs);
+    }
+    free(routes);
+    return EXIT_SUCCESS;
+}
@@ -10,20 +10,188 @@
 
 #include "ne.h"
 
+/* Every field of the packets is a 32 bit word, so whole arrays can be swapped in bulk */
+_Static_assert(sizeof(struct route_entry) % sizeof(unsigned int) == 0, "route_entry must hold only 32 bit words");
+_Static_assert(sizeof(struct nbr_cost) == 2 * sizeof(unsigned int), "nbr_cost must hold only 32 bit words");
+
+#define ROUTE_WORDS ((int)(sizeof(struct route_entry) / sizeof(unsigned int)))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SWAP_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SWAP_HOST_IS_NETWORK 1 /* host order is network order, nothing to swap */
+#endif
+
+static void swap_words_scalar (unsigned int *words, int count) {
+
+	int i;
+	for (i = 0; i < count; i++) {
+		words[i] = htonl(words[i]);
+	}
+}
+
+#ifdef SWAP_HAVE_X86
+/* pshufb mask that reverses the bytes of each 32 bit lane */
+#define SWAP_SHUFFLE 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+
+__attribute__((target("ssse3")))
+static void swap_words_ssse3 (unsigned int *words, int count) {
+
+	const __m128i shuffle = _mm_set_epi8(SWAP_SHUFFLE);
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&words[i]);
+		_mm_storeu_si128((__m128i *)&words[i], _mm_shuffle_epi8(v, shuffle));
+	}
+	swap_words_scalar(&words[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static void swap_words_avx2 (unsigned int *words, int count) {
+
+	const __m256i shuffle = _mm256_set_epi8(SWAP_SHUFFLE, SWAP_SHUFFLE);
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *)&words[i]);
+		__m256i v1 = _mm256_loadu_si256((const __m256i *)&words[i + 8]);
+		_mm256_storeu_si256((__m256i *)&words[i], _mm256_shuffle_epi8(v0, shuffle));
+		_mm256_storeu_si256((__m256i *)&words[i + 8], _mm256_shuffle_epi8(v1, shuffle));
+	}
+	for (; i + 8 <= count; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)&words[i]);
+		_mm256_storeu_si256((__m256i *)&words[i], _mm256_shuffle_epi8(v, shuffle));
+	}
+	/* Finish here rather than in the SSSE3 kernel so no legacy SSE code runs with the upper lanes dirty */
+	if (i + 4 <= count) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&words[i]);
+		_mm_storeu_si128((__m128i *)&words[i], _mm_shuffle_epi8(v, _mm256_castsi256_si128(shuffle)));
+		i += 4;
+	}
+	swap_words_scalar(&words[i], count - i);
+}
+#endif
+
+static void swap_words_auto (unsigned int *words, int count);
+
+/* Kernel swap_words runs on, resolved on the first call */
+static void (*swap_kernel) (unsigned int *, int) = swap_words_auto;
+static const char *swap_kernel_label = "scalar";
+
+/* Picks the fastest kernel the CPU supports and runs it */
+static void swap_words_auto (unsigned int *words, int count) {
+
+	select_swap_kernel(SWAP_KERNEL_AUTO);
+	swap_kernel(words, count);
+}
+
+int select_swap_kernel (int kernel) {
+
+	if (kernel == SWAP_KERNEL_AUTO) {
+		return select_swap_kernel(SWAP_KERNEL_AVX2) || select_swap_kernel(SWAP_KERNEL_SSSE3) ||
+		       select_swap_kernel(SWAP_KERNEL_SCALAR);
+	}
+	switch (kernel) {
+	case SWAP_KERNEL_SCALAR:
+		swap_kernel = swap_words_scalar;
+		swap_kernel_label = "scalar";
+		return 1;
+#ifdef SWAP_HAVE_X86
+	case SWAP_KERNEL_SSSE3:
+		if (!__builtin_cpu_supports("ssse3"))
+			return 0;
+		swap_kernel = swap_words_ssse3;
+		swap_kernel_label = "ssse3";
+		return 1;
+	case SWAP_KERNEL_AVX2:
+		if (!__builtin_cpu_supports("avx2"))
+			return 0;
+		swap_kernel = swap_words_avx2;
+		swap_kernel_label = "avx2";
+		return 1;
+#endif
+	default:
+		return 0;
+	}
+}
+
+const char *swap_kernel_name (void) {
+
+	if (swap_kernel == swap_words_auto)
+		select_swap_kernel(SWAP_KERNEL_AUTO);
+	return swap_kernel_label;
+}
+
+void swap_words (unsigned int *words, int count) {
+
+#ifndef SWAP_HOST_IS_NETWORK
+	if (count > 0)
+		swap_kernel(words, count);
+#endif
+}
+
+size_t size_pkt_RT_UPDATE (const struct pkt_RT_UPDATE *upd) {
+
+	if (upd->no_routes > ROUTES_PER_PKT)
+		return 0;
+	size_t size = RT_UPDATE_PKTSIZE(upd->no_routes);
+#ifdef PATHVECTOR
+	/* Paths may share words, the one ending furthest out sets the size */
+	unsigned int space = RT_UPDATE_WORDS - upd->no_routes * ROUTE_WORDS;
+	unsigned int end = 0;
+	unsigned int i;
+	for (i = 0; i < upd->no_routes; i++) {
+		const struct route_entry *route = &upd->route[i];
+		if (route->path_len > space || route->path > space - route->path_len)
+			return 0;
+		if (route->path + route->path_len > end)
+			end = route->path + route->path_len;
+	}
+	size += end * sizeof(unsigned int);
+#endif
+	return size;
+}
+
+/* Words of path hops behind the routes of a packet in host byte order, none if a path is out of bounds */
+static int path_words (const struct pkt_RT_UPDATE *upd) {
+
+	size_t size = size_pkt_RT_UPDATE(upd);
+	return (size == 0) ? 0 : (int)((size - RT_UPDATE_PKTSIZE(upd->no_routes)) / sizeof(unsigned int));
+}
+
 /*
  *  This function converts struct pkt_INIT_RESPONSE
  *  from network to host byte order.
  */
 void ntoh_pkt_INIT_RESPONSE (struct pkt_INIT_RESPONSE *ne_resp) {
 
-	int i;
-
 	ne_resp->no_nbr = ntohl(ne_resp->no_nbr);
 
-	for(i=0;i<(ne_resp->no_nbr);i++) {
-		(ne_resp->nbrcost[i]).nbr = ntohl((ne_resp->nbrcost[i]).nbr);
-		(ne_resp->nbrcost[i]).cost = ntohl((ne_resp->nbrcost[i]).cost);
-	}
+	/* no_nbr came off the wire, never convert past the end of nbrcost[] */
+	int no_nbr = (ne_resp->no_nbr < MAX_ROUTERS) ? ne_resp->no_nbr : MAX_ROUTERS;
+	swap_words((unsigned int *)ne_resp->nbrcost, 2 * no_nbr);
+}
+
+/*
+ *  This function converts struct pkt_LINK_COST
+ *  between host and network byte order.
+ */
+void swap_pkt_LINK_COST (struct pkt_LINK_COST *link_cost) {
+
+	link_cost->router_id = htonl(link_cost->router_id);
+	link_cost->nbr = htonl(link_cost->nbr);
+	link_cost->cost = htonl(link_cost->cost);
+}
+
+/*
+ *  This function converts struct pkt_HEARTBEAT
+ *  between host and network byte order.
+ */
+void swap_pkt_HEARTBEAT (struct pkt_HEARTBEAT *heartbeat) {
+
+	swap_words((unsigned int *)heartbeat, sizeof(struct pkt_HEARTBEAT) / sizeof(unsigned int));
 }
 
 /*
@@ -32,17 +200,10 @@ void ntoh_pkt_INIT_RESPONSE (struct pkt_INIT_RESPONSE *ne_resp) {
  */
 void hton_pkt_RT_UPDATE (struct pkt_RT_UPDATE *send_upd) {
 
-	  int i;
-	  send_upd->sender_id = htonl (send_upd->sender_id);
-	  send_upd->dest_id = htonl (send_upd->dest_id);
-
-	  for (i = 0; i < send_upd->no_routes; i++)
-	  {
-	    (send_upd->route[i]).dest_id = htonl ((send_upd->route[i]).dest_id);
-	    (send_upd->route[i]).next_hop = htonl ((send_upd->route[i]).next_hop);
-	    (send_upd->route[i]).cost = htonl ((send_upd->route[i]).cost);
-	  }
-	  send_upd->no_routes = htonl (send_upd->no_routes);
+	  /* The route count is still needed in host order to size the route array */
+	  int no_routes = (send_upd->no_routes < ROUTES_PER_PKT) ? send_upd->no_routes : ROUTES_PER_PKT;
+	  swap_words((unsigned int *)send_upd->route, no_routes * ROUTE_WORDS + path_words(send_upd));
+	  swap_words((unsigned int *)send_upd, RT_UPDATE_HDRSIZE / sizeof(unsigned int));
 }
 
 /*
@@ -51,17 +212,10 @@ void hton_pkt_RT_UPDATE (struct pkt_RT_UPDATE *send_upd) {
  */
 void ntoh_pkt_RT_UPDATE (struct pkt_RT_UPDATE *recv_upd) {
 
-	  int i = 0;
-	  recv_upd->sender_id = ntohl (recv_upd->sender_id);
-	  recv_upd->dest_id = ntohl (recv_upd->dest_id);
-	  recv_upd->no_routes = ntohl (recv_upd->no_routes);
-
-	  for (i = 0; i < recv_upd->no_routes; i++)
-	  {
-	    (recv_upd->route[i]).dest_id = ntohl ((recv_upd->route[i]).dest_id);
-	    (recv_upd->route[i]).next_hop = ntohl ((recv_upd->route[i]).next_hop);
-	    (recv_upd->route[i]).cost = ntohl ((recv_upd->route[i]).cost);
-	  }
+	  swap_words((unsigned int *)recv_upd, RT_UPDATE_HDRSIZE / sizeof(unsigned int));
 
+	  /* no_routes came off the wire, never convert past the end of route[] */
+	  int no_routes = (recv_upd->no_routes < ROUTES_PER_PKT) ? recv_upd->no_routes : ROUTES_PER_PKT;
+	  swap_words((unsigned int *)recv_upd->route, no_routes * ROUTE_WORDS);
+	  swap_words(RT_UPDATE_PATHS(recv_upd), path_words(recv_upd));
 }
-
@@ -0,0 +1,165 @@
+  /*
+   *  File Name: fib-bench.c
+   *
+   *  Purpose: Measures FIB lookups per second with 1, 2, 4 ... reader threads
+   *  while the main thread keeps changing routes and syncing the FIB, so the
+   *  numbers include readers racing the writer.
+   *
+   *  Usage: fib-bench [routes] [max threads]
+   */
+
+
+#include <time.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include "ne.h"
+#include "router.h"
+#include "fib.h"
+
+#define DEFAULT_ROUTES 100000
+#define MIN_RUN_NS 500000000LL /* each thread count runs for 0.5 s */
+#define LOOKUP_BATCH 4096 /* lookups between two checks of the stop flag */
+
+// Struct of what one reader thread did
+typedef struct
+{
+    pthread_t thread;
+    unsigned long long seed;
+    unsigned long long lookups;
+    unsigned long long hopSum; // keeps the lookups from being optimized away
+} reader;
+
+extern int NumRoutes;
+
+static struct fib *Fib;
+static int NumDests;
+static int Stop;
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Looks up random destinations until Stop is set
+static void *readLoop(void *arg)
+{
+    reader *self = arg;
+    unsigned long long state = self->seed;
+    unsigned long long lookups = 0;
+    unsigned long long hopSum = 0;
+    while (!__atomic_load_n(&Stop, __ATOMIC_RELAXED))
+    {
+        int i;
+        for (i = 0; i < LOOKUP_BATCH; i++)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            hopSum += FibLookup(Fib, (unsigned int)(state % NumDests));
+        }
+        lookups += LOOKUP_BATCH;
+    }
+    self->lookups = lookups;
+    self->hopSum = hopSum;
+    return NULL;
+}
+
+// Moves ten routes between cost 1 and 2 through neighbor 1 and syncs the FIB, returns the routes applied
+static int churn(int round)
+{
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 1;
+    updpkt.dest_id = 0;
+    updpkt.no_routes = MAX_ROUTERS;
+    int j;
+    for (j = 0; j < MAX_ROUTERS; j++)
+    {
+        updpkt.route[j].dest_id = 3 + (round * MAX_ROUTERS + j) % (NumDests - 3);
+        updpkt.route[j].next_hop = 1;
+        updpkt.route[j].cost = 1 + (round / ((NumDests - 3) / MAX_ROUTERS + 1)) % 2;
+    }
+    UpdateRoutes(&updpkt, 1, 0);
+    return FibSync(Fib);
+}
+
+int main(int argc, char *argv[])
+{
+    NumDests = (argc > 1) ? atoi(argv[1]) : DEFAULT_ROUTES;
+    int maxThreads = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (NumDests <= MAX_ROUTERS || maxThreads <= 0)
+    {
+        printf("Usage: fib-bench [routes > %d] [max threads]\n", MAX_ROUTERS);
+        return EXIT_FAILURE;
+    }
+
+    // Router 0 with neighbors 1 and 2, every other destination learned through neighbor 1
+    struct pkt_INIT_RESPONSE nbrs;
+    nbrs.no_nbr = 2;
+    nbrs.nbrcost[0].nbr = 1;
+    nbrs.nbrcost[0].cost = 1;
+    nbrs.nbrcost[1].nbr = 2;
+    nbrs.nbrcost[1].cost = 1;
+    InitRoutingTbl(&nbrs, 0);
+    Fib = FibCreate();
+    int round;
+    for (round = 0; round < NumDests / MAX_ROUTERS + 1; round++)
+    {
+        churn(round);
+    }
+
+    reader *readers = calloc(maxThreads, sizeof(reader));
+    if (readers == NULL)
+    {
+        printf("Failed to allocate %d readers\n", maxThreads);
+        return EXIT_FAILURE;
+    }
+    printf("threads,routes,lookups_per_sec,lookups_per_sec_per_thread,ns_per_lookup,routes_synced_per_sec\n");
+    int threads = 1;
+    while (true)
+    {
+        __atomic_store_n(&Stop, 0, __ATOMIC_RELAXED);
+        int t;
+        for (t = 0; t < threads; t++)
+        {
+            readers[t].seed = 88172645463325252ULL + t * 2654435761ULL;
+            if (pthread_create(&readers[t].thread, NULL, readLoop, &readers[t]) != 0)
+            {
+                printf("Failed to start reader %d\n", t);
+                return EXIT_FAILURE;
+            }
+        }
+
+        // The writer keeps the FIB changing while the readers run
+        long long synced = 0;
+        long long start = nowNs();
+        long long elapsed;
+        do
+        {
+            synced += churn(round++);
+            elapsed = nowNs() - start;
+        } while (elapsed < MIN_RUN_NS);
+        __atomic_store_n(&Stop, 1, __ATOMIC_RELAXED);
+
+        unsigned long long lookups = 0;
+        for (t = 0; t < threads; t++)
+        {
+            pthread_join(readers[t].thread, NULL);
+            lookups += readers[t].lookups;
+        }
+        elapsed = nowNs() - start;
+        double perSec = lookups * 1e9 / elapsed;
+        printf("%d,%d,%.0f,%.0f,%.2f,%.0f\n", threads, NumRoutes, perSec, perSec / threads,
+               (double)elapsed * threads / lookups, synced * 1e9 / elapsed);
+
+        // 1, 2, 4 ... and maxThreads last
+        if (threads == maxThreads)
+            break;
+        threads = (threads * 2 < maxThreads) ? threads * 2 : maxThreads;
+    }
+    FibDestroy(Fib);
+    free(readers);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+  /*
+   *  File Name: fib.c
+   *
+   *  Purpose: Compiles the routing table into the dense next hop array of fib.h,
+   *  and the equal cost next hops of its routes into interned hop sets.
+   */
+
+
+#include "ne.h"
+#include "router.h"
+#include "fib.h"
+
+// Returns a new array of size entries, the first copied from old and the rest without a route
+static struct fib_table *AllocFibTable(unsigned int size, struct fib_table *old)
+{
+    struct fib_table *table = malloc(sizeof(struct fib_table) + (size_t)size * sizeof(unsigned int));
+    if (table == NULL)
+    {
+        printf("Failed to allocate a FIB of %u entries\n", size);
+        exit(EXIT_FAILURE);
+    }
+    table->size = size;
+    unsigned int copied = (old == NULL) ? 0 : old->size;
+    if (copied > 0)
+    {
+        memcpy(table->next_hop, old->next_hop, copied * sizeof(unsigned int));
+    }
+    memset(&table->next_hop[copied], 0xff, (size - copied) * sizeof(unsigned int));
+    return table;
+}
+
+#define FIB_SET_CHUNK_SIZE (1u << FIB_SET_CHUNK_SHIFT)
+#define FIB_INITIAL_SET_BUCKETS 64 /* hop set index buckets to start with, doubled as sets are added */
+
+static unsigned int HashHopSet(const unsigned int *hops, int count)
+{
+    unsigned int hash = count;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        hash = (hash ^ hops[i]) * 2654435761u;
+    }
+    return hash;
+}
+
+// Rebuilds the hop set index over count buckets
+static void GrowSetIndex(struct fib *fib, unsigned int count)
+{
+    unsigned int *grown = calloc(count, sizeof(unsigned int));
+    if (grown == NULL)
+    {
+        printf("Failed to grow the FIB hop set index to %u buckets\n", count);
+        exit(EXIT_FAILURE);
+    }
+    fib->set_mask = count - 1;
+    unsigned int set;
+    for (set = 0; set < fib->no_sets; set++)
+    {
+        const struct fib_hop_set *hopSet = FibHopSet(fib, set);
+        unsigned int bucket = HashHopSet(hopSet->hops, hopSet->count) & fib->set_mask;
+        while (grown[bucket] != 0)
+        {
+            bucket = (bucket + 1) & fib->set_mask;
+        }
+        grown[bucket] = set + 1;
+    }
+    free(fib->set_index);
+    fib->set_index = grown;
+}
+
+// Returns the entry of a destination with count equal cost next hops, FIB_HOP_SET and the id of
+// their hop set, or the first next hop alone if the set cannot be made
+static unsigned int InternHopSet(struct fib *fib, const unsigned int *hops, int count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (hops[i] >= FIB_HOP_SET)
+            return hops[0];
+    }
+    if (fib->set_index == NULL)
+    {
+        GrowSetIndex(fib, FIB_INITIAL_SET_BUCKETS);
+    }
+    unsigned int bucket = HashHopSet(hops, count) & fib->set_mask;
+    while (fib->set_index[bucket] != 0)
+    {
+        const struct fib_hop_set *hopSet = FibHopSet(fib, fib->set_index[bucket] - 1);
+        if (hopSet->count == (unsigned int)count && memcmp(hopSet->hops, hops, count * sizeof(unsigned int)) == 0)
+            return FIB_HOP_SET | (fib->set_index[bucket] - 1);
+        bucket = (bucket + 1) & fib->set_mask;
+    }
+
+    // A new set goes into the next free place, a chunk is allocated the first time one is reached
+    unsigned int set = fib->no_sets;
+    if ((set & (FIB_SET_CHUNK_SIZE - 1)) == 0)
+    {
+        if ((set >> FIB_SET_CHUNK_SHIFT) == FIB_MAX_SET_CHUNKS)
+        {
+            fib->unspread += 1;
+            return hops[0];
+        }
+        fib->set_chunks[set >> FIB_SET_CHUNK_SHIFT] = malloc(FIB_SET_CHUNK_SIZE * sizeof(struct fib_hop_set));
+        if (fib->set_chunks[set >> FIB_SET_CHUNK_SHIFT] == NULL)
+        {
+            printf("Failed to allocate %u more FIB hop sets\n", FIB_SET_CHUNK_SIZE);
+            exit(EXIT_FAILURE);
+        }
+    }
+    struct fib_hop_set *hopSet = &fib->set_chunks[set >> FIB_SET_CHUNK_SHIFT][set & (FIB_SET_CHUNK_SIZE - 1)];
+    hopSet->count = count;
+    memcpy(hopSet->hops, hops, count * sizeof(unsigned int));
+    fib->set_index[bucket] = set + 1;
+    fib->no_sets += 1;
+    if (2 * fib->no_sets > fib->set_mask + 1)
+    {
+        GrowSetIndex(fib, 2 * (fib->set_mask + 1));
+    }
+    return FIB_HOP_SET | set;
+}
+
+// Sets the entry of one destination, growing the array if it does not reach it
+static void SetNextHop(struct fib *fib, unsigned int dest_id, unsigned int nextHop)
+{
+    if (dest_id >= FIB_MAX_DESTS)
+    {
+        fib->skipped += 1;
+        return;
+    }
+    struct fib_table *table = fib->table;
+    if (dest_id >= table->size)
+    {
+        unsigned int size = table->size;
+        while (size <= dest_id)
+        {
+            size *= 2;
+        }
+        // Lookups still reading the old array see it as it was, it is freed with the FIB
+        fib->retired[fib->no_retired++] = table;
+        table = AllocFibTable(size, table);
+        __atomic_store_n(&fib->table, table, __ATOMIC_RELEASE);
+    }
+    // Released so a reader that finds a hop set id also finds the set
+    __atomic_store_n(&table->next_hop[dest_id], nextHop, __ATOMIC_RELEASE);
+}
+
+struct fib *FibCreate(void)
+{
+    struct fib *fib = calloc(1, sizeof(struct fib));
+    if (fib == NULL)
+    {
+        printf("Failed to allocate a FIB\n");
+        exit(EXIT_FAILURE);
+    }
+    fib->table = AllocFibTable(FIB_INITIAL_SIZE, NULL);
+    return fib;
+}
+
+int FibSync(struct fib *fib)
+{
+    unsigned int tableVersion = GetTableVersion();
+    if (tableVersion == fib->version)
+    {
+        return 0;
+    }
+
+    // A version going back means the table was initialized again, nothing compiled holds
+    unsigned int sinceVersion = fib->version;
+    if (tableVersion < fib->version)
+    {
+        unsigned int i;
+        for (i = 0; i < fib->table->size; i++)
+        {
+            __atomic_store_n(&fib->table->next_hop[i], FIB_NO_ROUTE, __ATOMIC_RELAXED);
+        }
+        sinceVersion = 0;
+        fib->skipped = 0;
+        fib->unspread = 0;
+    }
+
+    // Routes come off the change list a fragment at a time
+    struct pkt_RT_UPDATE changes;
+    int routeCount = CountRouteChanges(sinceVersion);
+    int cursor = -1;
+    int applied = 0;
+    while (applied < routeCount)
+    {
+        int changeCount = ConvertChangestoFragment(&changes, 0, sinceVersion, &cursor);
+        if (changeCount == 0)
+            break;
+        int i;
+        for (i = 0; i < changeCount; i++)
+        {
+            struct route_entry *route = &changes.route[i];
+            unsigned int entry = FIB_NO_ROUTE;
+            if (route->next_hop >= FIB_HOP_SET)
+            {
+                fib->skipped += 1;
+            }
+            else if (route->cost < INFINITY)
+            {
+                unsigned int hops[MAX_NEXT_HOPS];
+                int hopCount = GetNextHops(route->dest_id, hops);
+                entry = (hopCount > 1) ? InternHopSet(fib, hops, hopCount) : route->next_hop;
+            }
+            SetNextHop(fib, route->dest_id, entry);
+        }
+        applied += changeCount;
+    }
+    fib->version = tableVersion;
+    return applied;
+}
+
+void FibDestroy(struct fib *fib)
+{
+    int i;
+    for (i = 0; i < fib->no_retired; i++)
+    {
+        free(fib->retired[i]);
+    }
+    unsigned int chunk;
+    for (chunk = 0; chunk < FIB_MAX_SET_CHUNKS && fib->set_chunks[chunk] != NULL; chunk++)
+    {
+        free(fib->set_chunks[chunk]);
+    }
+    free(fib->set_index);
+    free(fib->table);
+    free(fib);
+}
@@ -0,0 +1,123 @@
+/*fib.h*/
+
+#ifndef FIB_H
+#define FIB_H
+
+  /*
+   *  File Name: fib.h
+   *
+   *  Purpose: A forwarding table compiled from the routing table: a dense array
+   *  indexed by dest_id that holds the next hop. It is kept up to date from the
+   *  routing table's change list, so a sync costs the routes changed, not the
+   *  table size. One thread syncs it while any number of threads look up next
+   *  hops without locks: every entry is one word, read and written atomically.
+   *
+   *  A destination with equal cost next hops holds the id of a hop set instead,
+   *  marked with FIB_HOP_SET. Hop sets are interned, every distinct set is kept
+   *  once and never changes, so a reader that found one may use it for as long
+   *  as the FIB lives. FibLookupFlow hashes a flow onto one hop of the set, the
+   *  packets of a flow keep one path while flows spread over all of them.
+   */
+
+#define FIB_NO_ROUTE 0xffffffffu /* next hop of a destination that is unknown or unreachable */
+#define FIB_MAX_DESTS (1u << 24) /* dest_ids at or above this are left out of the dense array */
+#define FIB_INITIAL_SIZE 64 /* entries of a new FIB, the array doubles as larger dest_ids show up */
+#define FIB_HOP_SET 0x80000000u /* set in an entry that holds a hop set id, routes with next hops at or above it are left out */
+#define FIB_SET_CHUNK_SHIFT 8 /* hop sets are allocated 1 << FIB_SET_CHUNK_SHIFT at a time */
+#define FIB_MAX_SET_CHUNKS 256 /* bounds the hop sets to FIB_MAX_SET_CHUNKS << FIB_SET_CHUNK_SHIFT */
+
+struct fib_hop_set {
+  unsigned int count; /* next hops in use, at least 2 */
+  unsigned int hops[MAX_NEXT_HOPS]; /* the route's next_hop first */
+};
+
+struct fib_table {
+  unsigned int size; /* entries in next_hop */
+  unsigned int next_hop[]; /* next hop to each dest_id, FIB_NO_ROUTE if none, or FIB_HOP_SET | hop set id */
+};
+
+struct fib {
+  struct fib_table *table; /* the array lookups read, replaced when it grows */
+  unsigned int version; /* routing table version compiled in */
+  unsigned int skipped; /* routes left out because their dest_id is at least FIB_MAX_DESTS or a next hop at least FIB_HOP_SET */
+  int no_retired; /* outgrown arrays, kept so lookups never read freed memory */
+  struct fib_table *retired[32]; /* sizes double, so 32 outgrown arrays cover every size */
+  struct fib_hop_set *set_chunks[FIB_MAX_SET_CHUNKS]; /* chunk i holds hop set ids [i << FIB_SET_CHUNK_SHIFT, ...) */
+  unsigned int no_sets; /* hop sets interned */
+  unsigned int *set_index; /* open addressed hop set -> id + 1, 0 if unused, kept at most half full */
+  unsigned int set_mask;
+  unsigned int unspread; /* routes left to their next_hop alone because no hop set was left */
+};
+
+/* Routine Name    : FibCreate
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : struct fib * - An empty FIB, FibSync fills it
+ */
+struct fib *FibCreate(void);
+
+/* Routine Name    : FibSync
+ * INPUT ARGUMENTS : 1. (struct fib *) - The FIB
+ * RETURN VALUE    : int - The number of routes applied
+ * USAGE           : Applies the routes of the selected routing context changed since the previous
+ *                   sync, everything the first time or after InitRoutingTbl. Only one thread may sync
+ *                   a FIB, lookups may run meanwhile and see each entry either before or after.
+ */
+int FibSync(struct fib *fib);
+
+/* Routine Name    : FibHopSet
+ * INPUT ARGUMENTS : 1. (struct fib *) - The FIB
+ *                   2. unsigned int - A hop set id read from an entry, FIB_HOP_SET cleared
+ * RETURN VALUE    : const struct fib_hop_set * - The hop set
+ */
+static inline const struct fib_hop_set *FibHopSet(struct fib *fib, unsigned int set)
+{
+  return &fib->set_chunks[set >> FIB_SET_CHUNK_SHIFT][set & ((1u << FIB_SET_CHUNK_SHIFT) - 1)];
+}
+
+/* Routine Name    : FibLookup
+ * INPUT ARGUMENTS : 1. (struct fib *) - The FIB
+ *                   2. unsigned int - Destination router id
+ * RETURN VALUE    : unsigned int - The next hop, FIB_NO_ROUTE if the destination is unknown or unreachable
+ * USAGE           : Safe from any thread, takes no lock and never waits. Of equal cost next hops
+ *                   the route's next_hop is returned.
+ */
+static inline unsigned int FibLookup(struct fib *fib, unsigned int dest_id)
+{
+  struct fib_table *table = __atomic_load_n(&fib->table, __ATOMIC_ACQUIRE);
+  if (dest_id >= table->size)
+    return FIB_NO_ROUTE;
+  unsigned int entry = __atomic_load_n(&table->next_hop[dest_id], __ATOMIC_ACQUIRE);
+  if (entry == FIB_NO_ROUTE || entry < FIB_HOP_SET)
+    return entry;
+  return FibHopSet(fib, entry & ~FIB_HOP_SET)->hops[0];
+}
+
+/* Routine Name    : FibLookupFlow
+ * INPUT ARGUMENTS : 1. (struct fib *) - The FIB
+ *                   2. unsigned int - Destination router id
+ *                   3. unsigned int - Hash of the flow, of its addresses and ports for instance
+ * RETURN VALUE    : unsigned int - One of the equal cost next hops, FIB_NO_ROUTE if the destination
+ *                   is unknown or unreachable
+ * USAGE           : Safe from any thread, takes no lock and never waits. A flow is sent to the same
+ *                   next hop for as long as the hop set of its destination stays the same.
+ */
+static inline unsigned int FibLookupFlow(struct fib *fib, unsigned int dest_id, unsigned int flowHash)
+{
+  struct fib_table *table = __atomic_load_n(&fib->table, __ATOMIC_ACQUIRE);
+  if (dest_id >= table->size)
+    return FIB_NO_ROUTE;
+  unsigned int entry = __atomic_load_n(&table->next_hop[dest_id], __ATOMIC_ACQUIRE);
+  if (entry == FIB_NO_ROUTE || entry < FIB_HOP_SET)
+    return entry;
+  // The flow hash is mixed again so flows numbered in sequence spread too
+  const struct fib_hop_set *set = FibHopSet(fib, entry & ~FIB_HOP_SET);
+  return set->hops[((unsigned long long)(flowHash * 2654435761u) * set->count) >> 32];
+}
+
+/* Routine Name    : FibDestroy
+ * INPUT ARGUMENTS : 1. (struct fib *) - The FIB, no lookup may still be running
+ * RETURN VALUE    : void
+ */
+void FibDestroy(struct fib *fib);
+
+#endif
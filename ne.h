@@ -15,14 +15,20 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <stddef.h>
 
-#define MAX_ROUTERS 10 /* max # of routers in the system */
-#define MAX_PATH_LEN (MAX_ROUTERS - 1)
-#define PACKETSIZE 1024 /* assume packet size large enough to contain a full routing table */
+#define MAX_ROUTERS 10 /* max # of neighbors of a router, pkt_INIT_RESPONSE has room for no more */
+#define PACKETSIZE 1472 /* largest datagram on the wire, the UDP payload of a 1500 byte Ethernet MTU */
 #define INFINITY 999 /* Cost to a unreacheable destination router */
+#define MAX_NEXT_HOPS 4 /* equal cost next hops a route keeps, its advertised next_hop among them */
 #define UPDATE_INTERVAL 1 /* router sends routing updates every 1 sec */
 #define FAILURE_DETECTION (UPDATE_INTERVAL * 3) /* not receiving a nbr's update more than 3 update cycles = 3 * UPDATE_INTERVAL, consider it dead */
 #define CONVERGE_TIMEOUT (UPDATE_INTERVAL * 5) /* if routing table is not changed after 5 update cycles, assume converged */
+#define RECV_BATCH 64 /* datagrams read from the socket per recvmmsg call */
+#define TRIGGER_SPACING_MS 100 /* default minimum gap between two updates sent to the same nbr after a table change */
+#define UPDATE_JITTER_PERCENT 10 /* default spread of each update interval, drawn within +-10% of it */
+#define UPDATE_BACKOFF_LIMIT 8 /* default ceiling of the update interval while the table is stable, in update intervals */
+#define HEARTBEAT_MISSES 3 /* default heartbeats missed in a row before a nbr is considered dead */
 
   /*
    *  ECE 463 Introduction to Computer Networks LAB 2 HEADER FILE
@@ -43,26 +49,105 @@ struct nbr_cost {
   unsigned int cost; /* cost to neighbor */
 };
 
+/*
+ *  The emulator answers every router's pkt_INIT_REQUEST with this fixed size
+ *  packet, so no router has more than MAX_ROUTERS neighbors. Routers size their
+ *  per neighbor state the same way. The routing table has no such limit, see
+ *  MAX_TABLE_ROUTES, but raising the degree changes the wire format the
+ *  emulator and every router have to agree on.
+ */
 struct pkt_INIT_RESPONSE {
-  unsigned int no_nbr; /* number of directly connected neighbors */
+  unsigned int no_nbr; /* number of directly connected neighbors, at most MAX_ROUTERS */
   struct nbr_cost nbrcost[MAX_ROUTERS]; /* array holding the cost to each neighbor */
 };
 
+/*
+ *  Sent by the emulator to both ends of a link whose cost changed. Routers
+ *  tell it apart from the other packets by its size.
+ */
+struct pkt_LINK_COST {
+  unsigned int router_id; /* router the message is addressed to */
+  unsigned int nbr; /* neighbor at the far end of the link */
+  unsigned int cost; /* new cost of the link */
+};
+
+/*
+ *  Sent to every neighbor each heartbeat interval when heartbeats are enabled,
+ *  so a failed neighbor is noticed after a few missed heartbeats instead of a
+ *  few missed routing updates. Routers tell it apart from the other packets by its size.
+ */
+struct pkt_HEARTBEAT {
+  unsigned int sender_id; /* id of router sending the message */
+  unsigned int dest_id; /* id of the neighbor it is sent to */
+  unsigned int epoch; /* the sender's epoch, as in its routing updates */
+  unsigned int detect_ms; /* silence after which the destination declares the sender dead */
+};
+
 struct route_entry {
   unsigned int dest_id; /* destination router id */
   unsigned int next_hop; /* next hop on the shortest path to dest_id */
   unsigned int cost; /* cost to desintation router */
 #ifdef PATHVECTOR
   unsigned int path_len; /* length of loop-free path to dest_id, eg: with path R1 -> R2 -> R3, the length is 2 */
-  unsigned int path[MAX_PATH_LEN]; /* array containing id's of routers along the path */
+  unsigned int path; /* in a routing table, the id of the path in pathtable.h. In a pkt_RT_UPDATE,
+                        the offset of its path_len hops among the packet's RT_UPDATE_PATHS words */
 #endif
 };
 
+#define RT_UPDATE_HDRSIZE (12 * sizeof(unsigned int)) /* bytes of pkt_RT_UPDATE in front of the route array */
+#define ROUTES_PER_PKT ((int)((PACKETSIZE - RT_UPDATE_HDRSIZE) / sizeof(struct route_entry))) /* routes that fit in one datagram */
+#define RT_UPDATE_PKTSIZE(n) (offsetof(struct pkt_RT_UPDATE, route) + (n) * sizeof(struct route_entry)) /* bytes sent for a fragment holding n routes, paths not included */
+#define RT_UPDATE_WORDS (ROUTES_PER_PKT * (int)(sizeof(struct route_entry) / sizeof(unsigned int))) /* words of route[], routes and their paths share them */
+#define MAX_PATH_LEN (RT_UPDATE_WORDS - (int)(sizeof(struct route_entry) / sizeof(unsigned int))) /* longest path a fragment has room for next to its route */
+#define RT_UPDATE_PATHS(pkt) ((unsigned int *)&(pkt)->route[(pkt)->no_routes]) /* first word of the paths packed behind the routes */
+#define MAX_TABLE_ROUTES (1 << 18) /* most routes a router's table holds */
+#define MAX_UPDATE_FRAGS ((MAX_TABLE_ROUTES + ROUTES_PER_PKT - 1) / ROUTES_PER_PKT) /* most fragments of an update, a whole table of MAX_TABLE_ROUTES routes */
+#define ROUTE_RANGE_SHIFT 16 /* bits of a route's cost below the range of a summary */
+#define MAX_ROUTE_RANGE 0xffff /* destinations a summary covers after its dest_id */
+#define ROUTE_COST(route) ((route)->cost & ((1u << ROUTE_RANGE_SHIFT) - 1)) /* cost of a route or summary on the wire */
+#define ROUTE_RANGE(route) ((route)->cost >> ROUTE_RANGE_SHIFT) /* destinations after dest_id a summary covers, 0 for a route */
+
+/*
+ *  A routing table larger than ROUTES_PER_PKT is sent as several fragments
+ *  sharing the same update_seq. Only the populated part of route[] is sent,
+ *  and the receiver reassembles all frag_count fragments before applying them.
+ *  Updates of more than MAX_UPDATE_FRAGS fragments are dropped.
+ *
+ *  An update with base_version 0 carries the full table. Otherwise it is a
+ *  delta holding only the routes that changed after base_version, and it is
+ *  applied only if the receiver already holds base_version or later. Each
+ *  router acknowledges the last version it applied from the destination in
+ *  ack_version, and the sender bases its next delta on that acknowledgement.
+ *  epoch changes whenever a router restarts, which forces a full resync.
+ *  hold_ms tells the receiver how long to wait for the sender's next update
+ *  before declaring it dead. It grows as the sender backs off its update interval.
+ *
+ *  In DISTVECTOR mode a sender may summarize consecutive destinations reached
+ *  through the same next hop at the same cost (router -a). A summary is one
+ *  route_entry whose dest_id is the first destination of the block, with
+ *  ROUTE_RANGE destinations following it counted in the high bits of cost,
+ *  which real costs never reach. Receivers apply it to every destination of
+ *  the block. Path vector routes are never summarized, their paths differ.
+ *
+ *  In PATHVECTOR mode the hops of the paths follow the last route. A route's
+ *  path takes path_len words starting path words past RT_UPDATE_PATHS, and a
+ *  path that starts another path of the fragment may share its words, so the
+ *  size of a fragment is given by size_pkt_RT_UPDATE.
+ */
 struct pkt_RT_UPDATE {
   unsigned int sender_id; /* id of router sending the message */
   unsigned int dest_id; /* id of neighbor router to which routing table is sent */
-  unsigned int no_routes; /* number of routes in my routing table */
-  struct route_entry route[MAX_ROUTERS]; /* array containing rows of routing table */
+  unsigned int no_routes; /* number of routes carried in this fragment */
+  unsigned int update_seq; /* identifies the update this fragment belongs to */
+  unsigned int frag_no; /* position of this fragment in the update, starting at 0 */
+  unsigned int frag_count; /* number of fragments making up the update */
+  unsigned int epoch; /* chosen by the sender at startup */
+  unsigned int version; /* table version of the sender once this update is applied */
+  unsigned int base_version; /* table version the update is relative to, 0 for a full table */
+  unsigned int ack_epoch; /* epoch of the destination router that ack_version refers to */
+  unsigned int ack_version; /* last version of the destination's table applied by the sender */
+  unsigned int hold_ms; /* silence after which the destination declares the sender dead, 0 for FAILURE_DETECTION */
+  struct route_entry route[ROUTES_PER_PKT]; /* array containing rows of routing table */
 };
 
 /* The following endian functions are to be implemented in endian.c */
@@ -79,10 +164,52 @@ void hton_pkt_RT_UPDATE (struct pkt_RT_UPDATE *);
  */
 void ntoh_pkt_RT_UPDATE (struct pkt_RT_UPDATE *);
 
+/*
+ *  This function returns the bytes taken by a struct pkt_RT_UPDATE in host
+ *  byte order, its paths included. It returns 0 when no_routes is too large
+ *  or a path ends outside of route[].
+ */
+size_t size_pkt_RT_UPDATE (const struct pkt_RT_UPDATE *);
+
 /*
  *  This function converts struct pkt_INIT_RESPONSE
  *  from network to host byte order.
  */
 void ntoh_pkt_INIT_RESPONSE (struct pkt_INIT_RESPONSE *);
 
+/*
+ *  This function converts struct pkt_LINK_COST
+ *  between host and network byte order.
+ */
+void swap_pkt_LINK_COST (struct pkt_LINK_COST *);
+
+/*
+ *  This function converts struct pkt_HEARTBEAT
+ *  between host and network byte order.
+ */
+void swap_pkt_HEARTBEAT (struct pkt_HEARTBEAT *);
+
+/* Kernels swap_words can run on, SWAP_KERNEL_AUTO picks the fastest the CPU supports */
+#define SWAP_KERNEL_AUTO 0
+#define SWAP_KERNEL_SCALAR 1
+#define SWAP_KERNEL_SSSE3 2
+#define SWAP_KERNEL_AVX2 3
+
+/*
+ *  This function converts an array of 32 bit words between host
+ *  and network byte order in place. Both directions are the same swap.
+ */
+void swap_words (unsigned int *words, int count);
+
+/*
+ *  This function makes swap_words use the given SWAP_KERNEL_*.
+ *  It returns 0 and leaves the kernel alone if the CPU lacks it.
+ */
+int select_swap_kernel (int kernel);
+
+/*
+ *  This function returns the name of the kernel swap_words runs on.
+ */
+const char *swap_kernel_name (void);
+
 #endif
@@ -0,0 +1,653 @@
+  /*
+   *  File Name: netemu.c
+   *
+   *  Purpose: Network emulator speaking the ne.h protocol. Routers register with an
+   *  INIT_REQUEST and get their neighbors back in an INIT_RESPONSE, after which every
+   *  RT_UPDATE they send is relayed to its dest_id over the emulated link, subject to
+   *  the link's state, delay and loss. A script can take links down and up and change
+   *  their cost, delay and loss while the routers run. Cost changes are announced to
+   *  both ends of the link with a pkt_LINK_COST.
+   *
+   *  Usage: netemu [-s seed] [-D ms] [-l percent] [-S script] [-T seconds] <ne UDP port> <topology file>
+   *
+   *  The script format is described in topology.h, its times count from the moment
+   *  the last router of the topology registered.
+   */
+
+
+#define _GNU_SOURCE
+#include "ne.h"
+#include "timerwheel.h"
+#include "topology.h"
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define SOCKET_BUFFER_BYTES (4 * 1024 * 1024) /* so bursts from hundreds of routers are not dropped by the kernel */
+
+// Types of timers kept in Wheel
+#define DELAYED_PACKET 1 /* a packet has crossed its link, nbr holds the destination */
+#define SCRIPT_EVENT 2   /* the next line of the script is due */
+#define STOP_EVENT 3     /* the run time given with -T is over */
+
+// Struct that stores one direction of a link
+typedef struct
+{
+    int nbr;            // router at the far end
+    unsigned int cost;  // cost reported to the routers
+    int delay_ms;       // one way delay
+    double loss;        // probability that a packet is dropped
+    bool up;            // packets are relayed only over links that are up
+} emu_link;
+
+// Struct that stores one router of the topology
+typedef struct
+{
+    bool registered;          // an INIT_REQUEST has been received
+    struct sockaddr_in addr;  // where the router's packets are delivered
+    int no_links;
+    emu_link links[MAX_ROUTERS];
+} emu_router;
+
+// Struct that holds a packet until its link delay has passed
+typedef struct
+{
+    struct wheel_timer timer; // DELAYED_PACKET
+    size_t size;
+    unsigned char data[];
+} delayed_packet;
+
+// Struct that queues outgoing datagrams so they go out in one sendmmsg call
+typedef struct
+{
+    int count;
+    int capacity;
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    delayed_packet **owned;  // packet to free once sent, NULL for receive buffers
+} relay_batch;
+
+// Struct that counts what happened to the packets
+typedef struct
+{
+    long long relayed;      // packets handed to the socket
+    long long bytes;        // bytes of those packets
+    long long link_down;    // dropped because the link was down
+    long long lost;         // dropped by link loss
+    long long unroutable;   // malformed, no such link or the destination never registered
+    long long send_failed;  // dropped because the socket refused them
+} emu_stats;
+
+static emu_router *Routers;
+static int NumRouters;
+static int NumRegistered;
+static struct topo_event *Script;
+static int ScriptLength;
+static int ScriptNext;
+static long long ScriptStartMs = -1;
+static long long RunTimeMs;
+static struct timer_wheel Wheel;
+static struct wheel_timer ScriptTimer;
+static struct wheel_timer StopTimer;
+static relay_batch Batch;
+static emu_stats Stats;
+static volatile sig_atomic_t Stopping;
+// State of the xorshift generator behind link loss (-s)
+static unsigned long long RandomState = 88172645463325252ULL;
+
+//-------------------------------------- FUNCTION DECLARATIONS---------------------*/
+
+/* Reads the topology file into Routers */
+void loadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss);
+/* Returns the link from router a to router b, NULL if there is none */
+emu_link *findLink(int a, int b);
+/* Binds the emulator socket, non blocking and with large buffers */
+int openSocket(int port);
+/* Runs the emulator until SIGINT, SIGTERM or the end of the run time */
+void runEmulator(int sockfd);
+/* Receives every waiting datagram in batches and relays or answers them */
+void receivePackets(int sockfd);
+/* Registers a router and sends it its neighbors */
+void registerRouter(int sockfd, struct pkt_INIT_REQUEST *request, struct sockaddr_in *from);
+/* Relays one RT_UPDATE over its link, data must stay valid until the next flushBatch */
+void relayPacket(unsigned char *data, size_t size);
+/* Adds a datagram for router r to Batch */
+void queuePacket(int r, void *data, size_t size, delayed_packet *owned);
+/* Sends every queued datagram with sendmmsg and empties Batch */
+void flushBatch(int sockfd);
+/* Applies every script line that is due */
+void runScript(int sockfd, long long nowMs);
+/* Tells router r the new cost of its link to nbr */
+void sendLinkCost(int sockfd, int r, int nbr, unsigned int cost);
+/* Returns a uniformly distributed number in [0, 1) */
+double randomUnit(void);
+/* Returns CLOCK_MONOTONIC in milliseconds */
+long long monotonicMs(void);
+/* Points the timerfd driving the wheel at the wheel's next deadline */
+void armWheelfd(int wheelfd, long long wakeupMs);
+/* Asks the main loop to stop */
+void stopEmulator(int signum);
+
+/*------------------------------ START OF THE PROGRAM ---------------------------*/
+
+int main(int argc, char **argv)
+{
+    int option;
+    bool badOption = false;
+    int defaultDelay = 0;
+    double defaultLoss = 0;
+    char *scriptFile = NULL;
+    while ((option = getopt(argc, argv, "s:D:l:S:T:")) != -1)
+    {
+        switch (option)
+        {
+        case 's':
+            RandomState = strtoull(optarg, NULL, 0) * 2654435761ULL + 1;
+            break;
+        case 'D':
+            defaultDelay = atoi(optarg);
+            badOption = defaultDelay < 0;
+            break;
+        case 'l':
+            defaultLoss = atof(optarg) / 100;
+            badOption = defaultLoss < 0 || defaultLoss >= 1;
+            break;
+        case 'S':
+            scriptFile = optarg;
+            break;
+        case 'T':
+            RunTimeMs = (long long)(atof(optarg) * 1000);
+            badOption = RunTimeMs <= 0;
+            break;
+        default:
+            badOption = true;
+        }
+        if (badOption)
+            break;
+    }
+    if (badOption || argc - optind != 2)
+    {
+        printf("usage: netemu [-s seed] [-D ms] [-l percent] [-S script] [-T seconds] <ne UDP port> <topology file>\n");
+        printf("       -s seed     seed of link loss\n");
+        printf("       -D ms       delay of links that do not give one (default 0)\n");
+        printf("       -l percent  loss of links that do not give one (default 0)\n");
+        printf("       -S script   link changes to make while the routers run\n");
+        printf("       -T seconds  stop after this long, otherwise run until interrupted\n");
+        return EXIT_FAILURE;
+    }
+
+    struct topology topo;
+    loadTopology(argv[optind + 1], &topo, defaultDelay, defaultLoss);
+    if (scriptFile != NULL)
+    {
+        Script = LoadLinkScript(scriptFile, &topo, &ScriptLength);
+    }
+    free(topo.links);
+    int sockfd = openSocket(atoi(argv[optind]));
+    if (sockfd < 0)
+    {
+        printf("Failed to open port %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction stopAction;
+    bzero((char *)&stopAction, sizeof(stopAction));
+    stopAction.sa_handler = stopEmulator;
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+
+    runEmulator(sockfd);
+
+    printf("relayed %lld packets %lld bytes, dropped %lld on down links, %lld lost, %lld unroutable, "
+           "%lld send failures\n", Stats.relayed, Stats.bytes, Stats.link_down, Stats.lost, Stats.unroutable,
+           Stats.send_failed);
+    close(sockfd);
+    return EXIT_SUCCESS;
+}
+
+void loadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss)
+{
+    LoadTopology(fileName, topo, defaultDelay, defaultLoss);
+    NumRouters = topo->no_routers;
+    Routers = calloc(NumRouters, sizeof(emu_router));
+    if (Routers == NULL)
+    {
+        printf("Failed to allocate %d routers\n", NumRouters);
+        exit(EXIT_FAILURE);
+    }
+
+    int i, end;
+    for (i = 0; i < topo->no_links; i++)
+    {
+        struct topo_link *link = &topo->links[i];
+        for (end = 0; end < 2; end++)
+        {
+            int r = end ? link->b : link->a;
+            int nbr = end ? link->a : link->b;
+            if (findLink(r, nbr) != NULL)
+            {
+                printf("Link R%d - R%d is listed twice in %s\n", link->a, link->b, fileName);
+                exit(EXIT_FAILURE);
+            }
+            // An INIT_RESPONSE has room for MAX_ROUTERS neighbors
+            if (Routers[r].no_links == MAX_ROUTERS)
+            {
+                printf("R%d has more than %d neighbors in %s\n", r, MAX_ROUTERS, fileName);
+                exit(EXIT_FAILURE);
+            }
+            emu_link *emuLink = &Routers[r].links[Routers[r].no_links++];
+            emuLink->nbr = nbr;
+            emuLink->cost = link->cost;
+            emuLink->delay_ms = link->delay_ms;
+            emuLink->loss = link->loss;
+            emuLink->up = true;
+        }
+    }
+}
+
+emu_link *findLink(int a, int b)
+{
+    int i;
+    for (i = 0; i < Routers[a].no_links; i++)
+    {
+        if (Routers[a].links[i].nbr == b)
+            return &Routers[a].links[i];
+    }
+    return NULL;
+}
+
+int openSocket(int port)
+{
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0)
+    {
+        return -1;
+    }
+    int bufferBytes = SOCKET_BUFFER_BYTES;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+
+    struct sockaddr_in serveraddr;
+    bzero((char *)&serveraddr, sizeof(serveraddr));
+    serveraddr.sin_family = AF_INET;
+    serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    serveraddr.sin_port = htons((unsigned short)port);
+    if (bind(sockfd, (struct sockaddr *)&serveraddr, sizeof(serveraddr)) < 0)
+    {
+        close(sockfd);
+        return -2;
+    }
+    return sockfd;
+}
+
+void runEmulator(int sockfd)
+{
+    int epfd = epoll_create1(0);
+    int wheelfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct epoll_event event;
+    struct epoll_event events[2];
+    event.events = EPOLLIN;
+    event.data.fd = sockfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event);
+    event.data.fd = wheelfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wheelfd, &event);
+    TimerWheelInit(&Wheel, monotonicMs());
+    TimerInit(&ScriptTimer, SCRIPT_EVENT, 0);
+    TimerInit(&StopTimer, STOP_EVENT, 0);
+    if (RunTimeMs > 0)
+    {
+        TimerWheelSchedule(&Wheel, &StopTimer, monotonicMs() + RunTimeMs);
+    }
+    long long armedWakeup = -1;
+
+    while (!Stopping)
+    {
+        long long wakeup = TimerWheelNextWakeup(&Wheel);
+        if (wakeup != armedWakeup)
+        {
+            armWheelfd(wheelfd, wakeup);
+            armedWakeup = wakeup;
+        }
+
+        int readyfds = epoll_wait(epfd, events, 2, -1);
+        if (readyfds == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("epoll_wait failed with errno: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        int i;
+        for (i = 0; i < readyfds; i++)
+        {
+            if (events[i].data.fd == sockfd)
+            {
+                receivePackets(sockfd);
+            }
+            else
+            {
+                unsigned long long expirations;
+                if (read(wheelfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                {
+                    printf("Failed to read the timer with errno: %d\n", errno);
+                    exit(EXIT_FAILURE);
+                }
+                armedWakeup = -1;
+            }
+        }
+
+        long long nowMs = monotonicMs();
+        struct wheel_timer *timer;
+        while ((timer = TimerWheelAdvance(&Wheel, nowMs)) != NULL)
+        {
+            switch (timer->type)
+            {
+            case DELAYED_PACKET:
+            {
+                delayed_packet *packet = (delayed_packet *)timer;
+                queuePacket(timer->nbr, packet->data, packet->size, packet);
+                break;
+            }
+            case SCRIPT_EVENT:
+                runScript(sockfd, nowMs);
+                break;
+            case STOP_EVENT:
+                Stopping = 1;
+                break;
+            }
+        }
+        flushBatch(sockfd);
+    }
+    close(wheelfd);
+    close(epfd);
+}
+
+void receivePackets(int sockfd)
+{
+    static unsigned char buffers[RECV_BATCH][PACKETSIZE];
+    static struct mmsghdr msgs[RECV_BATCH];
+    static struct iovec iovs[RECV_BATCH];
+    static struct sockaddr_in senders[RECV_BATCH];
+    int received = RECV_BATCH;
+    int i;
+
+    while (received == RECV_BATCH)
+    {
+        for (i = 0; i < RECV_BATCH; i++)
+        {
+            iovs[i].iov_base = buffers[i];
+            iovs[i].iov_len = PACKETSIZE;
+            bzero((char *)&msgs[i], sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &senders[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        }
+        received = recvmmsg(sockfd, msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (received < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            printf("recvmmsg failed with errno: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < received; i++)
+        {
+            if (msgs[i].msg_len == sizeof(struct pkt_INIT_REQUEST))
+                registerRouter(sockfd, (struct pkt_INIT_REQUEST *)buffers[i], &senders[i]);
+            else
+                relayPacket(buffers[i], msgs[i].msg_len);
+        }
+        // The receive buffers are reused by the next recvmmsg
+        flushBatch(sockfd);
+    }
+}
+
+void registerRouter(int sockfd, struct pkt_INIT_REQUEST *request, struct sockaddr_in *from)
+{
+    unsigned int r = ntohl(request->router_id);
+    if (r >= NumRouters)
+    {
+        Stats.unroutable += 1;
+        return;
+    }
+    if (!Routers[r].registered)
+    {
+        Routers[r].registered = true;
+        NumRegistered += 1;
+    }
+    Routers[r].addr = *from;
+
+    // Links that are down are reported at an infinite cost
+    struct pkt_INIT_RESPONSE response;
+    bzero((char *)&response, sizeof(response));
+    response.no_nbr = htonl(Routers[r].no_links);
+    int i;
+    for (i = 0; i < Routers[r].no_links; i++)
+    {
+        emu_link *link = &Routers[r].links[i];
+        response.nbrcost[i].nbr = htonl(link->nbr);
+        response.nbrcost[i].cost = htonl(link->up ? link->cost : INFINITY);
+    }
+    if (sendto(sockfd, &response, sizeof(response), 0, (struct sockaddr *)from, sizeof(*from)) < 0)
+    {
+        Stats.send_failed += 1;
+    }
+
+    // The script runs on the clock of the complete topology
+    if (NumRegistered == NumRouters && ScriptStartMs < 0)
+    {
+        ScriptStartMs = monotonicMs();
+        printf("all %d routers registered\n", NumRouters);
+        fflush(stdout);
+        if (ScriptLength > 0)
+        {
+            TimerWheelSchedule(&Wheel, &ScriptTimer, ScriptStartMs + Script[0].at_ms);
+        }
+    }
+}
+
+void relayPacket(unsigned char *data, size_t size)
+{
+    // Only sender_id and dest_id are needed to route the packet
+    if (size < 2 * sizeof(unsigned int))
+    {
+        Stats.unroutable += 1;
+        return;
+    }
+    unsigned int header[2];
+    memcpy(header, data, sizeof(header));
+    unsigned int sender = ntohl(header[0]);
+    unsigned int dest = ntohl(header[1]);
+    emu_link *link = (sender < NumRouters && dest < NumRouters) ? findLink(sender, dest) : NULL;
+    if (link == NULL || !Routers[dest].registered)
+    {
+        Stats.unroutable += 1;
+        return;
+    }
+    if (!link->up)
+    {
+        Stats.link_down += 1;
+        return;
+    }
+    if (link->loss > 0 && randomUnit() < link->loss)
+    {
+        Stats.lost += 1;
+        return;
+    }
+    if (link->delay_ms == 0)
+    {
+        queuePacket(dest, data, size, NULL);
+        return;
+    }
+
+    delayed_packet *packet = malloc(sizeof(delayed_packet) + size);
+    if (packet == NULL)
+    {
+        printf("Failed to allocate a delayed packet\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(packet->data, data, size);
+    packet->size = size;
+    TimerInit(&packet->timer, DELAYED_PACKET, dest);
+    TimerWheelSchedule(&Wheel, &packet->timer, monotonicMs() + link->delay_ms);
+}
+
+void queuePacket(int r, void *data, size_t size, delayed_packet *owned)
+{
+    if (Batch.count == Batch.capacity)
+    {
+        int capacity = (Batch.capacity == 0) ? RECV_BATCH : 2 * Batch.capacity;
+        Batch.msgs = realloc(Batch.msgs, capacity * sizeof(struct mmsghdr));
+        Batch.iovs = realloc(Batch.iovs, capacity * sizeof(struct iovec));
+        Batch.owned = realloc(Batch.owned, capacity * sizeof(delayed_packet *));
+        if (Batch.msgs == NULL || Batch.iovs == NULL || Batch.owned == NULL)
+        {
+            printf("Failed to grow the relay batch to %d datagrams\n", capacity);
+            exit(EXIT_FAILURE);
+        }
+        Batch.capacity = capacity;
+    }
+    int i = Batch.count++;
+    Batch.iovs[i].iov_base = data;
+    Batch.iovs[i].iov_len = size;
+    Batch.owned[i] = owned;
+    bzero((char *)&Batch.msgs[i], sizeof(Batch.msgs[i]));
+    Batch.msgs[i].msg_hdr.msg_name = &Routers[r].addr;
+    Batch.msgs[i].msg_hdr.msg_namelen = sizeof(Routers[r].addr);
+    Batch.msgs[i].msg_hdr.msg_iov = &Batch.iovs[i];
+    Batch.msgs[i].msg_hdr.msg_iovlen = 1;
+}
+
+void flushBatch(int sockfd)
+{
+    int sent = 0;
+    while (sent < Batch.count)
+    {
+        int batchSent = sendmmsg(sockfd, &Batch.msgs[sent], Batch.count - sent, 0);
+        if (batchSent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // A full socket buffer drops the rest, as a congested link would
+            Stats.send_failed += Batch.count - sent;
+            break;
+        }
+        int i;
+        for (i = sent; i < sent + batchSent; i++)
+        {
+            Stats.bytes += Batch.iovs[i].iov_len;
+        }
+        Stats.relayed += batchSent;
+        sent += batchSent;
+    }
+    int i;
+    for (i = 0; i < Batch.count; i++)
+    {
+        free(Batch.owned[i]);
+    }
+    Batch.count = 0;
+}
+
+void runScript(int sockfd, long long nowMs)
+{
+    while (ScriptNext < ScriptLength && ScriptStartMs + Script[ScriptNext].at_ms <= nowMs)
+    {
+        struct topo_event *line = &Script[ScriptNext++];
+        emu_link *links[2] = {findLink(line->a, line->b), findLink(line->b, line->a)};
+        int end;
+        for (end = 0; end < 2; end++)
+        {
+            switch (line->action)
+            {
+            case LINK_DOWN:
+                links[end]->up = false;
+                break;
+            case LINK_UP:
+                links[end]->up = true;
+                break;
+            case LINK_COST:
+                links[end]->cost = (unsigned int)line->value;
+                break;
+            case LINK_DELAY:
+                links[end]->delay_ms = (int)line->value;
+                break;
+            case LINK_LOSS:
+                links[end]->loss = line->value / 100;
+                break;
+            }
+        }
+        if (line->action == LINK_COST)
+        {
+            sendLinkCost(sockfd, line->a, line->b, links[0]->cost);
+            sendLinkCost(sockfd, line->b, line->a, links[1]->cost);
+        }
+        printf("%lld ms: link R%d - R%d %s", nowMs - ScriptStartMs, line->a, line->b,
+               (line->action == LINK_DOWN) ? "down" : (line->action == LINK_UP) ? "up" : "now has");
+        if (line->action == LINK_COST)
+            printf(" cost %u", links[0]->cost);
+        else if (line->action == LINK_DELAY)
+            printf(" delay %d ms", links[0]->delay_ms);
+        else if (line->action == LINK_LOSS)
+            printf(" loss %g%%", line->value);
+        printf("\n");
+        fflush(stdout);
+    }
+    if (ScriptNext < ScriptLength)
+    {
+        TimerWheelSchedule(&Wheel, &ScriptTimer, ScriptStartMs + Script[ScriptNext].at_ms);
+    }
+}
+
+void sendLinkCost(int sockfd, int r, int nbr, unsigned int cost)
+{
+    if (!Routers[r].registered)
+    {
+        return;
+    }
+    struct pkt_LINK_COST linkCost;
+    linkCost.router_id = r;
+    linkCost.nbr = nbr;
+    linkCost.cost = cost;
+    swap_pkt_LINK_COST(&linkCost);
+    if (sendto(sockfd, &linkCost, sizeof(linkCost), 0, (struct sockaddr *)&Routers[r].addr,
+               sizeof(Routers[r].addr)) < 0)
+    {
+        Stats.send_failed += 1;
+    }
+}
+
+double randomUnit(void)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return (RandomState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+long long monotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void armWheelfd(int wheelfd, long long wakeupMs)
+{
+    struct itimerspec wheelTimer;
+    bzero((char *)&wheelTimer, sizeof(wheelTimer));
+    if (wakeupMs >= 0)
+    {
+        // Absolute deadline, a time already passed fires straight away
+        wheelTimer.it_value.tv_sec = wakeupMs / 1000;
+        wheelTimer.it_value.tv_nsec = (wakeupMs % 1000) * 1000000;
+    }
+    timerfd_settime(wheelfd, TFD_TIMER_ABSTIME, &wheelTimer, NULL);
+}
+
+void stopEmulator(int signum)
+{
+    Stopping = 1;
+}
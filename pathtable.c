@@ -0,0 +1,180 @@
+#include "pathtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_CHUNK_SIZE (1u << PATH_CHUNK_SHIFT)
+#define PATH_INITIAL_BUCKETS 1024 /* hash buckets to start with, doubled as paths are added */
+#define NO_PATH 0                 /* ends bucket chains and the free list, PATH_EMPTY is never on either */
+
+// The first chunk is static so PATH_EMPTY exists before any path is made
+static struct path_node FirstChunk[PATH_CHUNK_SIZE] = {{{0}, PATH_EMPTY, 0, 0, 1, NO_PATH}};
+struct path_node *PathChunks[PATH_MAX_CHUNKS] = {FirstChunk};
+
+static unsigned int *Buckets;      // head of the chain of every bucket
+static unsigned int BucketMask;
+static unsigned int FreeList;      // released nodes, reused before fresh ones
+static unsigned int NextFresh = 1; // first id never handed out
+static int NumPaths = 1;
+
+// Writable view of a node, only the thread that owns the table may use it
+static struct path_node *Node(unsigned int path)
+{
+    return &PathChunks[path >> PATH_CHUNK_SHIFT][path & (PATH_CHUNK_SIZE - 1)];
+}
+
+static unsigned int HashPath(unsigned int parent, unsigned int hop)
+{
+    return ((parent * 2654435761u) ^ (hop * 40503u)) & BucketMask;
+}
+
+// Rebuilds the bucket chains over twice as many buckets
+static void GrowBuckets(unsigned int count)
+{
+    unsigned int *grown = malloc(count * sizeof(unsigned int));
+    if (grown == NULL)
+    {
+        printf("Failed to grow the path table to %u buckets\n", count);
+        exit(EXIT_FAILURE);
+    }
+    memset(grown, 0, count * sizeof(unsigned int));
+    unsigned int oldCount = (Buckets == NULL) ? 0 : BucketMask + 1;
+    BucketMask = count - 1;
+    unsigned int bucket;
+    for (bucket = 0; bucket < oldCount; bucket++)
+    {
+        unsigned int path = Buckets[bucket];
+        while (path != NO_PATH)
+        {
+            struct path_node *node = Node(path);
+            unsigned int next = node->next;
+            unsigned int newBucket = HashPath(node->parent, node->hop);
+            node->next = grown[newBucket];
+            grown[newBucket] = path;
+            path = next;
+        }
+    }
+    free(Buckets);
+    Buckets = grown;
+}
+
+// Hands out a free node
+static unsigned int AllocNode(void)
+{
+    if (FreeList != NO_PATH)
+    {
+        unsigned int path = FreeList;
+        FreeList = Node(path)->next;
+        return path;
+    }
+    if ((NextFresh & (PATH_CHUNK_SIZE - 1)) == 0)
+    {
+        unsigned int chunk = NextFresh >> PATH_CHUNK_SHIFT;
+        if (chunk == PATH_MAX_CHUNKS)
+        {
+            printf("Path table is full with %d paths\n", NumPaths);
+            exit(EXIT_FAILURE);
+        }
+        PathChunks[chunk] = malloc(PATH_CHUNK_SIZE * sizeof(struct path_node));
+        if (PathChunks[chunk] == NULL)
+        {
+            printf("Failed to allocate %u more paths\n", PATH_CHUNK_SIZE);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return NextFresh++;
+}
+
+unsigned int PathExtend(unsigned int parent, unsigned int hop)
+{
+    if (Buckets == NULL)
+    {
+        GrowBuckets(PATH_INITIAL_BUCKETS);
+    }
+    unsigned int path = Buckets[HashPath(parent, hop)];
+    while (path != NO_PATH)
+    {
+        struct path_node *node = Node(path);
+        if (node->parent == parent && node->hop == hop)
+        {
+            node->refs += 1;
+            return path;
+        }
+        path = node->next;
+    }
+
+    // A new path holds a reference on its parent for as long as it lives
+    if ((unsigned int)NumPaths > BucketMask)
+    {
+        GrowBuckets(2 * (BucketMask + 1));
+    }
+    path = AllocNode();
+    struct path_node *node = Node(path);
+    node->parent = parent;
+    node->hop = hop;
+    node->length = Node(parent)->length + 1;
+    memcpy(node->routers, Node(parent)->routers, sizeof(node->routers));
+    node->routers[(hop % PATH_BITMAP_BITS) / 64] |= 1ull << (hop % 64);
+    node->refs = 1;
+    PathRetain(parent);
+    unsigned int bucket = HashPath(parent, hop);
+    node->next = Buckets[bucket];
+    Buckets[bucket] = path;
+    NumPaths += 1;
+    return path;
+}
+
+unsigned int PathFromHops(unsigned int first, const unsigned int *hops, int count)
+{
+    unsigned int path = PathExtend(PATH_EMPTY, first);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        unsigned int longer = PathExtend(path, hops[i]);
+        PathRelease(path);
+        path = longer;
+    }
+    return path;
+}
+
+void PathRetain(unsigned int path)
+{
+    if (path != PATH_EMPTY)
+    {
+        Node(path)->refs += 1;
+    }
+}
+
+void PathRelease(unsigned int path)
+{
+    // Freeing a path drops the reference it held on its parent
+    while (path != PATH_EMPTY && --Node(path)->refs == 0)
+    {
+        struct path_node *node = Node(path);
+        unsigned int *link = &Buckets[HashPath(node->parent, node->hop)];
+        while (*link != path)
+        {
+            link = &Node(*link)->next;
+        }
+        *link = node->next;
+        node->next = FreeList;
+        FreeList = path;
+        NumPaths -= 1;
+        path = node->parent;
+    }
+}
+
+void PathCopyHops(unsigned int path, unsigned int *hops)
+{
+    const struct path_node *node = PathNode(path);
+    while (node->length > 0)
+    {
+        hops[node->length - 1] = node->hop;
+        node = PathNode(node->parent);
+    }
+}
+
+int PathCount(void)
+{
+    return NumPaths;
+}
@@ -0,0 +1,115 @@
+/*pathtable.h*/
+
+#ifndef PATHTABLE_H
+#define PATHTABLE_H
+
+  /*
+   *  File Name: pathtable.h
+   *
+   *  Purpose: Shared storage for the paths of PATHVECTOR routes. Every distinct
+   *  path is kept once, as a node holding its last hop and the id of the path
+   *  without it, so paths that start alike share their nodes. A shortest path
+   *  tree is closed under prefixes, which makes a whole table cost about one node
+   *  per route whatever the path lengths. Nodes are reference counted and reused
+   *  once the last route, snapshot or longer path holding them lets go.
+   *
+   *  Every node also keeps a bitmap of the routers on its path, bit id % PATH_BITMAP_BITS.
+   *  It answers whether a router is on a path in constant time, exactly for ids below
+   *  PATH_BITMAP_BITS. Larger ids may share a bit, then the path is walked to be sure.
+   *
+   *  Only one thread may create or release paths. Other threads may read any path
+   *  they hold a reference to, nodes never move once created.
+   */
+
+#define PATH_EMPTY 0 /* id of the path with no hops, the path of a router to itself */
+#define PATH_CHUNK_SHIFT 12 /* nodes are allocated 1 << PATH_CHUNK_SHIFT at a time */
+#define PATH_MAX_CHUNKS 4096 /* bounds the node count to PATH_MAX_CHUNKS << PATH_CHUNK_SHIFT */
+#define PATH_BITMAP_WORDS 2 /* 64 bit words in the router bitmap of a path */
+#define PATH_BITMAP_BITS (64 * PATH_BITMAP_WORDS)
+
+struct path_node {
+  unsigned long long routers[PATH_BITMAP_WORDS]; /* bit id % PATH_BITMAP_BITS set for every router on the path */
+  unsigned int parent; /* id of the path without the last hop */
+  unsigned int hop; /* last router on the path */
+  unsigned int length; /* number of hops */
+  unsigned int refs; /* references held on the path, 0 once the node is free */
+  unsigned int next; /* next node in the same hash bucket, or on the free list */
+};
+
+/* Node storage, chunk i holds ids [i << PATH_CHUNK_SHIFT, (i + 1) << PATH_CHUNK_SHIFT) */
+extern struct path_node *PathChunks[PATH_MAX_CHUNKS];
+
+/* Routine Name    : PathNode
+ * INPUT ARGUMENTS : 1. unsigned int - A path id the caller holds a reference to
+ * RETURN VALUE    : const struct path_node * - The node of the path
+ */
+static inline const struct path_node *PathNode(unsigned int path)
+{
+  return &PathChunks[path >> PATH_CHUNK_SHIFT][path & ((1u << PATH_CHUNK_SHIFT) - 1)];
+}
+
+/* Routine Name    : PathContains
+ * INPUT ARGUMENTS : 1. unsigned int - A path id the caller holds a reference to
+ *                   2. unsigned int - A router id
+ * RETURN VALUE    : int - 1 if the router is on the path, 0 otherwise
+ * USAGE           : Used to reject paths that loop. Costs one bit test unless another
+ *                   router on the path shares the bit of the one looked for.
+ */
+static inline int PathContains(unsigned int path, unsigned int id)
+{
+  const struct path_node *node = PathNode(path);
+  unsigned int bit = id % PATH_BITMAP_BITS;
+  if (!((node->routers[bit / 64] >> (bit % 64)) & 1))
+  {
+    return 0;
+  }
+  while (node->length > 0)
+  {
+    if (node->hop == id)
+      return 1;
+    node = PathNode(node->parent);
+  }
+  return 0;
+}
+
+/* Routine Name    : PathExtend
+ * INPUT ARGUMENTS : 1. unsigned int - A path id
+ *                   2. unsigned int - The router to append to it
+ * RETURN VALUE    : unsigned int - The id of the longer path, holding a new reference
+ * USAGE           : Returns the existing id when the path is already known, so two paths
+ *                   are equal exactly when their ids are. Costs one hash lookup.
+ */
+unsigned int PathExtend(unsigned int parent, unsigned int hop);
+
+/* Routine Name    : PathFromHops
+ * INPUT ARGUMENTS : 1. unsigned int - First router on the path
+ *                   2. (const unsigned int *) - The routers that follow it, in order
+ *                   3. int - The number of routers that follow it
+ * RETURN VALUE    : unsigned int - The id of the path, holding a new reference
+ * USAGE           : Used to turn a path received from a neighbor into the path through it.
+ */
+unsigned int PathFromHops(unsigned int first, const unsigned int *hops, int count);
+
+/* Routine Name    : PathRetain / PathRelease
+ * INPUT ARGUMENTS : 1. unsigned int - A path id
+ * RETURN VALUE    : void
+ * USAGE           : Take and drop a reference. A path is freed with its last reference.
+ */
+void PathRetain(unsigned int path);
+void PathRelease(unsigned int path);
+
+/* Routine Name    : PathCopyHops
+ * INPUT ARGUMENTS : 1. unsigned int - A path id the caller holds a reference to
+ *                   2. (unsigned int *) - Receives the PathNode(path)->length hops, first hop first
+ * RETURN VALUE    : void
+ * USAGE           : Safe to call from any thread.
+ */
+void PathCopyHops(unsigned int path, unsigned int *hops);
+
+/* Routine Name    : PathCount
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : int - The number of distinct paths held, PATH_EMPTY included
+ */
+int PathCount(void);
+
+#endif
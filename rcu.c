@@ -0,0 +1,93 @@
+  /*
+   *  File Name: rcu.c
+   *
+   *  Purpose: Epoch based reclamation behind rcu.h.
+   */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rcu.h"
+
+// Struct of an object replaced by RcuPublish and not freed yet
+typedef struct
+{
+    void *value;
+    void (*reclaim)(void *);
+    unsigned long long epoch; // RcuEpoch before the publish that replaced it
+} retired_object;
+
+unsigned long long RcuEpoch = 1;
+
+static struct rcu_reader *Readers[RCU_MAX_READERS];
+static int NumReaders;
+
+// Owned by the writer
+static retired_object *Retired;
+static int NumRetired;
+static int RetiredCapacity;
+
+void RcuRegisterReader(struct rcu_reader *reader)
+{
+    __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELAXED);
+    int slot = __atomic_fetch_add(&NumReaders, 1, __ATOMIC_SEQ_CST);
+    if (slot >= RCU_MAX_READERS)
+    {
+        printf("More than %d RCU readers\n", RCU_MAX_READERS);
+        exit(EXIT_FAILURE);
+    }
+    __atomic_store_n(&Readers[slot], reader, __ATOMIC_SEQ_CST);
+}
+
+void RcuPublish(void **slot, void *value, void (*reclaim)(void *))
+{
+    void *old = __atomic_exchange_n(slot, value, __ATOMIC_SEQ_CST);
+    // Readers entering from here on see the new epoch, and so the new object
+    unsigned long long epoch = __atomic_fetch_add(&RcuEpoch, 1, __ATOMIC_SEQ_CST);
+    if (old != NULL)
+    {
+        if (NumRetired == RetiredCapacity)
+        {
+            RetiredCapacity = (RetiredCapacity == 0) ? RCU_MAX_READERS : 2 * RetiredCapacity;
+            Retired = realloc(Retired, RetiredCapacity * sizeof(retired_object));
+            if (Retired == NULL)
+            {
+                printf("Failed to grow the RCU retired list to %d objects\n", RetiredCapacity);
+                exit(EXIT_FAILURE);
+            }
+        }
+        Retired[NumRetired].value = old;
+        Retired[NumRetired].reclaim = reclaim;
+        Retired[NumRetired].epoch = epoch;
+        NumRetired += 1;
+    }
+    RcuReclaim();
+}
+
+int RcuReclaim(void)
+{
+    // An object retired at epoch e may be held by readers that entered at e or before
+    unsigned long long oldestHeld = 0;
+    int numReaders = __atomic_load_n(&NumReaders, __ATOMIC_SEQ_CST);
+    int i;
+    for (i = 0; i < numReaders && i < RCU_MAX_READERS; i++)
+    {
+        struct rcu_reader *reader = __atomic_load_n(&Readers[i], __ATOMIC_SEQ_CST);
+        unsigned long long epoch = (reader == NULL) ? 0 : __atomic_load_n(&reader->epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && (oldestHeld == 0 || epoch < oldestHeld))
+            oldestHeld = epoch;
+    }
+
+    int kept = 0;
+    for (i = 0; i < NumRetired; i++)
+    {
+        if (oldestHeld != 0 && oldestHeld <= Retired[i].epoch)
+        {
+            Retired[kept++] = Retired[i];
+            continue;
+        }
+        Retired[i].reclaim(Retired[i].value);
+    }
+    NumRetired = kept;
+    return NumRetired;
+}
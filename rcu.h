@@ -0,0 +1,73 @@
+/*rcu.h*/
+
+#ifndef RCU_H
+#define RCU_H
+
+  /*
+   *  File Name: rcu.h
+   *
+   *  Purpose: Read-copy-update for a single writer. The writer publishes a new
+   *  immutable version of an object with RcuPublish and never waits for readers:
+   *  the old version is freed later, once every reader has left the read section
+   *  it might have been seen in. Readers only do two stores and a load.
+   */
+
+#define RCU_MAX_READERS 8 /* threads that may read published objects */
+
+struct rcu_reader {
+  _Alignas(64) unsigned long long epoch; /* epoch the reader entered its read section in, 0 outside one */
+};
+
+/* Incremented by the writer on every publish, read by readers entering a read section */
+extern unsigned long long RcuEpoch;
+
+/* Routine Name    : RcuRegisterReader
+ * INPUT ARGUMENTS : 1. (struct rcu_reader *) - Reader state owned by the calling thread
+ * RETURN VALUE    : void
+ * USAGE           : Must be called once, before the thread first reads, and before the
+ *                   writer publishes anything it may read.
+ */
+void RcuRegisterReader(struct rcu_reader *reader);
+
+/* Routine Name    : RcuReadLock / RcuReadUnlock
+ * INPUT ARGUMENTS : 1. (struct rcu_reader *) - The calling thread's reader state
+ * RETURN VALUE    : void
+ * USAGE           : Objects loaded with RcuDereference between the two stay valid until RcuReadUnlock.
+ */
+static inline void RcuReadLock(struct rcu_reader *reader)
+{
+  __atomic_store_n(&reader->epoch, __atomic_load_n(&RcuEpoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+static inline void RcuReadUnlock(struct rcu_reader *reader)
+{
+  __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* Routine Name    : RcuDereference
+ * INPUT ARGUMENTS : 1. (void **) - Pointer the writer publishes to
+ * RETURN VALUE    : void * - The object published last
+ */
+static inline void *RcuDereference(void **slot)
+{
+  return __atomic_load_n(slot, __ATOMIC_SEQ_CST);
+}
+
+/* Routine Name    : RcuPublish
+ * INPUT ARGUMENTS : 1. (void **) - Pointer readers load the object through
+ *                   2. (void *) - The new object, readers must never see it change
+ *                   3. (void (*)(void *)) - Frees the object replaced
+ * RETURN VALUE    : void
+ * USAGE           : Called by the writer thread only. The replaced object is freed by this
+ *                   or a later RcuPublish or RcuReclaim, once no reader can hold it.
+ */
+void RcuPublish(void **slot, void *value, void (*reclaim)(void *));
+
+/* Routine Name    : RcuReclaim
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : int - Replaced objects still waiting for readers
+ * USAGE           : Called by the writer thread only. Frees the replaced objects no reader can hold.
+ */
+int RcuReclaim(void);
+
+#endif
@@ -0,0 +1,180 @@
+  /*
+   *  File Name: routelog-render.c
+   *
+   *  Purpose: Prints a binary routing log written by the router in the text
+   *  format PrintRoutes uses, so "routelog-render router0.rlog" gives what
+   *  router0.log used to hold.
+   *
+   *  Usage: routelog-render [-c] <log file>
+   *
+   *  -c  print only the current table, the one after the last record
+   */
+
+
+#include "ne.h"
+#include "routelog.h"
+#include <stdbool.h>
+
+// Struct of a logged route along with its next hops
+typedef struct
+{
+    struct routelog_route route;
+    unsigned int next_hop[MAX_NEXT_HOPS];
+} table_route;
+
+// The table rebuilt from the records, kept sorted by dest_id
+static table_route *Table;
+static int TableSize;
+static int TableCapacity;
+
+//-------------------------------------- FUNCTION DECLARATIONS---------------------*/
+
+/* Reads exactly size bytes, returns false at the end of the log */
+bool readExactly(FILE *logfd, void *data, size_t size, bool atRecordStart);
+/* Inserts a route or replaces the route to the same destination */
+void applyRoute(const table_route *route);
+/* Prints Table like PrintRoutes */
+void printTable(int routerID);
+
+/*------------------------------ START OF THE PROGRAM ---------------------------*/
+
+int main(int argc, char **argv)
+{
+    bool currentOnly = false;
+    int option;
+    while ((option = getopt(argc, argv, "c")) != -1)
+    {
+        if (option != 'c')
+        {
+            argc = 0;
+            break;
+        }
+        currentOnly = true;
+    }
+    if (argc - optind != 1)
+    {
+        printf("usage: routelog-render [-c] <log file>\n");
+        printf("       -c  print only the current table\n");
+        return EXIT_FAILURE;
+    }
+    FILE *logfd = fopen(argv[optind], "rb");
+    if (logfd == NULL)
+    {
+        printf("Failed to open %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    struct routelog_file_header header;
+    if (!readExactly(logfd, &header, sizeof(header), true) || header.magic != ROUTELOG_MAGIC)
+    {
+        printf("%s is not a routing log written on this host\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    bool printed = false;
+    struct routelog_record record;
+    while (readExactly(logfd, &record, sizeof(record), true))
+    {
+        if (record.type == ROUTELOG_CONVERGED)
+        {
+            if (!currentOnly)
+                printf("%u:Converged\n", record.value);
+            continue;
+        }
+        if (record.type != ROUTELOG_TABLE && record.type != ROUTELOG_FULL)
+        {
+            printf("Unknown record type %u\n", record.type);
+            return EXIT_FAILURE;
+        }
+        if (record.type == ROUTELOG_FULL)
+        {
+            TableSize = 0;
+        }
+        unsigned int i;
+        for (i = 0; i < record.no_routes; i++)
+        {
+            table_route route = {{0}};
+            readExactly(logfd, &route.route, sizeof(route.route), false);
+            if (route.route.no_next_hops > MAX_NEXT_HOPS)
+            {
+                printf("Route to R%u has %u next hops\n", route.route.dest_id, route.route.no_next_hops);
+                return EXIT_FAILURE;
+            }
+            readExactly(logfd, route.next_hop, route.route.no_next_hops * sizeof(unsigned int), false);
+            applyRoute(&route);
+        }
+        if (!currentOnly)
+            printTable(header.router_id);
+        printed = true;
+    }
+    if (currentOnly && printed)
+    {
+        printTable(header.router_id);
+    }
+    fclose(logfd);
+    free(Table);
+    return EXIT_SUCCESS;
+}
+
+bool readExactly(FILE *logfd, void *data, size_t size, bool atRecordStart)
+{
+    size_t got = fread(data, 1, size, logfd);
+    if (got == size)
+    {
+        return true;
+    }
+    // The router may still be writing the last record
+    if (got != 0 || !atRecordStart)
+    {
+        fprintf(stderr, "Log ends in the middle of a record\n");
+        exit(EXIT_FAILURE);
+    }
+    return false;
+}
+
+void applyRoute(const table_route *route)
+{
+    int low = 0;
+    int high = TableSize;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (Table[middle].route.dest_id < route->route.dest_id)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low < TableSize && Table[low].route.dest_id == route->route.dest_id)
+    {
+        Table[low] = *route;
+        return;
+    }
+    if (TableSize == TableCapacity)
+    {
+        TableCapacity = (TableCapacity == 0) ? MAX_ROUTERS : 2 * TableCapacity;
+        Table = realloc(Table, TableCapacity * sizeof(table_route));
+        if (Table == NULL)
+        {
+            printf("Failed to allocate %d routes\n", TableCapacity);
+            exit(EXIT_FAILURE);
+        }
+    }
+    memmove(&Table[low + 1], &Table[low], (TableSize - low) * sizeof(table_route));
+    Table[low] = *route;
+    TableSize += 1;
+}
+
+void printTable(int routerID)
+{
+    printf("\nRouting Table:\n");
+    int i;
+    for (i = 0; i < TableSize; i++)
+    {
+        printf("R%d -> R%u: R%u", routerID, Table[i].route.dest_id, Table[i].next_hop[0]);
+        unsigned int hop;
+        for (hop = 1; hop < Table[i].route.no_next_hops; hop++)
+        {
+            printf("|R%u", Table[i].next_hop[hop]);
+        }
+        printf(", %u\n", Table[i].route.cost);
+    }
+}
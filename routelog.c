@@ -0,0 +1,264 @@
+  /*
+   *  File Name: routelog.c
+   *
+   *  Purpose: Diff only binary logging of the routing table. The event loop
+   *  appends records to a lock-free ring, a writer thread drains it to the file.
+   */
+
+
+#include "ne.h"
+#include "router.h"
+#include "routelog.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdbool.h>
+
+// Struct of the ring shared by the event loop and the writer thread. head and tail
+// only ever grow, the byte at position p lives at bytes[p % ROUTELOG_RING_BYTES].
+typedef struct
+{
+    _Alignas(64) unsigned long long head; // bytes queued, only the event loop writes it
+    _Alignas(64) unsigned long long tail; // bytes written out, only the writer writes it
+    _Alignas(64) unsigned char *bytes;    // the records
+    sem_t ready;                          // posted once per record so an idle writer wakes up
+    sem_t drained;                        // posted by the writer when the event loop waits for room
+    bool waiting;                         // the event loop waits on drained
+    bool closing;                         // set by RouteLogClose, the writer exits once drained
+} route_ring;
+
+static route_ring Ring;
+static FILE *LogFile;
+static pthread_t Writer;
+
+// Owned by the event loop
+static unsigned int LoggedVersion;  // table version of the last record queued
+static bool NeedFull = true;        // the next record carries the whole table
+static unsigned long long Dropped;  // records dropped on a full ring
+
+// Copies size bytes to ring position at, wrapping around the end
+static void RingCopy(unsigned long long at, const void *data, size_t size)
+{
+    size_t start = at & (ROUTELOG_RING_BYTES - 1);
+    size_t first = (size < ROUTELOG_RING_BYTES - start) ? size : ROUTELOG_RING_BYTES - start;
+    memcpy(Ring.bytes + start, data, first);
+    memcpy(Ring.bytes, (const unsigned char *)data + first, size - first);
+}
+
+// Returns true if size bytes fit at ring position at, behind the ones the writer has not written out
+static bool RingHasRoom(unsigned long long at, size_t size)
+{
+    unsigned long long tail = __atomic_load_n(&Ring.tail, __ATOMIC_ACQUIRE);
+    return ROUTELOG_RING_BYTES - (at - tail) >= size;
+}
+
+// Hands every byte up to head to the writer
+static void RingPublish(unsigned long long head)
+{
+    __atomic_store_n(&Ring.head, head, __ATOMIC_RELEASE);
+    sem_post(&Ring.ready);
+}
+
+// Returns true once size bytes fit at ring position at. With wait set it hands the writer what
+// was copied up to at and waits for it to make room, otherwise it returns false on a full ring.
+static bool RingReserve(unsigned long long at, size_t size, bool wait)
+{
+    while (!RingHasRoom(at, size))
+    {
+        if (!wait)
+        {
+            return false;
+        }
+        RingPublish(at);
+        // The writer checks waiting after moving tail, one of the two sees the other's store
+        __atomic_store_n(&Ring.waiting, true, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (RingHasRoom(at, size))
+        {
+            break;
+        }
+        while (sem_wait(&Ring.drained) != 0 && errno == EINTR)
+        {
+        }
+    }
+    return true;
+}
+
+// Writes out whatever the event loop has published
+static void DrainRing(void)
+{
+    unsigned long long head = __atomic_load_n(&Ring.head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = Ring.tail;
+    if (head == tail)
+    {
+        return;
+    }
+    size_t start = tail & (ROUTELOG_RING_BYTES - 1);
+    size_t size = head - tail;
+    size_t first = (size < ROUTELOG_RING_BYTES - start) ? size : ROUTELOG_RING_BYTES - start;
+    if (fwrite(Ring.bytes + start, 1, first, LogFile) != first ||
+        fwrite(Ring.bytes, 1, size - first, LogFile) != size - first || fflush(LogFile) != 0)
+    {
+        printf("Failed to write the routing log with errno: %d\n", errno);
+    }
+    __atomic_store_n(&Ring.tail, head, __ATOMIC_RELEASE);
+}
+
+static void *WriteRecords(void *unused)
+{
+    while (true)
+    {
+        while (sem_wait(&Ring.ready) != 0 && errno == EINTR)
+        {
+        }
+        // Read closing first, everything published before it was set is then visible
+        bool closing = __atomic_load_n(&Ring.closing, __ATOMIC_ACQUIRE);
+        DrainRing();
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_exchange_n(&Ring.waiting, false, __ATOMIC_RELAXED))
+        {
+            sem_post(&Ring.drained);
+        }
+        if (closing)
+        {
+            return NULL;
+        }
+    }
+}
+
+int RouteLogOpen(const char *fileName, int myID)
+{
+    LogFile = fopen(fileName, "w");
+    Ring.bytes = malloc(ROUTELOG_RING_BYTES);
+    if (LogFile == NULL || Ring.bytes == NULL)
+    {
+        if (LogFile != NULL)
+            fclose(LogFile);
+        free(Ring.bytes);
+        LogFile = NULL;
+        return -1;
+    }
+    Ring.head = 0;
+    Ring.tail = 0;
+    Ring.waiting = false;
+    Ring.closing = false;
+    LoggedVersion = 0;
+    NeedFull = true;
+    Dropped = 0;
+
+    struct routelog_file_header header = {ROUTELOG_MAGIC, myID};
+    fwrite(&header, sizeof(header), 1, LogFile);
+    sem_init(&Ring.ready, 0, 0);
+    sem_init(&Ring.drained, 0, 0);
+
+    // Signals are left to the event loop, the writer starts with all of them blocked
+    sigset_t allSignals;
+    sigset_t callerSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_BLOCK, &allSignals, &callerSignals);
+    int created = pthread_create(&Writer, NULL, WriteRecords, NULL);
+    pthread_sigmask(SIG_SETMASK, &callerSignals, NULL);
+    if (created != 0)
+    {
+        sem_destroy(&Ring.ready);
+        sem_destroy(&Ring.drained);
+        fclose(LogFile);
+        free(Ring.bytes);
+        LogFile = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void RouteLogTable(void)
+{
+    if (LogFile == NULL)
+    {
+        return;
+    }
+    // A record of the whole table is never dropped, or every record after it would be one too
+    bool wholeTable = NeedFull;
+    unsigned int sinceVersion = wholeTable ? 0 : LoggedVersion;
+    int routeCount = CountRouteChanges(sinceVersion);
+    struct routelog_record record = {wholeTable ? ROUTELOG_FULL : ROUTELOG_TABLE, 0, GetTableVersion(), routeCount};
+    unsigned long long at = Ring.head;
+    if (!RingReserve(at, sizeof(record), wholeTable))
+    {
+        Dropped += 1;
+        NeedFull = true;
+        return;
+    }
+    RingCopy(at, &record, sizeof(record));
+    at += sizeof(record);
+
+    // Routes come off the change list a fragment at a time
+    static struct pkt_RT_UPDATE changes;
+    int cursor = -1;
+    int copied = 0;
+    while (copied < routeCount)
+    {
+        int changeCount = ConvertChangestoFragment(&changes, 0, sinceVersion, &cursor);
+        if (changeCount == 0)
+            break;
+        int i;
+        for (i = 0; i < changeCount; i++)
+        {
+            // Routes take only the next hops they have, a record of changes that outgrows the
+            // room left is dropped before anything of it is published
+            unsigned int nextHops[MAX_NEXT_HOPS];
+            struct routelog_route route = {changes.route[i].dest_id, changes.route[i].cost, 0};
+            route.no_next_hops = GetNextHops(route.dest_id, nextHops);
+            size_t hopBytes = route.no_next_hops * sizeof(unsigned int);
+            if (!RingReserve(at, sizeof(route) + hopBytes, wholeTable))
+            {
+                Dropped += 1;
+                NeedFull = true;
+                return;
+            }
+            RingCopy(at, &route, sizeof(route));
+            RingCopy(at + sizeof(route), nextHops, hopBytes);
+            at += sizeof(route) + hopBytes;
+        }
+        copied += changeCount;
+    }
+    RingPublish(at);
+    LoggedVersion = record.table_version;
+    NeedFull = false;
+}
+
+void RouteLogConverged(int runtime)
+{
+    if (LogFile == NULL)
+    {
+        return;
+    }
+    struct routelog_record record = {ROUTELOG_CONVERGED, runtime, GetTableVersion(), 0};
+    if (!RingHasRoom(Ring.head, sizeof(record)))
+    {
+        Dropped += 1;
+        return;
+    }
+    RingCopy(Ring.head, &record, sizeof(record));
+    RingPublish(Ring.head + sizeof(record));
+}
+
+unsigned long long RouteLogDropped(void)
+{
+    return Dropped;
+}
+
+void RouteLogClose(void)
+{
+    if (LogFile == NULL)
+    {
+        return;
+    }
+    __atomic_store_n(&Ring.closing, true, __ATOMIC_RELEASE);
+    sem_post(&Ring.ready);
+    pthread_join(Writer, NULL);
+    sem_destroy(&Ring.ready);
+    sem_destroy(&Ring.drained);
+    fclose(LogFile);
+    free(Ring.bytes);
+    LogFile = NULL;
+}
@@ -0,0 +1,88 @@
+/*routelog.h*/
+
+#ifndef ROUTELOG_H
+#define ROUTELOG_H
+
+  /*
+   *  File Name: routelog.h
+   *
+   *  Purpose: Logs the routing table without slowing the event loop. Each record
+   *  holds only the routes that changed since the previous one, in binary. Records
+   *  go into a single producer, single consumer lock-free ring and a background
+   *  thread writes them to the log file. routelog-render prints a log in the text
+   *  format of PrintRoutes.
+   *
+   *  The file is a routelog_file_header followed by records. A record is a
+   *  routelog_record followed by no_routes routes, each a routelog_route followed
+   *  by its no_next_hops next hops. Words are in host byte order, the magic number
+   *  tells a reader on another host that they are not.
+   */
+
+#define ROUTELOG_MAGIC 0x524c4733 /* "RLG3", routes carry only the next hops they have */
+#define ROUTELOG_RING_BYTES (1 << 22) /* bytes of records waiting for the writer, about 260000 single next hop routes */
+
+// Types of records
+#define ROUTELOG_TABLE 1     /* routes changed since the previous record, each record prints a table */
+#define ROUTELOG_FULL 2      /* every route, readers forget the table they had */
+#define ROUTELOG_CONVERGED 3 /* the table converged, value holds the runtime in seconds */
+
+struct routelog_file_header {
+  unsigned int magic; /* ROUTELOG_MAGIC */
+  unsigned int router_id; /* router that wrote the log */
+};
+
+struct routelog_record {
+  unsigned int type; /* ROUTELOG_TABLE, ROUTELOG_FULL or ROUTELOG_CONVERGED */
+  unsigned int value; /* runtime of ROUTELOG_CONVERGED records, 0 otherwise */
+  unsigned int table_version; /* table version the routes were logged at */
+  unsigned int no_routes; /* routelog_route entries following the record */
+};
+
+struct routelog_route {
+  unsigned int dest_id; /* destination router id */
+  unsigned int cost; /* cost to dest_id */
+  unsigned int no_next_hops; /* next hop words following the route, at most MAX_NEXT_HOPS. The next hop to
+                                dest_id comes first, then its equal cost next hops, see GetNextHops */
+};
+
+/* Routine Name    : RouteLogOpen
+ * INPUT ARGUMENTS : 1. (const char *) - Name of the log file, truncated if it exists
+ *                   2. int - My router's id
+ * RETURN VALUE    : int - 0 on success, -1 if the file or the writer thread could not be created
+ * USAGE           : Starts the writer thread. Only one log is open per process and the
+ *                   routes logged are those of the routing context selected when logging.
+ */
+int RouteLogOpen(const char *fileName, int myID);
+
+/* Routine Name    : RouteLogTable
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : void
+ * USAGE           : Takes the place of PrintRoutes. Queues the routes changed since the previous
+ *                   call, the whole table the first time. Never blocks on a record of changes: if
+ *                   the ring is full the record is dropped and the next one carries the whole table
+ *                   instead. A record of the whole table waits for the writer whenever the ring is
+ *                   full, so a table larger than the ring goes through in pieces and logging resumes.
+ */
+void RouteLogTable(void);
+
+/* Routine Name    : RouteLogConverged
+ * INPUT ARGUMENTS : 1. int - Runtime in seconds
+ * RETURN VALUE    : void
+ * USAGE           : Queues the "<runtime>:Converged" line of the log.
+ */
+void RouteLogConverged(int runtime);
+
+/* Routine Name    : RouteLogDropped
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : unsigned long long - Records dropped because the ring was full
+ */
+unsigned long long RouteLogDropped(void);
+
+/* Routine Name    : RouteLogClose
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : void
+ * USAGE           : Waits for the writer to write out every queued record, then closes the file.
+ */
+void RouteLogClose(void);
+
+#endif
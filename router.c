@@ -1,62 +1,386 @@
+#define _GNU_SOURCE
 #include "ne.h"
 #include "router.h"
+#include "timerwheel.h"
+#include "stats.h"
+#include "routelog.h"
+#include "rcu.h"
+#include "fib.h"
+#include "checkpoint.h"
 #include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <time.h>
 
-// Struct that stores neighbor node data
+// Struct that collects the fragments of one routing update from a neighbor
+typedef struct
+{
+    unsigned int update_seq;      // update currently being reassembled
+    unsigned int frag_count;      // fragments making up that update, 0 if none pending
+    unsigned int frags_rcvd;      // distinct fragments received so far
+    unsigned int capacity;        // fragments that fit in frags and frag_seen
+    struct pkt_RT_UPDATE *frags;  // received fragments, indexed by frag_no
+    bool *frag_seen;              // frag_seen[i] is true once fragment i has arrived
+} reassembly_buf;
+
+// Struct that caches the update for one neighbor, encoded in network byte order
+typedef struct
+{
+    bool valid;                   // false until the first encoding
+    unsigned int table_version;   // table version the routes were encoded at
+    unsigned int base_version;    // delta base the routes were encoded against
+    int frag_count;               // fragments in frags
+    int capacity;                 // fragments that fit in frags and sizes
+    struct pkt_RT_UPDATE *frags;  // encoded fragments, only the per send header words change
+    size_t *sizes;                // bytes to send from each fragment
+} encoded_update;
+
+// Struct that stores neighbor node data, at most MAX_ROUTERS neighbors like pkt_INIT_RESPONSE
 typedef struct
 {
     unsigned int no_nbr;
     unsigned int nbr_id[MAX_ROUTERS];
     unsigned int nbr_cost[MAX_ROUTERS];
     bool nbr_dead[MAX_ROUTERS];
-    struct itimerspec failureTimer[MAX_ROUTERS];
-    int failurefd[MAX_ROUTERS];
+    struct wheel_timer failureTimer[MAX_ROUTERS];
+    reassembly_buf reassembly[MAX_ROUTERS];
+    unsigned int nbr_epoch[MAX_ROUTERS];        // epoch the neighbor last announced
+    unsigned int applied_version[MAX_ROUTERS];  // last version of the neighbor's table applied here
+    unsigned int acked_version[MAX_ROUTERS];    // last version of my table the neighbor acknowledged
+    long long last_sent_ms[MAX_ROUTERS];        // monotonic time the neighbor was last sent an update
+    bool update_pending[MAX_ROUTERS];           // a triggered update is waiting for the spacing to pass
+    long long hold_ms[MAX_ROUTERS];             // silence after which the neighbor is declared dead, as it asked
+    long long detect_ms[MAX_ROUTERS];           // same for its heartbeats, 0 until one arrives
 
 } nbr_data;
 
+// Struct that queues outgoing datagrams so a whole fan-out goes out in one sendmmsg call
+typedef struct
+{
+    int count;                   // datagrams queued
+    int capacity;                // datagrams that fit before the arrays grow
+    struct mmsghdr *msgs;        // message headers handed to sendmmsg
+    struct iovec *iovs;          // one iovec per message, pointing at the encoded datagram
+} send_batch;
+
+// Struct of the positions of a single producer, single consumer ring. Both only grow,
+// entry n lives at n modulo the ring size. Each is on its own cache line.
+typedef struct
+{
+    _Alignas(64) unsigned long long head; // entries queued, written by the producer only
+    _Alignas(64) unsigned long long tail; // entries consumed, written by the consumer only
+    _Alignas(64) int wakefd;              // eventfd the producer writes to wake the consumer
+} spsc_ring;
+
+// Struct of one datagram the receive thread took off the socket
+typedef struct
+{
+    ssize_t size;                 // bytes received
+    struct pkt_RT_UPDATE pkt;     // the datagram, converted to host order by the compute thread
+} rx_slot;
+
+// Struct asking the send thread to send one neighbor its update
+typedef struct
+{
+    int nbr;                      // neighbor index, selects the neighbor's encoded update
+    unsigned int nbr_id;          // the neighbor's id
+    unsigned int base_version;    // delta base, 0 for the whole table
+    unsigned int update_seq;      // header words that change on every send
+    unsigned int ack_epoch;
+    unsigned int ack_version;
+    unsigned int hold_ms;
+} tx_request;
+
+// Struct that counts what the router does, written to router<id>.stats on SIGUSR1
+typedef struct
+{
+    unsigned long long loop_wakeups;              // epoll_wait returns
+    unsigned long long pkts_dropped;              // malformed packets, packets from non neighbors and updates too large to reassemble
+    unsigned long long link_cost_msgs;            // link cost changes announced by the network emulator
+    unsigned long long update_routes_calls;       // UpdateRoutes calls
+    unsigned long long update_routes_changes;     // UpdateRoutes calls that changed the table
+    unsigned long long nbr_deaths;                // neighbors declared dead
+    unsigned long long heartbeats_sent;
+    unsigned long long heartbeats_rcvd;
+    unsigned long long pkts_rcvd[MAX_ROUTERS];    // per neighbor, indexed like nbr_data
+    unsigned long long bytes_rcvd[MAX_ROUTERS];
+    unsigned long long pkts_sent[MAX_ROUTERS];
+    unsigned long long bytes_sent[MAX_ROUTERS];
+    unsigned long long rx_ring_full;              // times the receive thread waited for the compute thread
+    unsigned long long tx_requests_dropped;       // updates not sent because the send thread was behind
+    unsigned long long routes_restored;           // routes brought back from the checkpoint on a warm start
+    unsigned long long stale_routes_expired;      // restored routes a neighbor's whole table left out
+    struct stats_histogram update_routes_ns;      // latency of UpdateRoutes
+    struct stats_histogram encode_ns;             // latency of encoding one neighbor's update
+    struct stats_histogram snapshot_ns;           // latency of copying the table for the send thread
+    struct stats_histogram fib_sync_ns;           // latency of applying table changes to the FIB
+} router_stats;
+
+// Send each neighbor only the routes changed since the version it acknowledged (-d)
+static bool DeltaUpdates = false;
+// Advertise runs of consecutive destinations with the same next hop and cost as one summary (-a)
+static bool SummarizeUpdates = false;
+// Routes past which received summaries add no destinations (-l)
+static int SummaryLimit = MAX_TABLE_ROUTES;
+// Changes on every start so neighbors notice a restart and resync
+static unsigned int MyEpoch;
+// Minimum gap between two updates to one neighbor when a table change triggers them (-t)
+static long long TriggerSpacingMs = TRIGGER_SPACING_MS;
+// Start from the routes of the checkpoint left by the previous run (-w)
+static bool WarmStart = false;
+// Periods of the timers in milliseconds (-u, -f, -c), the last two follow the first unless given
+static long long UpdateIntervalMs = UPDATE_INTERVAL * 1000;
+static long long FailureDetectionMs = 0;
+static long long ConvergeTimeoutMs = 0;
+// Each update interval is drawn within this many percent either way of its length (-j)
+static int JitterPercent = UPDATE_JITTER_PERCENT;
+// While the table is stable the update interval doubles up to this many UpdateIntervalMs (-b)
+static int BackoffLimit = UPDATE_BACKOFF_LIMIT;
+// Update interval in use, between UpdateIntervalMs and BackoffLimit times it
+static long long CurrentIntervalMs;
+// Heartbeats sent to every neighbor this often, 0 sends none (-h)
+static long long HeartbeatMs = 0;
+// Heartbeats a neighbor may miss in a row before it declares this router dead (-m)
+static int HeartbeatMisses = HEARTBEAT_MISSES;
+
+// Types of timers kept in TimerWheel
+#define UPDATE_TIMER 1   /* periodic update, every CurrentIntervalMs give or take the jitter */
+#define CONVERGE_TIMER 2 /* table unchanged for ConvergeTimeoutMs */
+#define FAILURE_TIMER 3  /* neighbor silent for the hold time it asked for */
+#define TRIGGER_TIMER 4  /* held back triggered updates may be sent */
+#define HEARTBEAT_TIMER 5 /* heartbeats are due, every HeartbeatMs */
+
+#define RX_RING_SLOTS 1024 /* received datagrams waiting for the compute thread, a power of two */
+#define TX_RING_SLOTS 1024 /* send requests waiting for the send thread, a power of two */
+
+// Every deadline of the router lives in one timer wheel driven by a single timerfd
+static struct timer_wheel TimerWheel;
+static struct wheel_timer UpdateTimer;
+static struct wheel_timer ConvergeTimer;
+static struct wheel_timer TriggerTimer;
+static struct wheel_timer HeartbeatTimer;
+
+// The receive thread hands datagrams to the compute thread, the event loop, through RxRing.
+// The compute thread hands send requests to the send thread through TxRing. The send thread
+// encodes them from PublishedSnapshot, a copy of the table the compute thread replaces
+// through RCU, so neither waits for the other.
+static spsc_ring RxRing;
+static rx_slot RxSlots[RX_RING_SLOTS];
+static spsc_ring TxRing;
+static tx_request TxRequests[TX_RING_SLOTS];
+static unsigned long long TxUnpublished; // requests written behind TxRing.head, not handed over yet
+static struct route_snapshot *PublishedSnapshot;
+static pthread_t ReceiveThread;
+static pthread_t SendThread;
+static int StopReceivefd; // eventfd that stops the receive thread
+static bool StopSending;  // set before the last wakeup of the send thread
+
+// Read by both I/O threads, set before they start
+static int RouterSocket;
+static int MyRouterID;
+static struct sockaddr_in NeClient;
+
+// Owned by the send thread
+static encoded_update Encoded[MAX_ROUTERS]; // each neighbor's update, rebuilt when the table changes
+static send_batch SendBatch;                // outgoing datagrams waiting for flushDatagrams
+static struct rcu_reader SendReader;
+
+static router_stats Stats;
+static long long StartMs;
+
+// Next hop of every destination, for lookups from any thread
+static struct fib *Fib;
+
+// Routes and neighbor state saved for the next warm start
+static struct checkpoint *Checkpoint;
+
 //-------------------------------------- FUNCTION DECLARATIONS---------------------*/
 
 /* Binds router socket to listen for incoming UDP Connections and send UDP Packets */
 int listenfd(int serverPort);
 /* Send the initial request and the parses the initial response */
 int initiliazeRouter(int recvfd, int routerID, struct sockaddr_in *neClient, nbr_data *nbrData);
+/* Brings back the routes and neighbor state of the checkpoint, returns the number of routes restored */
+int warmStart(nbr_data *nbrData);
+/* Saves the routes changed since the last call and the state of every neighbor to the checkpoint */
+void checkpointRouter(nbr_data *nbrData);
 /* The heart of the program that does all function such as update, converge, timeout handling */
-void enableRouter(int recvfd, int routerID, FILE *configfd, nbr_data nbrData, struct sockaddr_in neClient);
+void enableRouter(int recvfd, int routerID, nbr_data nbrData, struct sockaddr_in neClient);
 /* ---------------------- ENABLEROUTER HELPER FUNCTIONS --------------------------*/
-/* Initializes a specific type of timer */
+/* Initializes a specific type of timer and starts it */
 /*
-    type = 1 --> update timer
-    type = 2 --> converge timer
-    type = 3 --> failure detection timer
+    type = UPDATE_TIMER   --> update timer
+    type = CONVERGE_TIMER --> converge timer
+    type = FAILURE_TIMER  --> failure detection timer of neighbor nbr
+    type = TRIGGER_TIMER  --> triggered update timer, left stopped
+    type = HEARTBEAT_TIMER --> heartbeat timer, stopped unless heartbeats are enabled
 */
-int initializeTimer(struct itimerspec *genericTimer, int type);
+void initializeTimer(struct wheel_timer *genericTimer, int type, int nbr);
 /* Reset a specific type of timer */
 /*
-    type = 1 --> update timer (reset to UPDATE_INTERVAL)
-    type = 2 --> converge timer (reset to CONVERGE_TIMEOUT)
-    type = 3 --> failure detection timer (reset to FAILURE_DETECTION)
+    type = UPDATE_TIMER   --> update timer (reset to CurrentIntervalMs, jittered)
+    type = CONVERGE_TIMER --> converge timer (reset to ConvergeTimeoutMs)
+    type = FAILURE_TIMER  --> failure detection timer (reset to FailureDetectionMs)
+    type = HEARTBEAT_TIMER --> heartbeat timer (reset to HeartbeatMs)
 */
-void resetTimer(struct itimerspec *genericTimer, int type, int genericfd);
-/* Parses all incoming routing table packets and upates the routing table */
-bool parseUpdates(struct pkt_RT_UPDATE updatePktRcvd, int recvfd, nbr_data *nbrData,
-                  int routerID, FILE *configfd, int convergefd, bool converged, struct itimerspec *convergeTimer);
-/* Converts the routing table to a packet and sends it to other routers */
-void sendUpdates(struct pkt_RT_UPDATE updatePktToSend, int recvfd, int updatefd, struct sockaddr_in neClient,
-                 struct itimerspec *updateTimer, int routerID, nbr_data *nbrData);
+void resetTimer(struct wheel_timer *genericTimer);
+/* Returns ms moved by a random amount of up to JitterPercent either way */
+long long jitterMs(long long ms);
+/* Doubles the update interval once the table is stable, returns it to UpdateIntervalMs on a change */
+void adaptUpdateInterval(bool converged, bool tableChanged);
+/* Returns CLOCK_MONOTONIC in milliseconds */
+long long monotonicMs(void);
+/* Starts a timer to fire after ms milliseconds, 0 stops it */
+void scheduleTimerMs(struct wheel_timer *genericTimer, long long ms);
+/* Points the timerfd driving the wheel at the wheel's next deadline */
+void armWheelfd(int wheelfd, long long wakeupMs);
+/* Starts the receive and send threads */
+void startPipeline(int recvfd, int routerID, struct sockaddr_in *neClient);
+/* Stops the receive and send threads once the send thread has sent every queued update */
+void stopPipeline(void);
+/* Receive thread, moves datagrams from the socket to RxRing */
+void *receiveDatagrams(void *unused);
+/* Send thread, encodes and sends the updates requested through TxRing */
+void *sendDatagrams(void *unused);
+/* Wakes the consumer of a ring */
+void wakeConsumer(spsc_ring *ring);
+/* Drains the datagrams queued by the receive thread and upates the routing table */
+bool parseUpdates(nbr_data *nbrData, int routerID, bool converged, bool *tableChanged);
+/* Validates one received routing table packet and applies it, returns 1 if the table changed */
+int handleUpdate(struct pkt_RT_UPDATE *updatePktRcvd, ssize_t pktSize, nbr_data *nbrData, int routerID);
+/* Keeps a neighbor alive on its heartbeat, never changes the table */
+int handleHeartbeat(struct pkt_HEARTBEAT *heartbeat, nbr_data *nbrData);
+/* Sends every neighbor a heartbeat */
+void sendHeartbeats(nbr_data *nbrData);
+/* Applies a link cost change announced by the network emulator, returns 1 if the table changed */
+int handleLinkCost(struct pkt_LINK_COST *linkCost, nbr_data *nbrData, int routerID);
+/* Calls UpdateRoutes, counting and timing the call */
+int timedUpdateRoutes(struct pkt_RT_UPDATE *RecvdUpdatePacket, int costToNbr, int myID);
+/* Stores a received fragment and applies the whole update once every fragment has arrived */
+int reassembleUpdate(struct pkt_RT_UPDATE *fragment, reassembly_buf *reassembly, int costToNbr, int routerID,
+                     unsigned int *appliedVersion);
+/* Settles the stale routes through the sender of an update just applied, returns 1 if the table changed */
+int settleStaleRoutes(struct pkt_RT_UPDATE *update);
+/* Asks the send thread for the routes one neighbor is missing and notes when they were sent */
+void sendUpdateToNbr(nbr_data *nbrData, int nbr);
+/* Hands the requests of sendUpdateToNbr to the send thread, with the table they were made against */
+void flushUpdates(void);
+/* Send thread, queues the datagrams of one request */
+void sendRequest(const struct route_snapshot *snapshot, tx_request *request);
+/* Send thread, re-encodes a neighbor's cached update if the table or its delta base moved */
+encoded_update *encodeUpdateForNbr(const struct route_snapshot *snapshot, tx_request *request);
+/* Send thread, adds an encoded datagram to SendBatch */
+void queueDatagram(void *datagram, size_t size);
+/* Send thread, sends every queued datagram with sendmmsg and empties SendBatch */
+void flushDatagrams(void);
+/* Sends pending triggered updates whose spacing has passed and starts TriggerTimer for the rest */
+void sendTriggeredUpdates(nbr_data *nbrData, bool tableChanged);
+/* Asks every neighbor for its whole table once a route got worse */
+void requestFullTablesIfWorsened(nbr_data *nbrData);
+/* Sends every neighbor its update */
+void sendUpdates(nbr_data *nbrData);
 /* Converges the tables */
-bool convergeTable(bool converged, FILE *configfd, struct itimerspec *convergeTimer, int convergefd, int runtime);
+bool convergeTable(bool converged, int runtime);
+/* Writes Stats to router<id>.stats */
+void dumpStats(int routerID, nbr_data *nbrData);
 
 /*------------------------------ START OF THE PROGRAM ---------------------------*/
 
 int main(int argc, char **argv)
 {
-    if (argc != 5)
+    int option;
+    bool badOption = false;
+    while ((option = getopt(argc, argv, "ab:c:df:h:j:l:m:t:u:w")) != -1)
     {
-        printf("Need 5 arguements to invoke this file\n");
-        printf("usage: router <routerid> <ne hostname> <ne UDP port> <router UDP port>\n");
+        switch (option)
+        {
+        case 'a':
+            SummarizeUpdates = true;
+            break;
+        case 'b':
+            BackoffLimit = atoi(optarg);
+            badOption = BackoffLimit < 1;
+            break;
+        case 'c':
+            ConvergeTimeoutMs = atoll(optarg);
+            badOption = ConvergeTimeoutMs <= 0;
+            break;
+        case 'd':
+            DeltaUpdates = true;
+            break;
+        case 'f':
+            FailureDetectionMs = atoll(optarg);
+            badOption = FailureDetectionMs <= 0;
+            break;
+        case 'h':
+            HeartbeatMs = atoll(optarg);
+            badOption = HeartbeatMs < 0;
+            break;
+        case 'j':
+            JitterPercent = atoi(optarg);
+            badOption = JitterPercent < 0 || JitterPercent >= 100;
+            break;
+        case 'l':
+            SummaryLimit = atoi(optarg);
+            badOption = SummaryLimit < 1;
+            break;
+        case 'm':
+            HeartbeatMisses = atoi(optarg);
+            badOption = HeartbeatMisses < 1;
+            break;
+        case 't':
+            TriggerSpacingMs = atoll(optarg);
+            badOption = TriggerSpacingMs < 0;
+            break;
+        case 'u':
+            UpdateIntervalMs = atoll(optarg);
+            badOption = UpdateIntervalMs <= 0;
+            break;
+        case 'w':
+            WarmStart = true;
+            break;
+        default:
+            badOption = true;
+        }
+        if (badOption)
+            break;
+    }
+    if (badOption || argc - optind != 4)
+    {
+        printf("Need 4 arguements to invoke this file\n");
+        printf("usage: router [-a] [-d] [-t ms] [-w] [-u ms] [-f ms] [-c ms] [-j percent] [-b limit] [-h ms] [-m count]\n");
+        printf("              [-l routes]\n");
+        printf("              <routerid> <ne hostname> <ne UDP port> <router UDP port>\n");
+        printf("       -a     advertise consecutive destinations behind the same next hop at the same cost\n");
+        printf("              as one summary route (DISTVECTOR only)\n");
+        printf("       -d     send only the routes changed since each neighbor's last acknowledged update\n");
+        printf("       -t ms  minimum gap between updates triggered to one neighbor (default %d)\n", TRIGGER_SPACING_MS);
+        printf("       -w     warm start from the routes checkpointed to router<routerid>.ckpt by the previous run\n");
+        printf("       -u ms  interval of the periodic updates (default %d)\n", UPDATE_INTERVAL * 1000);
+        printf("       -f ms  silence after which neighbors declare this router dead (default 3 update intervals)\n");
+        printf("       -c ms  time the table must stay unchanged to be converged (default 5 update intervals)\n");
+        printf("       -j percent  spread of each update interval either way (default %d)\n", UPDATE_JITTER_PERCENT);
+        printf("       -b limit    once converged the update interval doubles up to limit times -u, 1 never\n");
+        printf("                   backs off (default %d)\n", UPDATE_BACKOFF_LIMIT);
+        printf("       -h ms       send neighbors a heartbeat this often, they then detect a failure from the\n");
+        printf("                   heartbeats alone (default 0, none)\n");
+        printf("       -m count    heartbeats missed in a row before a neighbor declares this router dead\n");
+        printf("                   (default %d)\n", HEARTBEAT_MISSES);
+        printf("       -l routes   summary routes received add destinations only while the table holds fewer\n");
+        printf("                   routes (default %d)\n", MAX_TABLE_ROUTES);
+        printf("       SIGUSR1 writes packet counters and latency histograms to router<routerid>.stats\n");
+        printf("       The routing table is logged to router<routerid>.rlog, routelog-render prints it\n");
         return EXIT_FAILURE;
     }
+    argv += optind - 1;
+    FailureDetectionMs = (FailureDetectionMs == 0) ? UpdateIntervalMs * (FAILURE_DETECTION / UPDATE_INTERVAL) : FailureDetectionMs;
+    ConvergeTimeoutMs = (ConvergeTimeoutMs == 0) ? UpdateIntervalMs * (CONVERGE_TIMEOUT / UPDATE_INTERVAL) : ConvergeTimeoutMs;
+    CurrentIntervalMs = UpdateIntervalMs;
     char configFileName[FILENAME_MAX];
     char *udpHostname;
     int routerID;
@@ -65,9 +389,9 @@ int main(int argc, char **argv)
 
     // initializing all router ports, udp ports and log files
     routerID = atoi(argv[1]);
-    if (routerID < 0 || routerID > MAX_ROUTERS - 1)
+    if (routerID < 0)
     {
-        printf("Router ID must be between 0 and MAX_ROUTERS - 1\n");
+        printf("Router ID must not be negative\n");
         return EXIT_FAILURE;
     }
     udpHostname = argv[2];
@@ -75,14 +399,31 @@ int main(int argc, char **argv)
     routerPort = atoi(argv[4]);
     strcpy(configFileName, "router");
     strcat(configFileName, argv[1]);
-    strcat(configFileName, ".log");
-    FILE *configfd = fopen(configFileName, "w");
+    strcat(configFileName, ".rlog");
+    if (RouteLogOpen(configFileName, routerID) < 0)
+    {
+        printf("Failed to open the routing log %s\n", configFileName);
+        return EXIT_FAILURE;
+    }
+    char checkpointFileName[FILENAME_MAX];
+    snprintf(checkpointFileName, sizeof(checkpointFileName), "router%d.ckpt", routerID);
+    Checkpoint = CheckpointOpen(checkpointFileName, routerID);
+    if (Checkpoint == NULL)
+    {
+        printf("Failed to map the checkpoint %s with errno: %d\n", checkpointFileName, errno);
+        RouteLogClose();
+        return EXIT_FAILURE;
+    }
+    StartMs = monotonicMs();
+    MyEpoch = ((unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16)) | 1;
+    srandom(MyEpoch);
 
     // open socket and bind it and create the network emulator socket addr
     int recvfd = listenfd(routerPort);
     if (recvfd < 0)
     {
-        fclose(configfd);
+        RouteLogClose();
+        CheckpointClose(Checkpoint);
         printf("Failed to open ports with error code : %d\n", recvfd);
         return EXIT_FAILURE;
     }
@@ -109,20 +450,33 @@ int main(int argc, char **argv)
     if (initialize < 0)
     {
         printf("Failed initial correspondance with the network\n");
-        fclose(configfd);
+        RouteLogClose();
+        CheckpointClose(Checkpoint);
         close(recvfd);
         return EXIT_FAILURE;
     }
 
+    // The neighbors were just learned from the network emulator, the rest of the table may come
+    // from the checkpoint so the router forwards before it hears from anyone
+    if (WarmStart)
+    {
+        StatsAdd(&Stats.routes_restored, warmStart(&nbrData));
+    }
+
     // Writing the initialized values into the logfile
-    PrintRoutes(configfd, routerID);
+    RouteLogTable();
+    Fib = FibCreate();
+    FibSync(Fib);
+    checkpointRouter(&nbrData);
 
-    // Use timerfd style coding to update routing table information
+    // Use an epoll loop over the socket and one timerfd driving the timer wheel
     // https://www.programering.com/a/MDMzAjMwATc.html (Used for understanding how timerfd programming works)
-    enableRouter(recvfd, routerID, configfd, nbrData, networkEmulatorClient);
+    enableRouter(recvfd, routerID, nbrData, networkEmulatorClient);
 
-    // Closing file read operations on router closing
-    fclose(configfd);
+    // Write out the log records still queued on router closing
+    RouteLogClose();
+    FibDestroy(Fib);
+    CheckpointClose(Checkpoint);
     close(recvfd);
     return EXIT_SUCCESS;
 }
@@ -172,6 +526,13 @@ int initiliazeRouter(int recvfd, int routerID, struct sockaddr_in *neClient, nbr
         return -2;
     }
     ntoh_pkt_INIT_RESPONSE(&initialResponse);
+    // Per neighbor state is sized like nbrcost[], see MAX_ROUTERS in ne.h
+    if (initialResponse.no_nbr > MAX_ROUTERS)
+    {
+        printf("Initial response lists %u neighbors, at most %d are supported\n", initialResponse.no_nbr, MAX_ROUTERS);
+        return -2;
+    }
+    SetSummaryLimit(SummaryLimit);
     InitRoutingTbl(&initialResponse, routerID);
 
     // Storing all the neighbor information from the intial reponse
@@ -190,206 +551,1088 @@ int initiliazeRouter(int recvfd, int routerID, struct sockaddr_in *neClient, nbr
             nbrData->nbr_dead[i] = false;
         }
 
-        // initialize failure detection timers and file descriptor for each neighbor
-        nbrData->failurefd[i] = initializeTimer(&nbrData->failureTimer[i], 3);
+        bzero((char *)&nbrData->reassembly[i], sizeof(nbrData->reassembly[i]));
+        nbrData->nbr_epoch[i] = 0;
+        nbrData->applied_version[i] = 0;
+        nbrData->acked_version[i] = 0;
+        nbrData->last_sent_ms[i] = 0;
+        nbrData->update_pending[i] = false;
+        nbrData->hold_ms[i] = FailureDetectionMs;
+        nbrData->detect_ms[i] = 0;
     }
     return EXIT_SUCCESS;
 }
 
-// Implements the specific functionality of the router
-void enableRouter(int recvfd, int routerID, FILE *configfd, nbr_data nbrData, struct sockaddr_in neClient)
+int warmStart(nbr_data *nbrData)
+{
+    if (!Checkpoint->restorable)
+    {
+        return 0;
+    }
+    const struct checkpoint_header *saved = Checkpoint->header;
+
+    // Routes through a neighbor were costed with the link cost saved, shift them by how much it
+    // changed. Routes through a neighbor that is gone or down are left out.
+    int costShift[MAX_ROUTERS];
+    bool usable[MAX_ROUTERS];
+    unsigned int j;
+    for (j = 0; j < saved->no_nbr; j++)
+    {
+        const struct checkpoint_nbr *savedNbr = &saved->nbrs[j];
+        usable[j] = false;
+        int i;
+        for (i = 0; i < nbrData->no_nbr; i++)
+        {
+            if (nbrData->nbr_id[i] == savedNbr->nbr)
+                break;
+        }
+        if (i == nbrData->no_nbr || nbrData->nbr_dead[i] || savedNbr->cost >= INFINITY)
+        {
+            continue;
+        }
+        usable[j] = true;
+        costShift[j] = (int)nbrData->nbr_cost[i] - (int)savedNbr->cost;
+
+        // Claiming the neighbor's table as applied lets it send only what changed since. The link
+        // must not have changed, and paths are not saved, so PATHVECTOR routers hear every route again.
+#ifndef PATHVECTOR
+        if (costShift[j] == 0)
+        {
+            nbrData->nbr_epoch[i] = savedNbr->epoch;
+            nbrData->applied_version[i] = savedNbr->applied_version;
+        }
+#endif
+    }
+
+    int restored = 0;
+    unsigned int record;
+    for (record = 0; record < saved->no_routes; record++)
+    {
+        const struct checkpoint_route *route = &Checkpoint->routes[record];
+        for (j = 0; j < saved->no_nbr; j++)
+        {
+            if (saved->nbrs[j].nbr == route->next_hop)
+                break;
+        }
+        if (j == saved->no_nbr || !usable[j] || route->cost >= INFINITY)
+        {
+            continue;
+        }
+        long long cost = (long long)route->cost + costShift[j];
+        restored += RestoreRoute(route->dest_id, route->next_hop, (cost > INFINITY) ? INFINITY : cost);
+    }
+    return restored;
+}
+
+void checkpointRouter(nbr_data *nbrData)
 {
-    struct pkt_RT_UPDATE updatePktToSend;
-    struct pkt_RT_UPDATE updatePktRcvd;
+    struct checkpoint_nbr nbrs[MAX_ROUTERS];
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        nbrs[i].nbr = nbrData->nbr_id[i];
+        nbrs[i].cost = nbrData->nbr_cost[i];
+        nbrs[i].epoch = nbrData->nbr_epoch[i];
+        nbrs[i].applied_version = nbrData->applied_version[i];
+    }
+    CheckpointSync(Checkpoint, nbrs, nbrData->no_nbr);
+}
 
-    fd_set rdfs;
+// Implements the specific functionality of the router
+void enableRouter(int recvfd, int routerID, nbr_data nbrData, struct sockaddr_in neClient)
+{
+    // The receive thread's eventfd, the wheel's timerfd and a signalfd are the only descriptors,
+    // however many neighbors there are. SIGUSR1 dumps the stats, SIGINT and SIGTERM stop the
+    // router so the routing log is written out.
+    int epfd = epoll_create1(0);
+    int wheelfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    sigset_t handledSignals;
+    sigemptyset(&handledSignals);
+    sigaddset(&handledSignals, SIGUSR1);
+    sigaddset(&handledSignals, SIGINT);
+    sigaddset(&handledSignals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &handledSignals, NULL);
+    int signalsfd = signalfd(-1, &handledSignals, SFD_NONBLOCK);
 
-    // update timer file descriptor and intializations
-    struct itimerspec updateTimer;
-    int updatefd = initializeTimer(&updateTimer, 1);
+    // Started after the signals are blocked so only this thread takes them
+    startPipeline(recvfd, routerID, &neClient);
+    struct epoll_event event;
+    struct epoll_event events[3];
+    event.events = EPOLLIN;
+    event.data.fd = RxRing.wakefd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, RxRing.wakefd, &event);
+    event.data.fd = wheelfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wheelfd, &event);
+    event.data.fd = signalsfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, signalsfd, &event);
+    TimerWheelInit(&TimerWheel, monotonicMs());
+    long long armedWakeup = -1;
 
-    // converge time file descriptor and initializations
+    // update, converge and triggered update timers
+    initializeTimer(&UpdateTimer, UPDATE_TIMER, 0);
     bool converged = false;
-    struct itimerspec convergeTimer;
-    int convergefd = initializeTimer(&convergeTimer, 2);
+    initializeTimer(&ConvergeTimer, CONVERGE_TIMER, 0);
+    initializeTimer(&TriggerTimer, TRIGGER_TIMER, 0);
+    initializeTimer(&HeartbeatTimer, HEARTBEAT_TIMER, 0);
+    bool tableChanged = false;
 
-    // Keeps track of the program runtime (in seconds)
-    int runtime = 0;
+    // failure detection timer for each neighbor
+    for (int i = 0; i < nbrData.no_nbr; i++)
+    {
+        initializeTimer(&nbrData.failureTimer[i], FAILURE_TIMER, i);
+    }
 
-    // Use select to manipulate router funtionality
-    while (true)
+    // Use epoll to manipulate router funtionality
+    bool running = true;
+    while (running)
     {
-        FD_ZERO(&rdfs);
-        FD_SET(recvfd, &rdfs);
-        FD_SET(updatefd, &rdfs);
-        FD_SET(convergefd, &rdfs);
-        int maxfailurefd = nbrData.failurefd[0];
-        for (int i = 0; i < nbrData.no_nbr; i++)
+        long long wakeup = TimerWheelNextWakeup(&TimerWheel);
+        if (wakeup != armedWakeup)
         {
-            FD_SET(nbrData.failurefd[i], &rdfs);
-            maxfailurefd = (nbrData.failurefd[i] > maxfailurefd) ? nbrData.failurefd[i] : maxfailurefd;
+            armWheelfd(wheelfd, wakeup);
+            armedWakeup = wakeup;
         }
 
-        int selectfd = (convergefd > updatefd) ? convergefd : updatefd;
-        selectfd = (maxfailurefd > selectfd) ? maxfailurefd : selectfd;
-
-        // Running select to determine which module to run
-        if (select(selectfd + 1, &rdfs, NULL, NULL, NULL) == -1)
+        int readyfds = epoll_wait(epfd, events, 3, -1);
+        if (readyfds == -1)
         {
-            printf("Select failed with errno: %d\n", errno);
+            if (errno == EINTR)
+                continue;
+            printf("epoll_wait failed with errno: %d\n", errno);
             exit(EXIT_FAILURE);
         }
+        StatsAdd(&Stats.loop_wakeups, 1);
 
-        // Receive and parse updates from other routers
-        if (FD_ISSET(recvfd, &rdfs))
+        for (int i = 0; i < readyfds; i++)
         {
-            converged = parseUpdates(updatePktRcvd, recvfd, &nbrData, routerID,
-                                     configfd, convergefd, converged, &convergeTimer);
+            // Parse the updates from other routers the receive thread queued
+            if (events[i].data.fd == RxRing.wakefd)
+            {
+                converged = parseUpdates(&nbrData, routerID, converged, &tableChanged);
+            }
+            // Someone asked for the stats or for the router to stop
+            else if (events[i].data.fd == signalsfd)
+            {
+                struct signalfd_siginfo signalInfo;
+                while (read(signalsfd, &signalInfo, sizeof(signalInfo)) == sizeof(signalInfo))
+                {
+                    if (signalInfo.ssi_signo == SIGUSR1)
+                        dumpStats(routerID, &nbrData);
+                    else
+                        running = false;
+                }
+            }
+            // Consume the expiration so the timerfd stops polling readable
+            else
+            {
+                unsigned long long expirations;
+                if (read(wheelfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                {
+                    printf("Failed to read the timer with errno: %d\n", errno);
+                    exit(EXIT_FAILURE);
+                }
+                armedWakeup = -1;
+            }
         }
 
-        // Send updates to other routers
-        if (FD_ISSET(updatefd, &rdfs))
+        // Handle every timer that has come due
+        bool triggerDue = false;
+        struct wheel_timer *timer;
+        while ((timer = TimerWheelAdvance(&TimerWheel, monotonicMs())) != NULL)
         {
-            sendUpdates(updatePktToSend, recvfd, updatefd, neClient,
-                        &updateTimer, routerID, &nbrData);
-            runtime += 1;
+            switch (timer->type)
+            {
+            // Send updates to other routers
+            case UPDATE_TIMER:
+                adaptUpdateInterval(converged, false);
+                sendUpdates(&nbrData);
+                break;
+
+            // Routing table converged
+            case CONVERGE_TIMER:
+                converged = convergeTable(converged, (monotonicMs() - StartMs) / 1000);
+                break;
+
+            // One of my neighbors failed
+            case FAILURE_TIMER:
+                if (!nbrData.nbr_dead[timer->nbr])
+                {
+                    // Whatever it held of our table or we held of its table is gone, resync in full
+                    nbrData.applied_version[timer->nbr] = 0;
+                    nbrData.acked_version[timer->nbr] = 0;
+                    StatsAdd(&Stats.nbr_deaths, 1);
+                    UninstallRoutesOnNbrDeath(nbrData.nbr_id[timer->nbr]);
+                    RouteLogTable();
+                    resetTimer(&ConvergeTimer);
+                    converged = false;
+                    tableChanged = true;
+                }
+                nbrData.nbr_dead[timer->nbr] = true;
+                break;
+
+            // Held back triggered updates may go out now
+            case TRIGGER_TIMER:
+                triggerDue = true;
+                break;
+
+            // Tell the neighbors this router is alive
+            case HEARTBEAT_TIMER:
+                sendHeartbeats(&nbrData);
+                break;
+            }
         }
 
-        // Routing table converged
-        if (FD_ISSET(convergefd, &rdfs))
+        // Equal cost next hops change without the table counting as changed, the FIB
+        // follows every new table version
+        if (GetTableVersion() != Fib->version)
         {
-            converged = convergeTable(converged, configfd,
-                                      &convergeTimer, convergefd, runtime);
+            long long startNs = StatsNowNs();
+            FibSync(Fib);
+            StatsRecord(&Stats.fib_sync_ns, StatsNowNs() - startNs);
         }
 
-        // Check if any of my neighbors failed
-        for (int i = 0; i < nbrData.no_nbr; i++)
+        // Tell neighbors about table changes now instead of at the next update interval
+        if (tableChanged || triggerDue)
         {
-            if (FD_ISSET(nbrData.failurefd[i], &rdfs))
-            {
-                if (!nbrData.nbr_dead[i])
-                {
-                    UninstallRoutesOnNbrDeath(nbrData.nbr_id[i]);
-                    PrintRoutes(configfd, routerID);
-                    resetTimer(&convergeTimer, 2, convergefd);
-                }
-                nbrData.nbr_dead[i] = true;
-            }
+            requestFullTablesIfWorsened(&nbrData);
+            sendTriggeredUpdates(&nbrData, tableChanged);
+            adaptUpdateInterval(converged, tableChanged);
+            tableChanged = false;
         }
+        checkpointRouter(&nbrData);
     }
+    stopPipeline();
+    close(signalsfd);
+    close(wheelfd);
+    close(epfd);
 }
 
 //------------------------- ENABLE ROUTER BREAKDOWN ------------------------
-int initializeTimer(struct itimerspec *genericTimer, int type)
-{
-    if (type == 1)
-        genericTimer->it_value.tv_sec = UPDATE_INTERVAL;
-    else if (type == 2)
-        genericTimer->it_value.tv_sec = CONVERGE_TIMEOUT;
-    else if (type == 3)
-        genericTimer->it_value.tv_sec = FAILURE_DETECTION;
+void initializeTimer(struct wheel_timer *genericTimer, int type, int nbr)
+{
+    TimerInit(genericTimer, type, nbr);
+    if (type != TRIGGER_TIMER)
+    {
+        resetTimer(genericTimer);
+    }
+}
+
+long long monotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void scheduleTimerMs(struct wheel_timer *genericTimer, long long ms)
+{
+    if (ms == 0)
+        TimerWheelCancel(&TimerWheel, genericTimer);
     else
-        exit(EXIT_FAILURE);
-    genericTimer->it_value.tv_nsec = 0;
-    genericTimer->it_interval.tv_sec = 0;
-    genericTimer->it_interval.tv_nsec = 0;
-    int genericfd = timerfd_create(CLOCK_MONOTONIC, 0);
-    timerfd_settime(genericfd, 0, genericTimer, NULL);
-    return genericfd;
-}
-
-void resetTimer(struct itimerspec *genericTimer, int type, int genericfd)
-{
-    if (type == 1)
-        genericTimer->it_value.tv_sec = UPDATE_INTERVAL;
-    else if (type == 2)
-        genericTimer->it_value.tv_sec = CONVERGE_TIMEOUT;
-    else if (type == 3)
-        genericTimer->it_value.tv_sec = FAILURE_DETECTION;
+        TimerWheelSchedule(&TimerWheel, genericTimer, monotonicMs() + ms);
+}
+
+void armWheelfd(int wheelfd, long long wakeupMs)
+{
+    struct itimerspec wheelTimer;
+    bzero((char *)&wheelTimer, sizeof(wheelTimer));
+    if (wakeupMs >= 0)
+    {
+        // Absolute deadline, a time already passed fires straight away
+        wheelTimer.it_value.tv_sec = wakeupMs / 1000;
+        wheelTimer.it_value.tv_nsec = (wakeupMs % 1000) * 1000000;
+    }
+    timerfd_settime(wheelfd, TFD_TIMER_ABSTIME, &wheelTimer, NULL);
+}
+
+void resetTimer(struct wheel_timer *genericTimer)
+{
+    if (genericTimer->type == UPDATE_TIMER)
+        scheduleTimerMs(genericTimer, jitterMs(CurrentIntervalMs));
+    else if (genericTimer->type == CONVERGE_TIMER)
+        scheduleTimerMs(genericTimer, ConvergeTimeoutMs);
+    else if (genericTimer->type == FAILURE_TIMER)
+        scheduleTimerMs(genericTimer, FailureDetectionMs);
+    else if (genericTimer->type == HEARTBEAT_TIMER)
+        scheduleTimerMs(genericTimer, HeartbeatMs);
     else
         exit(EXIT_FAILURE);
-    genericTimer->it_value.tv_nsec = 0;
-    timerfd_settime(genericfd, 0, genericTimer, NULL);
 }
 
-bool parseUpdates(struct pkt_RT_UPDATE updatePktRcvd, int recvfd, nbr_data *nbrData,
-                  int routerID, FILE *configfd, int convergefd, bool converged, struct itimerspec *convergeTimer)
+long long jitterMs(long long ms)
+{
+    long long spread = ms * JitterPercent / 100;
+    if (spread == 0)
+    {
+        return ms;
+    }
+    return ms - spread + random() % (2 * spread + 1);
+}
+
+void adaptUpdateInterval(bool converged, bool tableChanged)
+{
+    // Churn needs the neighbors' periodic updates at the base rate again, restart the interval now
+    if (tableChanged)
+    {
+        if (CurrentIntervalMs != UpdateIntervalMs)
+        {
+            CurrentIntervalMs = UpdateIntervalMs;
+            resetTimer(&UpdateTimer);
+        }
+        return;
+    }
+    if (converged && CurrentIntervalMs < UpdateIntervalMs * BackoffLimit)
+    {
+        CurrentIntervalMs *= 2;
+        if (CurrentIntervalMs > UpdateIntervalMs * BackoffLimit)
+            CurrentIntervalMs = UpdateIntervalMs * BackoffLimit;
+    }
+}
+
+void startPipeline(int recvfd, int routerID, struct sockaddr_in *neClient)
+{
+    RouterSocket = recvfd;
+    MyRouterID = routerID;
+    NeClient = *neClient;
+    RxRing.wakefd = eventfd(0, EFD_NONBLOCK);
+    TxRing.wakefd = eventfd(0, 0);
+    StopReceivefd = eventfd(0, EFD_NONBLOCK);
+    if (RxRing.wakefd < 0 || TxRing.wakefd < 0 || StopReceivefd < 0)
+    {
+        printf("Failed to create the pipeline eventfds with errno: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+    RcuRegisterReader(&SendReader);
+    if (pthread_create(&ReceiveThread, NULL, receiveDatagrams, NULL) != 0 ||
+        pthread_create(&SendThread, NULL, sendDatagrams, NULL) != 0)
+    {
+        printf("Failed to start the receive and send threads\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void stopPipeline(void)
+{
+    unsigned long long stop = 1;
+    if (write(StopReceivefd, &stop, sizeof(stop)) < 0)
+    {
+        printf("Failed to stop the receive thread with errno: %d\n", errno);
+    }
+    flushUpdates();
+    __atomic_store_n(&StopSending, true, __ATOMIC_RELEASE);
+    wakeConsumer(&TxRing);
+    pthread_join(ReceiveThread, NULL);
+    pthread_join(SendThread, NULL);
+    close(StopReceivefd);
+    close(TxRing.wakefd);
+    close(RxRing.wakefd);
+}
+
+void wakeConsumer(spsc_ring *ring)
+{
+    unsigned long long wakeup = 1;
+    if (write(ring->wakefd, &wakeup, sizeof(wakeup)) < 0 && errno != EAGAIN)
+    {
+        printf("Failed to wake a pipeline thread with errno: %d\n", errno);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void *receiveDatagrams(void *unused)
+{
+    static struct mmsghdr msgs[RECV_BATCH];
+    static struct iovec iovs[RECV_BATCH];
+    struct pollfd fds[2];
+    fds[0].fd = RouterSocket;
+    fds[0].events = POLLIN;
+    fds[1].fd = StopReceivefd;
+    fds[1].events = POLLIN;
+
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("poll failed with errno: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            return NULL;
+        }
+
+        // Receive the update packets from other routers until the socket is drained
+        while (true)
+        {
+            unsigned long long head = RxRing.head;
+            unsigned long long freeSlots = RX_RING_SLOTS - (head - __atomic_load_n(&RxRing.tail, __ATOMIC_ACQUIRE));
+            if (freeSlots == 0)
+            {
+                // The compute thread is behind, leave the datagrams in the socket buffer a while
+                StatsAdd(&Stats.rx_ring_full, 1);
+                if (poll(&fds[1], 1, 1) > 0)
+                    return NULL;
+                continue;
+            }
+            int batch = (freeSlots < RECV_BATCH) ? freeSlots : RECV_BATCH;
+            int i;
+            for (i = 0; i < batch; i++)
+            {
+                rx_slot *slot = &RxSlots[(head + i) & (RX_RING_SLOTS - 1)];
+                iovs[i].iov_base = &slot->pkt;
+                iovs[i].iov_len = sizeof(slot->pkt);
+                bzero((char *)&msgs[i], sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int received = recvmmsg(RouterSocket, msgs, batch, MSG_DONTWAIT, NULL);
+            if (received < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                    break;
+                printf("recvmmsg failed with errno: %d", errno);
+                exit(EXIT_FAILURE);
+            }
+            for (i = 0; i < received; i++)
+            {
+                RxSlots[(head + i) & (RX_RING_SLOTS - 1)].size = msgs[i].msg_len;
+            }
+            __atomic_store_n(&RxRing.head, head + received, __ATOMIC_RELEASE);
+            wakeConsumer(&RxRing);
+            if (received < batch)
+                break;
+        }
+    }
+}
+
+bool parseUpdates(nbr_data *nbrData, int routerID, bool converged, bool *tableChanged)
 {
-    bzero((char *)&updatePktRcvd, sizeof(updatePktRcvd));
-    // Receive the update packt from other routers
-    if (recvfrom(recvfd, (struct pkt_RT_UPDATE *)&updatePktRcvd,
-                 sizeof(updatePktRcvd), 0, NULL, NULL) < 0)
+    int updatedTable = 0;
+    unsigned int tableVersion = GetTableVersion();
+
+    // Reset the eventfd first, datagrams queued from here on wake the event loop again
+    unsigned long long wakeups;
+    if (read(RxRing.wakefd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN)
     {
-        printf("recvfrom failed with errno: %d", errno);
+        printf("Failed to read the receive eventfd with errno: %d\n", errno);
         exit(EXIT_FAILURE);
     }
+    unsigned long long head = __atomic_load_n(&RxRing.head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = RxRing.tail;
+    while (tail != head)
+    {
+        rx_slot *slot = &RxSlots[tail & (RX_RING_SLOTS - 1)];
+        updatedTable |= handleUpdate(&slot->pkt, slot->size, nbrData, routerID);
+        tail += 1;
+
+        // Hand slots back a batch at a time so the receive thread can refill them
+        if ((tail & (RECV_BATCH - 1)) == 0)
+            __atomic_store_n(&RxRing.tail, tail, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&RxRing.tail, tail, __ATOMIC_RELEASE);
 
-    ntoh_pkt_RT_UPDATE(&updatePktRcvd);
+    // If the routing table updated, rest the converge count down timer and
+    // the converged flag. Equal cost next hops that changed alone are logged too.
+    if (updatedTable)
+    {
+        RouteLogTable();
+        resetTimer(&ConvergeTimer);
+        converged = false;
+        *tableChanged = true;
+    }
+    else if (GetTableVersion() != tableVersion)
+    {
+        RouteLogTable();
+    }
+    return converged;
+}
+
+int handleUpdate(struct pkt_RT_UPDATE *updatePktRcvd, ssize_t pktSize, nbr_data *nbrData, int routerID)
+{
+    if (pktSize == sizeof(struct pkt_LINK_COST))
+    {
+        StatsAdd(&Stats.link_cost_msgs, 1);
+        return handleLinkCost((struct pkt_LINK_COST *)updatePktRcvd, nbrData, routerID);
+    }
+    if (pktSize == sizeof(struct pkt_HEARTBEAT))
+    {
+        return handleHeartbeat((struct pkt_HEARTBEAT *)updatePktRcvd, nbrData);
+    }
+    ntoh_pkt_RT_UPDATE(updatePktRcvd);
+
+    // Drop anything that is not a well formed fragment, or that belongs to an update
+    // larger than any table so it cannot reserve reassembly buffers it will never fill
+    if (pktSize < RT_UPDATE_HDRSIZE || pktSize != size_pkt_RT_UPDATE(updatePktRcvd) ||
+        updatePktRcvd->frag_no >= updatePktRcvd->frag_count || updatePktRcvd->frag_count > MAX_UPDATE_FRAGS)
+    {
+        StatsAdd(&Stats.pkts_dropped, 1);
+        return 0;
+    }
     int costToNbr = -1;
 
     // Get the cost to the neighbor the packet came from
     int i = 0;
     for (i = 0; i < nbrData->no_nbr; i++)
     {
-        if (updatePktRcvd.sender_id == nbrData->nbr_id[i])
+        if (updatePktRcvd->sender_id == nbrData->nbr_id[i])
         {
             costToNbr = nbrData->nbr_cost[i];
             break;
         }
     }
-    // Since an update has been received if the neighbor is down reset it back to alive
-    resetTimer(&nbrData->failureTimer[i], 3, nbrData->failurefd[i]);
+    if (i == nbrData->no_nbr)
+    {
+        StatsAdd(&Stats.pkts_dropped, 1);
+        return 0;
+    }
+    StatsAdd(&Stats.pkts_rcvd[i], 1);
+    StatsAdd(&Stats.bytes_rcvd[i], pktSize);
+
+    // A new epoch means the neighbor restarted and holds none of our routes. It may not
+    // send heartbeats any more, its updates keep it alive until the next heartbeat.
+    if (updatePktRcvd->epoch != nbrData->nbr_epoch[i])
+    {
+        nbrData->nbr_epoch[i] = updatePktRcvd->epoch;
+        nbrData->applied_version[i] = 0;
+        nbrData->acked_version[i] = 0;
+        nbrData->detect_ms[i] = 0;
+    }
+
+    // Since an update has been received if the neighbor is down reset it back to alive. The
+    // neighbor says how long it may stay silent, it grows while the neighbor backs off.
+    // A neighbor sending heartbeats is timed by them alone.
+    nbrData->hold_ms[i] = (updatePktRcvd->hold_ms == 0) ? FailureDetectionMs : updatePktRcvd->hold_ms;
+    if (nbrData->detect_ms[i] == 0)
+    {
+        scheduleTimerMs(&nbrData->failureTimer[i], nbrData->hold_ms[i]);
+    }
     nbrData->nbr_dead[i] = false;
+    // Remember how much of my table the neighbor has, acknowledgements from an older run are ignored
+    if (updatePktRcvd->ack_epoch == MyEpoch && updatePktRcvd->ack_version <= GetTableVersion())
+    {
+        nbrData->acked_version[i] = updatePktRcvd->ack_version;
+    }
 
-    // Update the routing table
-    int updatedTable = UpdateRoutes(&updatePktRcvd, costToNbr, routerID);
+    // Update the routing table once the whole update has arrived
+    return reassembleUpdate(updatePktRcvd, &nbrData->reassembly[i], costToNbr, routerID,
+                            &nbrData->applied_version[i]);
+}
 
-    // If the routing table updated, rest the converge count down timer and
-    // the converged flag
-    if (updatedTable)
+int handleHeartbeat(struct pkt_HEARTBEAT *heartbeat, nbr_data *nbrData)
+{
+    swap_pkt_HEARTBEAT(heartbeat);
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
     {
-        PrintRoutes(configfd, routerID);
-        resetTimer(convergeTimer, 2, convergefd);
-        converged = false;
+        if (nbrData->nbr_id[i] == heartbeat->sender_id)
+            break;
     }
-    return converged;
+    if (i == nbrData->no_nbr || heartbeat->detect_ms == 0)
+    {
+        StatsAdd(&Stats.pkts_dropped, 1);
+        return 0;
+    }
+    StatsAdd(&Stats.heartbeats_rcvd, 1);
+
+    // A heartbeat from a new epoch means the neighbor restarted, its next update resyncs the rest
+    if (nbrData->nbr_epoch[i] != 0 && heartbeat->epoch != nbrData->nbr_epoch[i])
+    {
+        nbrData->acked_version[i] = 0;
+    }
+    nbrData->detect_ms[i] = heartbeat->detect_ms;
+    scheduleTimerMs(&nbrData->failureTimer[i], nbrData->detect_ms[i]);
+    nbrData->nbr_dead[i] = false;
+    return 0;
+}
+
+void sendHeartbeats(nbr_data *nbrData)
+{
+    // Sent from here rather than the send thread so they never wait behind an update being encoded
+    struct pkt_HEARTBEAT heartbeats[MAX_ROUTERS];
+    struct iovec iovs[MAX_ROUTERS];
+    struct mmsghdr msgs[MAX_ROUTERS];
+    bzero((char *)msgs, sizeof(msgs));
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        heartbeats[i].sender_id = MyRouterID;
+        heartbeats[i].dest_id = nbrData->nbr_id[i];
+        heartbeats[i].epoch = MyEpoch;
+        heartbeats[i].detect_ms = HeartbeatMs * HeartbeatMisses;
+        swap_pkt_HEARTBEAT(&heartbeats[i]);
+        iovs[i].iov_base = &heartbeats[i];
+        iovs[i].iov_len = sizeof(heartbeats[i]);
+        msgs[i].msg_hdr.msg_name = &NeClient;
+        msgs[i].msg_hdr.msg_namelen = sizeof(NeClient);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = 0;
+    while (sent < nbrData->no_nbr)
+    {
+        int batchSent = sendmmsg(RouterSocket, &msgs[sent], nbrData->no_nbr - sent, 0);
+        if (batchSent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("Failed to send heartbeats to other routers\n");
+            exit(EXIT_FAILURE);
+        }
+        sent += batchSent;
+    }
+    StatsAdd(&Stats.heartbeats_sent, nbrData->no_nbr);
+    resetTimer(&HeartbeatTimer);
 }
 
-void sendUpdates(struct pkt_RT_UPDATE updatePktToSend, int recvfd, int updatefd, struct sockaddr_in neClient,
-                 struct itimerspec *updateTimer, int routerID, nbr_data *nbrData)
+int handleLinkCost(struct pkt_LINK_COST *linkCost, nbr_data *nbrData, int routerID)
 {
-    bzero((char *)&updatePktToSend, sizeof(updatePktToSend));
-    ConvertTabletoPkt(&updatePktToSend, routerID);
+    swap_pkt_LINK_COST(linkCost);
+    if (linkCost->router_id != routerID || linkCost->cost == 0 || linkCost->cost > INFINITY)
+    {
+        return 0;
+    }
     int i;
     for (i = 0; i < nbrData->no_nbr; i++)
     {
-        updatePktToSend.dest_id = nbrData->nbr_id[i];
-        hton_pkt_RT_UPDATE(&updatePktToSend);
-        if (sendto(recvfd, (struct pkt_RT_UPDATE *)&updatePktToSend,
-                   sizeof(updatePktToSend), 0, (struct sockaddr *)&neClient,
-                   sizeof(neClient)) < 0)
+        if (nbrData->nbr_id[i] == linkCost->nbr)
+            break;
+    }
+    if (i == nbrData->no_nbr || nbrData->nbr_cost[i] == linkCost->cost)
+    {
+        return 0;
+    }
+    nbrData->nbr_cost[i] = linkCost->cost;
+
+    // Routes restored from a checkpoint were never heard from the neighbor, acknowledging
+    // nothing makes it resend its whole table so they are recomputed too
+    nbrData->applied_version[i] = 0;
+    nbrData->reassembly[i].frag_count = 0;
+
+    // Every route the neighbor advertised follows the new cost right away
+    return UpdateNbrCost(linkCost->nbr, linkCost->cost, routerID);
+}
+
+int timedUpdateRoutes(struct pkt_RT_UPDATE *RecvdUpdatePacket, int costToNbr, int myID)
+{
+    long long startNs = StatsNowNs();
+    int updatedTable = UpdateRoutes(RecvdUpdatePacket, costToNbr, myID);
+    StatsRecord(&Stats.update_routes_ns, StatsNowNs() - startNs);
+    StatsAdd(&Stats.update_routes_calls, 1);
+    StatsAdd(&Stats.update_routes_changes, updatedTable != 0);
+    return updatedTable;
+}
+
+int reassembleUpdate(struct pkt_RT_UPDATE *fragment, reassembly_buf *reassembly, int costToNbr, int routerID,
+                     unsigned int *appliedVersion)
+{
+    // A delta based on a version we never applied leaves a gap, drop it and keep
+    // acknowledging appliedVersion until the neighbor resends from there.
+    // Updates older than what was already applied are stale.
+    if (fragment->base_version > *appliedVersion || fragment->version < *appliedVersion)
+    {
+        return 0;
+    }
+
+    // Single fragment updates need no buffering
+    if (fragment->frag_count == 1)
+    {
+        reassembly->frag_count = 0;
+        *appliedVersion = fragment->version;
+        int updatedTable = timedUpdateRoutes(fragment, costToNbr, routerID);
+        return updatedTable | settleStaleRoutes(fragment);
+    }
+
+    // A fragment of a newer update abandons whatever was pending
+    if (reassembly->frag_count == 0 || reassembly->update_seq != fragment->update_seq ||
+        reassembly->frag_count != fragment->frag_count)
+    {
+        if (fragment->frag_count > reassembly->capacity)
         {
+            free(reassembly->frags);
+            free(reassembly->frag_seen);
+            reassembly->capacity = fragment->frag_count;
+            reassembly->frags = malloc(reassembly->capacity * sizeof(struct pkt_RT_UPDATE));
+            reassembly->frag_seen = malloc(reassembly->capacity * sizeof(bool));
+            if (reassembly->frags == NULL || reassembly->frag_seen == NULL)
+            {
+                // Drop the update rather than the router, the neighbor resends it
+                free(reassembly->frags);
+                free(reassembly->frag_seen);
+                reassembly->frags = NULL;
+                reassembly->frag_seen = NULL;
+                reassembly->capacity = 0;
+                reassembly->frag_count = 0;
+                StatsAdd(&Stats.pkts_dropped, 1);
+                return 0;
+            }
+        }
+        reassembly->update_seq = fragment->update_seq;
+        reassembly->frag_count = fragment->frag_count;
+        reassembly->frags_rcvd = 0;
+        bzero((char *)reassembly->frag_seen, reassembly->frag_count * sizeof(bool));
+    }
+
+    if (!reassembly->frag_seen[fragment->frag_no])
+    {
+        memcpy(&reassembly->frags[fragment->frag_no], fragment, size_pkt_RT_UPDATE(fragment));
+        reassembly->frag_seen[fragment->frag_no] = true;
+        reassembly->frags_rcvd += 1;
+    }
+    if (reassembly->frags_rcvd < reassembly->frag_count)
+    {
+        return 0;
+    }
+
+    // Every fragment is in, apply them in order
+    int updatedTable = 0;
+    unsigned int fragNo;
+    for (fragNo = 0; fragNo < reassembly->frag_count; fragNo++)
+    {
+        updatedTable |= timedUpdateRoutes(&reassembly->frags[fragNo], costToNbr, routerID);
+    }
+    reassembly->frag_count = 0;
+    *appliedVersion = fragment->version;
+    return updatedTable | settleStaleRoutes(fragment);
+}
+
+int settleStaleRoutes(struct pkt_RT_UPDATE *update)
+{
+    if (CountStaleRoutes() == 0)
+    {
+        return 0;
+    }
+    int expired = RefreshStaleRoutes(update->sender_id, update->base_version == 0);
+    StatsAdd(&Stats.stale_routes_expired, expired);
+    return expired > 0;
+}
+
+void sendUpdateToNbr(nbr_data *nbrData, int nbr)
+{
+    // Every update gets a new sequence number so receivers never mix fragments of two tables
+    static unsigned int updateSeq = 0;
+    updateSeq += 1;
+
+    unsigned long long at = TxRing.head + TxUnpublished;
+    if (at - __atomic_load_n(&TxRing.tail, __ATOMIC_ACQUIRE) == TX_RING_SLOTS)
+    {
+        // The periodic update makes up for it
+        StatsAdd(&Stats.tx_requests_dropped, 1);
+        return;
+    }
+    tx_request *request = &TxRequests[at & (TX_RING_SLOTS - 1)];
+    request->nbr = nbr;
+    request->nbr_id = nbrData->nbr_id[nbr];
+    // A delta holds the routes changed since the neighbor's acknowledgement, the full table otherwise
+    request->base_version = DeltaUpdates ? nbrData->acked_version[nbr] : 0;
+    request->update_seq = updateSeq;
+    request->ack_epoch = nbrData->nbr_epoch[nbr];
+    request->ack_version = nbrData->applied_version[nbr];
+    // Covers the longest gap until the next periodic update, jitter included
+    request->hold_ms = FailureDetectionMs * CurrentIntervalMs / UpdateIntervalMs;
+    TxUnpublished += 1;
+
+    nbrData->last_sent_ms[nbr] = monotonicMs();
+    nbrData->update_pending[nbr] = false;
+}
+
+static void reclaimSnapshot(void *snapshot)
+{
+    FreeRouteSnapshot(snapshot);
+}
+
+void flushUpdates(void)
+{
+    if (TxUnpublished == 0)
+    {
+        return;
+    }
+    // The send thread must see at least the table the requests were made against
+    if (PublishedSnapshot == NULL || PublishedSnapshot->table_version != GetTableVersion())
+    {
+        long long startNs = StatsNowNs();
+        RcuPublish((void **)&PublishedSnapshot, SnapshotRoutingTbl(), reclaimSnapshot);
+        StatsRecord(&Stats.snapshot_ns, StatsNowNs() - startNs);
+    }
+    __atomic_store_n(&TxRing.head, TxRing.head + TxUnpublished, __ATOMIC_RELEASE);
+    TxUnpublished = 0;
+    wakeConsumer(&TxRing);
+}
+
+void *sendDatagrams(void *unused)
+{
+    while (true)
+    {
+        unsigned long long wakeups;
+        if (read(TxRing.wakefd, &wakeups, sizeof(wakeups)) < 0 && errno != EINTR)
+        {
+            printf("Failed to read the send eventfd with errno: %d\n", errno);
+            exit(EXIT_FAILURE);
+        }
+        bool stopping = __atomic_load_n(&StopSending, __ATOMIC_ACQUIRE);
+        unsigned long long head = __atomic_load_n(&TxRing.head, __ATOMIC_ACQUIRE);
+        unsigned long long tail = TxRing.tail;
+        if (tail != head)
+        {
+            bool queued[MAX_ROUTERS] = {false};
+            RcuReadLock(&SendReader);
+            struct route_snapshot *snapshot = RcuDereference((void **)&PublishedSnapshot);
+            for (; tail != head; tail++)
+            {
+                tx_request *request = &TxRequests[tail & (TX_RING_SLOTS - 1)];
+                // A neighbor's datagrams are patched in place, send what is queued for it first
+                if (queued[request->nbr])
+                {
+                    flushDatagrams();
+                    bzero((char *)queued, sizeof(queued));
+                }
+                sendRequest(snapshot, request);
+                queued[request->nbr] = true;
+            }
+            RcuReadUnlock(&SendReader);
+            __atomic_store_n(&TxRing.tail, tail, __ATOMIC_RELEASE);
+            flushDatagrams();
+        }
+        if (stopping)
+        {
+            return NULL;
+        }
+    }
+}
+
+void sendRequest(const struct route_snapshot *snapshot, tx_request *request)
+{
+    encoded_update *encoded = encodeUpdateForNbr(snapshot, request);
+
+    // Only the sequence number and the acknowledgement differ from the cached encoding
+    int fragNo;
+    for (fragNo = 0; fragNo < encoded->frag_count; fragNo++)
+    {
+        struct pkt_RT_UPDATE *updatePktToSend = &encoded->frags[fragNo];
+        updatePktToSend->update_seq = htonl(request->update_seq);
+        updatePktToSend->ack_epoch = htonl(request->ack_epoch);
+        updatePktToSend->ack_version = htonl(request->ack_version);
+        updatePktToSend->hold_ms = htonl(request->hold_ms);
+        queueDatagram(updatePktToSend, encoded->sizes[fragNo]);
+        StatsAdd(&Stats.bytes_sent[request->nbr], encoded->sizes[fragNo]);
+    }
+    StatsAdd(&Stats.pkts_sent[request->nbr], encoded->frag_count);
+}
+
+encoded_update *encodeUpdateForNbr(const struct route_snapshot *snapshot, tx_request *request)
+{
+    encoded_update *encoded = &Encoded[request->nbr];
+    unsigned int tableVersion = snapshot->table_version;
+    unsigned int baseVersion = request->base_version;
+    if (encoded->valid && encoded->table_version == tableVersion && encoded->base_version == baseVersion)
+    {
+        return encoded;
+    }
+    long long startNs = StatsNowNs();
+
+    // Paths and summaries make the number of routes per fragment vary, fragments are filled until the
+    // cursor has read every change
+    int cursor = -1;
+    int fragCount = 0;
+    do
+    {
+        if (fragCount == encoded->capacity)
+        {
+            encoded->capacity = (encoded->capacity == 0) ? 1 : 2 * encoded->capacity;
+            encoded->frags = realloc(encoded->frags, encoded->capacity * sizeof(struct pkt_RT_UPDATE));
+            encoded->sizes = realloc(encoded->sizes, encoded->capacity * sizeof(size_t));
+            if (encoded->frags == NULL || encoded->sizes == NULL)
+            {
+                printf("Failed to allocate %d fragments for R%d\n", encoded->capacity, request->nbr_id);
+                exit(EXIT_FAILURE);
+            }
+        }
+        struct pkt_RT_UPDATE *fragment = &encoded->frags[fragCount];
+        int routeCount = EncodeSnapshotFragment(snapshot, fragment, baseVersion, &cursor, request->nbr_id,
+                                                SummarizeUpdates, &encoded->sizes[fragCount]);
+        fragment->sender_id = htonl(MyRouterID);
+        fragment->dest_id = htonl(request->nbr_id);
+        fragment->no_routes = htonl(routeCount);
+        fragment->frag_no = htonl(fragCount);
+        fragment->epoch = htonl(MyEpoch);
+        fragment->version = htonl(tableVersion);
+        fragment->base_version = htonl(baseVersion);
+        fragCount += 1;
+    } while (cursor < snapshot->num_routes);
+    int fragNo;
+    for (fragNo = 0; fragNo < fragCount; fragNo++)
+    {
+        encoded->frags[fragNo].frag_count = htonl(fragCount);
+    }
+    encoded->valid = true;
+    encoded->table_version = tableVersion;
+    encoded->base_version = baseVersion;
+    encoded->frag_count = fragCount;
+    StatsRecord(&Stats.encode_ns, StatsNowNs() - startNs);
+    return encoded;
+}
+
+void queueDatagram(void *datagram, size_t size)
+{
+    if (SendBatch.count == SendBatch.capacity)
+    {
+        int capacity = (SendBatch.capacity == 0) ? MAX_ROUTERS : 2 * SendBatch.capacity;
+        SendBatch.msgs = realloc(SendBatch.msgs, capacity * sizeof(struct mmsghdr));
+        SendBatch.iovs = realloc(SendBatch.iovs, capacity * sizeof(struct iovec));
+        if (SendBatch.msgs == NULL || SendBatch.iovs == NULL)
+        {
+            printf("Failed to grow the send batch to %d datagrams\n", capacity);
+            exit(EXIT_FAILURE);
+        }
+        SendBatch.capacity = capacity;
+    }
+    SendBatch.iovs[SendBatch.count].iov_base = datagram;
+    SendBatch.iovs[SendBatch.count].iov_len = size;
+    SendBatch.count += 1;
+}
+
+void flushDatagrams(void)
+{
+    int i;
+    for (i = 0; i < SendBatch.count; i++)
+    {
+        bzero((char *)&SendBatch.msgs[i], sizeof(SendBatch.msgs[i]));
+        SendBatch.msgs[i].msg_hdr.msg_name = &NeClient;
+        SendBatch.msgs[i].msg_hdr.msg_namelen = sizeof(NeClient);
+        SendBatch.msgs[i].msg_hdr.msg_iov = &SendBatch.iovs[i];
+        SendBatch.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // sendmmsg may send fewer messages than asked for, carry on from where it stopped
+    int sent = 0;
+    while (sent < SendBatch.count)
+    {
+        int batchSent = sendmmsg(RouterSocket, &SendBatch.msgs[sent], SendBatch.count - sent, 0);
+        if (batchSent < 0)
+        {
+            if (errno == EINTR)
+                continue;
             printf("Failed to send data to other routers\n");
             exit(EXIT_FAILURE);
         }
-        ntoh_pkt_RT_UPDATE(&updatePktToSend);
+        sent += batchSent;
     }
+    SendBatch.count = 0;
+}
+
+void sendTriggeredUpdates(nbr_data *nbrData, bool tableChanged)
+{
+    long long now = monotonicMs();
+    long long nextDue = -1;
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        // A table change owes every neighbor an update
+        if (!tableChanged && !nbrData->update_pending[i])
+        {
+            continue;
+        }
+        long long due = nbrData->last_sent_ms[i] + TriggerSpacingMs;
+        if (due <= now)
+        {
+            sendUpdateToNbr(nbrData, i);
+        }
+        else
+        {
+            // Too soon after the last update, hold it back until the spacing has passed
+            nbrData->update_pending[i] = true;
+            nextDue = (nextDue < 0 || due < nextDue) ? due : nextDue;
+        }
+    }
+    flushUpdates();
+    scheduleTimerMs(&TriggerTimer, (nextDue < 0) ? 0 : nextDue - now);
+}
+
+void requestFullTablesIfWorsened(nbr_data *nbrData)
+{
+    static unsigned int seenWorsenedVersion = 0;
+    if (GetWorsenedVersion() == seenWorsenedVersion)
+    {
+        return;
+    }
+    seenWorsenedVersion = GetWorsenedVersion();
+
+    // With delta updates a neighbor never resends a route that did not change. Acknowledging
+    // nothing makes each one resend its whole table, so cheaper routes it knows are heard again.
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        nbrData->applied_version[i] = 0;
+        nbrData->reassembly[i].frag_count = 0;
+    }
+}
+
+void sendUpdates(nbr_data *nbrData)
+{
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        sendUpdateToNbr(nbrData, i);
+    }
+    flushUpdates();
 
     // Reset the update interval
-    resetTimer(updateTimer, 1, updatefd);
+    resetTimer(&UpdateTimer);
 }
 
-bool convergeTable(bool converged, FILE *configfd, struct itimerspec *convergeTimer, int convergefd, int runtime)
+bool convergeTable(bool converged, int runtime)
 {
     // Print converged at the end of the file
     if (!converged)
     {
-        fprintf(configfd, "%d:Converged\n", runtime);
-        fflush(configfd);
+        RouteLogConverged(runtime);
         converged = true;
     }
 
     // Reset converge timeout
-    resetTimer(convergeTimer, 2, convergefd);
+    resetTimer(&ConvergeTimer);
     return converged;
-}
\ No newline at end of file
+}
+
+void dumpStats(int routerID, nbr_data *nbrData)
+{
+    char statsFileName[FILENAME_MAX];
+    snprintf(statsFileName, sizeof(statsFileName), "router%d.stats", routerID);
+    FILE *statsfd = fopen(statsFileName, "w");
+    if (statsfd == NULL)
+    {
+        printf("Failed to open %s with errno: %d\n", statsFileName, errno);
+        return;
+    }
+    fprintf(statsfd, "uptime_ms %lld\n", monotonicMs() - StartMs);
+    fprintf(statsfd, "table_version %u\n", GetTableVersion());
+    fprintf(statsfd, "update_interval_ms %lld\n", CurrentIntervalMs);
+    fprintf(statsfd, "loop_wakeups %llu\n", StatsRead(&Stats.loop_wakeups));
+    fprintf(statsfd, "pkts_dropped %llu\n", StatsRead(&Stats.pkts_dropped));
+    fprintf(statsfd, "link_cost_msgs %llu\n", StatsRead(&Stats.link_cost_msgs));
+    fprintf(statsfd, "update_routes_calls %llu\n", StatsRead(&Stats.update_routes_calls));
+    fprintf(statsfd, "update_routes_changes %llu\n", StatsRead(&Stats.update_routes_changes));
+    fprintf(statsfd, "nbr_deaths %llu\n", StatsRead(&Stats.nbr_deaths));
+    fprintf(statsfd, "heartbeats_sent %llu\n", StatsRead(&Stats.heartbeats_sent));
+    fprintf(statsfd, "heartbeats_rcvd %llu\n", StatsRead(&Stats.heartbeats_rcvd));
+    fprintf(statsfd, "log_records_dropped %llu\n", RouteLogDropped());
+    fprintf(statsfd, "rx_ring_full %llu\n", StatsRead(&Stats.rx_ring_full));
+    fprintf(statsfd, "tx_requests_dropped %llu\n", StatsRead(&Stats.tx_requests_dropped));
+    fprintf(statsfd, "routes_restored %llu\n", StatsRead(&Stats.routes_restored));
+    fprintf(statsfd, "stale_routes_expired %llu\n", StatsRead(&Stats.stale_routes_expired));
+    fprintf(statsfd, "stale_routes %d\n", CountStaleRoutes());
+    fprintf(statsfd, "summaries_clamped %d\n", CountClampedSummaries());
+    int i;
+    for (i = 0; i < nbrData->no_nbr; i++)
+    {
+        fprintf(statsfd, "nbr %u dead %d pkts_rcvd %llu bytes_rcvd %llu pkts_sent %llu bytes_sent %llu hold_ms %lld\n",
+                nbrData->nbr_id[i], nbrData->nbr_dead[i], StatsRead(&Stats.pkts_rcvd[i]),
+                StatsRead(&Stats.bytes_rcvd[i]), StatsRead(&Stats.pkts_sent[i]), StatsRead(&Stats.bytes_sent[i]),
+                nbrData->hold_ms[i]);
+    }
+    StatsPrintHistogram(statsfd, "update_routes", &Stats.update_routes_ns);
+    StatsPrintHistogram(statsfd, "encode_update", &Stats.encode_ns);
+    StatsPrintHistogram(statsfd, "snapshot", &Stats.snapshot_ns);
+    StatsPrintHistogram(statsfd, "fib_sync", &Stats.fib_sync_ns);
+    fclose(statsfd);
+}
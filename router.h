@@ -13,6 +13,41 @@
    */  
 
 
+/* Opaque per router state of routingtable.c, see CreateRoutingCtx */
+struct routing_ctx;
+
+
+
+/* Routine Name    : CreateRoutingCtx
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : struct routing_ctx * - A new, empty routing context
+ * USAGE           : Lets one process hold the routing tables of many routers. Every routine in this
+ *                   file works on the selected context. Processes that run a single router never
+ *                   need to create one, a default context is selected from the start.
+ */
+struct routing_ctx *CreateRoutingCtx(void);
+
+
+
+/* Routine Name    : SelectRoutingCtx
+ * INPUT ARGUMENTS : 1. (struct routing_ctx *) - The context to work on, NULL for the default context
+ * RETURN VALUE    : struct routing_ctx * - The context that was selected before
+ * USAGE           : Makes routingTable and NumRoutes refer to the given context. Switching costs a
+ *                   few pointer copies, so it may be done before every call into this file.
+ */
+struct routing_ctx *SelectRoutingCtx(struct routing_ctx *ctx);
+
+
+
+/* Routine Name    : DestroyRoutingCtx
+ * INPUT ARGUMENTS : 1. (struct routing_ctx *) - A context returned by CreateRoutingCtx
+ * RETURN VALUE    : void
+ * USAGE           : Frees the context and its routes. The default context is selected if it was in use.
+ */
+void DestroyRoutingCtx(struct routing_ctx *ctx);
+
+
+
 /* Routine Name    : InitRoutingTbl
  * INPUT ARGUMENTS : 1. (struct pkt_INIT_RESPONSE *) - The INIT_RESPONSE from Network Emulator
  *                   2. int - My router's id received from command line argument.
@@ -37,16 +72,47 @@ void InitRoutingTbl (struct pkt_INIT_RESPONSE *InitResponse, int myID);
  *                   it finds the shortest path using current cost and received cost. 
  *                   It also implements the forced update and split horizon rules. My router's id
  *                   that is passed as argument may be useful in applying split horizon rule.
+ *                   In PATHVECTOR mode a route is taken through the sender's path, and a path that
+ *                   already holds my router's id loops, so it counts as INFINITY. Loops are caught
+ *                   in one step instead of by counting to infinity.
+ *                   Every route received is also kept in the sender's Adj-RIB-In, the last routes each
+ *                   neighbor advertised. A forced update that makes a route worse moves it to a cheaper
+ *                   loop free route another neighbor advertised, if there is one. Without paths a route
+ *                   is loop free when the neighbor advertised less than the route cost before.
+ *                   Neighbors whose loop free route is exactly as cheap as the route's are kept as its
+ *                   equal cost next hops, see GetNextHops. Joining or leaving them stamps the route with
+ *                   a new table version, for the FIB and the logs, but alone does not count as a change.
+ *                   In DISTVECTOR mode a summary route, see ROUTE_RANGE in ne.h, is applied to every
+ *                   destination it covers, the table keeps one route per destination. Once the table
+ *                   holds the routes set by SetSummaryLimit a summary adds no more, the rest of its
+ *                   block is dropped and counted by CountClampedSummaries.
  */
 int UpdateRoutes(struct pkt_RT_UPDATE *RecvdUpdatePacket, int costToNbr, int myID);
 
 
 
+/* Routine Name    : UpdateNbrCost
+ * INPUT ARGUMENTS : 1. int - The id of the neighbor whose link cost changed
+ *                   2. int - The new cost of the link to it
+ *                   3. int - My router's id received from command line argument.
+ * RETURN VALUE    : int - Return 1 : if the routing table has changed on running the function.
+ *                         Return 0 : Otherwise.
+ * USAGE           : Recosts every route the neighbor advertised from its Adj-RIB-In, as if it had sent
+ *                   them all again over the new link, and the direct route to it. Routes through the
+ *                   neighbor that got worse move to a loop free alternate like in UpdateRoutes. Routes
+ *                   it never advertised, restored ones, wait for its next update.
+ */
+int UpdateNbrCost(int nbrID, int costToNbr, int myID);
+
+
+
 /* Routine Name    : ConvertTabletoPkt
  * INPUT ARGUMENTS : 1. (struct pkt_RT_UPDATE *) - An empty pkt_RT_UPDATE structure
  *                   2. int - My router's id received from command line argument.
  * RETURN VALUE    : void
  * USAGE           : This routine fills the routing table into the empty struct pkt_RT_UPDATE. 
+ *                   Only the first ROUTES_PER_PKT routes fit in one packet, larger tables
+ *                   must be sent with ConvertTabletoFragment.
  *                   My router's id  is copied to the sender_id in pkt_RT_UPDATE. 
  *                   Note that the dest_id is not filled in this function. When this update message 
  *                   is sent to all neighbors of the router, the dest_id is filled.
@@ -55,12 +121,168 @@ void ConvertTabletoPkt(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID);
 
 
 
+/* Routine Name    : ConvertTabletoFragment
+ * INPUT ARGUMENTS : 1. (struct pkt_RT_UPDATE *) - An empty pkt_RT_UPDATE structure
+ *                   2. int - My router's id received from command line argument.
+ *                   3. int - Index of the fragment to fill, starting at 0.
+ * RETURN VALUE    : int - The number of fragments needed to carry the whole routing table.
+ * USAGE           : This routine fills routes [fragNo * ROUTES_PER_PKT, (fragNo + 1) * ROUTES_PER_PKT)
+ *                   of the routing table into the packet and sets no_routes, frag_no and frag_count.
+ *                   The caller sends fragments 0 to frag_count - 1 with one update_seq, and fills
+ *                   dest_id and update_seq itself. In PATHVECTOR mode a fragment holds the routes
+ *                   whose paths fit, so finding one walks the table from the start.
+ */
+int ConvertTabletoFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID, int fragNo);
+
+
+
+/* Routine Name    : GetTableVersion
+ * INPUT ARGUMENTS : None
+ * RETURN VALUE    : unsigned int - The current version of the routing table.
+ * USAGE           : Every route added or changed by InitRoutingTbl, UpdateRoutes, UpdateNbrCost or UninstallRoutesOnNbrDeath
+ *                   is stamped with a new, increasing table version. A neighbor that has applied
+ *                   version v of this table only needs the routes changed after v.
+ */
+unsigned int GetTableVersion(void);
+
+
+
+/* Routine Name    : GetWorsenedVersion
+ * INPUT ARGUMENTS : None
+ * RETURN VALUE    : unsigned int - The table version of the last change that made a route more expensive,
+ *                   0 if no route got worse since InitRoutingTbl.
+ * USAGE           : A neighbor only resends routes that changed, so a cheaper route it advertised before
+ *                   is not heard again when the current route gets worse. Once this version moves the
+ *                   router should ask its neighbors for their whole tables.
+ */
+unsigned int GetWorsenedVersion(void);
+
+
+
+/* Routine Name    : CountRouteChanges
+ * INPUT ARGUMENTS : 1. unsigned int - A table version, 0 for the whole table.
+ * RETURN VALUE    : int - The number of routes changed after that version.
+ * USAGE           : Used to work out how many fragments a delta update needs. The cost grows
+ *                   with the number of changed routes, not with the size of the table.
+ */
+int CountRouteChanges(unsigned int sinceVersion);
+
+
+
+/* Routine Name    : ConvertChangestoFragment
+ * INPUT ARGUMENTS : 1. (struct pkt_RT_UPDATE *) - An empty pkt_RT_UPDATE structure
+ *                   2. int - My router's id received from command line argument.
+ *                   3. unsigned int - Only routes changed after this table version are copied, 0 copies all.
+ *                   4. (int *) - Position in the list of changed routes. Set it to -1 before the first
+ *                      fragment of an update, it is advanced past the routes copied.
+ * RETURN VALUE    : int - The number of routes copied, at most ROUTES_PER_PKT, fewer in PATHVECTOR
+ *                   mode when their paths fill the fragment.
+ * USAGE           : This routine fills the next fragment of a delta update, oldest change first.
+ *                   Only sender_id and no_routes are filled, the caller fills the remaining header fields.
+ */
+int ConvertChangestoFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID, unsigned int sinceVersion, int *cursor);
+
+
+
+/* Struct that holds an immutable copy of the routing table, see SnapshotRoutingTbl */
+struct route_snapshot {
+  unsigned int table_version; /* table version the copy was taken at */
+  int num_routes; /* routes in the copy */
+  struct route_entry *routes; /* every route, oldest change first */
+  unsigned int *versions; /* versions[i] is the table version routes[i] last changed at, increasing */
+};
+
+
+
+/* Routine Name    : SnapshotRoutingTbl
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : struct route_snapshot * - A copy of the selected routing table
+ * USAGE           : The copy never changes, so other threads may read it while the table is updated.
+ *                   It costs one pass over the table. Free it with FreeRouteSnapshot.
+ */
+struct route_snapshot *SnapshotRoutingTbl(void);
+
+
+
+/* Routine Name    : FreeRouteSnapshot
+ * INPUT ARGUMENTS : 1. (struct route_snapshot *) - A snapshot from SnapshotRoutingTbl
+ * RETURN VALUE    : void
+ * USAGE           : In PATHVECTOR mode the snapshot holds references to its paths, so it must be freed
+ *                   by the thread that updates the routing table.
+ */
+void FreeRouteSnapshot(struct route_snapshot *snapshot);
+
+
+
+/* Routine Name    : CountSnapshotChanges
+ * INPUT ARGUMENTS : 1. (const struct route_snapshot *) - The snapshot
+ *                   2. unsigned int - Only routes changed after this table version are counted, 0 counts all.
+ * RETURN VALUE    : int - The number of routes a delta update since that version carries
+ */
+int CountSnapshotChanges(const struct route_snapshot *snapshot, unsigned int sinceVersion);
+
+
+
+/* Routine Name    : SummarizeFragment
+ * INPUT ARGUMENTS : 1. (struct pkt_RT_UPDATE *) - A fragment in host byte order, poisoned for its neighbor
+ * RETURN VALUE    : int - The number of routes left in the fragment
+ * USAGE           : Merges each run of routes to consecutive destinations through the same next hop at
+ *                   the same cost into one summary route, see ROUTE_RANGE in ne.h. Fills no more routes
+ *                   in, so a fragment of ConvertChangestoFragment shrinks instead. Leaves PATHVECTOR
+ *                   fragments alone.
+ */
+int SummarizeFragment(struct pkt_RT_UPDATE *UpdatePacketToSend);
+
+
+
+/* Routine Name    : SetSummaryLimit
+ * INPUT ARGUMENTS : 1. int - Routes the table may hold before summaries stop adding destinations
+ * RETURN VALUE    : void
+ * USAGE           : Bounds what summaries received by UpdateRoutes add to the selected context, since a
+ *                   single packet of them covers millions of destinations. Defaults to MAX_TABLE_ROUTES.
+ */
+void SetSummaryLimit(int maxRoutes);
+
+
+
+/* Routine Name    : CountClampedSummaries
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : int - The number of summaries UpdateRoutes cut short at the summary limit
+ */
+int CountClampedSummaries(void);
+
+
+
+/* Routine Name    : EncodeSnapshotFragment
+ * INPUT ARGUMENTS : 1. (const struct route_snapshot *) - The snapshot
+ *                   2. (struct pkt_RT_UPDATE *) - The packet whose route array is filled
+ *                   3. unsigned int - Only routes changed after this table version are copied, 0 copies all.
+ *                   4. (int *) - Position in the snapshot. Set it to -1 before the first fragment of
+ *                      an update, it is advanced past the routes copied.
+ *                   5. int - Id of the neighbor the packet is meant for.
+ *                   6. int - 1 to merge runs of routes into summaries as SummarizeFragment does, which
+ *                      lets the fragment take more of the snapshot. Ignored in PATHVECTOR mode.
+ *                   7. (size_t *) - Set to the bytes of the fragment, paths included.
+ * RETURN VALUE    : int - The number of routes written, a summary counting as one. The cursor tells
+ *                         how far the snapshot was read.
+ * USAGE           : Like ConvertChangestoFragment, but reads the snapshot, and the routes are written
+ *                   directly in network byte order and as that neighbor should see them: routes whose
+ *                   next hop is the neighbor are poisoned to INFINITY. No header field is touched,
+ *                   the caller encodes the header itself.
+ */
+int EncodeSnapshotFragment(const struct route_snapshot *snapshot, struct pkt_RT_UPDATE *UpdatePacketToSend,
+                           unsigned int sinceVersion, int *cursor, int nbrID, int summarize, size_t *pktSize);
+
+
+
 /* Routine Name    : PrintRoutes
  * INPUT ARGUMENTS : 1. (FILE *) - Pointer to the log file created in router.c, with a filename that uses MyRouter's id.
  *                   2. int - My router's id received from command line argument.
  * RETURN VALUE    : void
  * USAGE           : This routine prints the routing table to the log file 
  *                   according to the format and rules specified in the Handout.
+ *                   Routes are printed in increasing order of dest_id. A route with equal cost
+ *                   next hops lists them after its next hop, as in "R0 -> R5: R1|R2, 7".
  */
 void PrintRoutes (FILE* Logfile, int myID);
 
@@ -68,20 +290,75 @@ void PrintRoutes (FILE* Logfile, int myID);
 
 /* Routine Name    : UninstallRoutesOnNbrDeath
  * INPUT ARGUMENTS : 1. int - The id of the inactive neighbor 
- *                   (one who didn't send Route Update for FAILURE_DETECTION seconds).
+ *                   (one who sent no Route Update for the hold time it advertised).
  *                   
  * RETURN VALUE    : void
  * USAGE           : This function is invoked when a nbr is found to be dead. The function checks all routes that
- *                   use this nbr as next hop, and changes the cost to INFINITY.
+ *                   use this nbr as next hop, and changes the cost to INFINITY unless another neighbor's
+ *                   Adj-RIB-In holds a loop free route, which is then taken at once. The dead nbr's own
+ *                   Adj-RIB-In is emptied.
  */
 void UninstallRoutesOnNbrDeath(int DeadNbr);
 
 
-/* Variable      : struct route_entry routingTable[MAX_ROUTERS]
- * Variable Type : Array of type (struct route_entry)
+
+/* Routine Name    : RestoreRoute
+ * INPUT ARGUMENTS : 1. unsigned int - Destination router id
+ *                   2. unsigned int - Next hop to the destination, one of my neighbors
+ *                   3. unsigned int - Cost to the destination through that neighbor
+ * RETURN VALUE    : int - 1 if the route was restored, 0 if the table already holds a route as cheap
+ * USAGE           : Used on a warm start, after InitRoutingTbl, to bring back the routes of a checkpoint.
+ *                   A neighbor that was reached more cheaply through another neighbor is restored too.
+ *                   Restored routes forward and are advertised like any other but are marked stale until
+ *                   their next hop advertises them again, see RefreshStaleRoutes. In PATHVECTOR mode
+ *                   the route's path is taken to be the next hop followed by the destination.
+ */
+int RestoreRoute(unsigned int dest_id, unsigned int next_hop, unsigned int cost);
+
+
+
+/* Routine Name    : RefreshStaleRoutes
+ * INPUT ARGUMENTS : 1. int - The id of a neighbor whose update was just applied in full
+ *                   2. int - 1 if that update held the neighbor's whole table, 0 if it was a delta
+ * RETURN VALUE    : int - The number of stale routes whose cost was set to INFINITY
+ * USAGE           : Settles the stale routes through the neighbor. A whole table that left a route out
+ *                   means the neighbor lost it, the route is set to INFINITY. A delta only holds what
+ *                   changed since a version the neighbor knows was applied here, so the routes it left
+ *                   out still stand. Costs nothing once no route is stale.
+ */
+int RefreshStaleRoutes(int nbrID, int wholeTable);
+
+
+
+/* Routine Name    : CountStaleRoutes
+ * INPUT ARGUMENTS : void
+ * RETURN VALUE    : int - The number of restored routes not yet heard again from their next hop
+ */
+int CountStaleRoutes(void);
+
+
+
+/* Routine Name    : GetNextHops
+ * INPUT ARGUMENTS : 1. unsigned int - Destination router id
+ *                   2. (unsigned int *) - Receives up to MAX_NEXT_HOPS next hops
+ * RETURN VALUE    : int - The number of next hops, 0 if the destination is unknown
+ * USAGE           : The route's next_hop comes first, then the other neighbors whose loop free route
+ *                   is as cheap, in increasing id order. Traffic to the destination may be spread
+ *                   over all of them. An unreachable route only has its next_hop.
+ */
+int GetNextHops(unsigned int dest_id, unsigned int *nextHops);
+
+
+/* Variable      : struct route_entry *routingTable
+ * Variable Type : Heap allocated array of type (struct route_entry)
  * USAGE         : Define as a Global Variable in routingtable.c.
  *                 The routingTable will be used by all the functions in routingtable.c.
- *                 #include ne.h in routingtable.c for definitions of struct route_entry and MAX_ROUTERS.
+ *                 It is sized at runtime and doubles whenever a new destination does not fit,
+ *                 so the number of routes is not bounded by MAX_ROUTERS. Routes are looked up
+ *                 by dest_id through a hash index kept alongside the table.
+ *                 It always holds the routes of the context chosen with SelectRoutingCtx.
+ *                 In PATHVECTOR mode each route holds a reference to its path in pathtable.h.
+ *                 #include ne.h in routingtable.c for definitions of struct route_entry.
  */
 
 
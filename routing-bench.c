@@ -0,0 +1,363 @@
+  /*
+   *  File Name: routing-bench.c
+   *
+   *  Purpose: Microbenchmarks of the routing table and byte order primitives.
+   *  UpdateRoutes runs over tables of growing size with three update patterns:
+   *  new-routes fills an empty table, forced-update has the next hop change the
+   *  cost of every route and no-change floods the table with what it already
+   *  holds. ConvertTabletoPkt, ConvertTabletoFragment and PrintRoutes run over the
+   *  same tables, hton_pkt_RT_UPDATE and ntoh_pkt_RT_UPDATE over full fragments.
+   *
+   *  Every row of the CSV gives the ns per call and per route along with the heap
+   *  allocations per call, counted by linking with malloc, calloc and realloc
+   *  wrapped (see the Makefile). Rows come out in a fixed order so the output of
+   *  two commits can be diffed.
+   *
+   *  Usage: routing-bench [-m max routes] [-t ms]
+   */
+
+
+#include <time.h>
+#include <stdbool.h>
+#include "ne.h"
+#include "router.h"
+
+#define DEFAULT_MAX_ROUTES 100000
+#define DEFAULT_RUN_MS 200   /* each measurement runs for at least this long */
+#define SMALLEST_TABLE 100   /* tables grow tenfold from here up to the max routes */
+#define PACKET_BATCH 64      /* packets converted per timed pass of the byte order benchmarks */
+#define RECEIVER_ID 0        /* router whose table is measured */
+#define SENDER_ID 1          /* its only neighbor, which advertises every route */
+#define UPSTREAM_ID 2        /* the sender's neighbor, next hop of the sender's routes */
+
+// Struct that describes one benchmark, prepare runs untimed before every timed pass
+typedef struct
+{
+    const char *primitive;
+    const char *pattern;
+    void (*setup)(void);        // once before the first pass, may be NULL
+    void (*prepare)(void);      // before every pass, may be NULL
+    int (*pass)(void);          // the measured work, returns the calls it made
+} benchmark;
+
+static long long AllocCount;
+static long long AllocBytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    AllocCount += 1;
+    AllocBytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    AllocCount += 1;
+    AllocBytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    AllocCount += 1;
+    AllocBytes += size;
+    return __real_realloc(ptr, size);
+}
+
+extern int NumRoutes;
+
+static struct routing_ctx *Receiver;
+static struct pkt_INIT_RESPONSE ReceiverInit;
+// The sender's table as fragments, with every cost one higher in Costlier
+static struct pkt_RT_UPDATE *Fragments;
+static struct pkt_RT_UPDATE *Costlier;
+static int FragmentCount;
+// Routes handled by the last pass, ns_per_route divides by their sum
+static long long PassRoutes;
+static bool UseCostlier;
+static FILE *DevNull;
+static struct pkt_RT_UPDATE Batch[PACKET_BATCH];
+static struct pkt_RT_UPDATE Scratch;
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Applies every fragment of the sender's table to the receiver
+static int applyFragments(struct pkt_RT_UPDATE *fragments)
+{
+    int i;
+    for (i = 0; i < FragmentCount; i++)
+    {
+        UpdateRoutes(&fragments[i], ReceiverInit.nbrcost[0].cost, RECEIVER_ID);
+        PassRoutes += fragments[i].no_routes;
+    }
+    return FragmentCount;
+}
+
+static void emptyTable(void)
+{
+    SelectRoutingCtx(Receiver);
+    InitRoutingTbl(&ReceiverInit, RECEIVER_ID);
+}
+
+static void fillTable(void)
+{
+    emptyTable();
+    applyFragments(Fragments);
+    UseCostlier = true;
+}
+
+static int applyNext(void)
+{
+    // Alternating between the two cost sets changes every route through the sender
+    int calls = applyFragments(UseCostlier ? Costlier : Fragments);
+    UseCostlier = !UseCostlier;
+    return calls;
+}
+
+static int applySame(void)
+{
+    return applyFragments(Fragments);
+}
+
+static int tableToPkt(void)
+{
+    ConvertTabletoPkt(&Scratch, RECEIVER_ID);
+    PassRoutes += Scratch.no_routes;
+    return 1;
+}
+
+static int tableToFragments(void)
+{
+    int fragNo = 0;
+    int fragCount;
+    do
+    {
+        fragCount = ConvertTabletoFragment(&Scratch, RECEIVER_ID, fragNo++);
+        PassRoutes += Scratch.no_routes;
+    } while (fragNo < fragCount);
+    return fragCount;
+}
+
+static int printTable(void)
+{
+    PrintRoutes(DevNull, RECEIVER_ID);
+    PassRoutes += NumRoutes;
+    return 1;
+}
+
+static void copyHostBatch(void)
+{
+    int i;
+    for (i = 0; i < PACKET_BATCH; i++)
+    {
+        memcpy(&Batch[i], &Fragments[0], sizeof(struct pkt_RT_UPDATE));
+    }
+}
+
+static void copyNetworkBatch(void)
+{
+    copyHostBatch();
+    int i;
+    for (i = 0; i < PACKET_BATCH; i++)
+    {
+        hton_pkt_RT_UPDATE(&Batch[i]);
+    }
+}
+
+static int htonBatch(void)
+{
+    int i;
+    for (i = 0; i < PACKET_BATCH; i++)
+    {
+        PassRoutes += Batch[i].no_routes;
+        hton_pkt_RT_UPDATE(&Batch[i]);
+    }
+    return PACKET_BATCH;
+}
+
+static int ntohBatch(void)
+{
+    int i;
+    for (i = 0; i < PACKET_BATCH; i++)
+    {
+        ntoh_pkt_RT_UPDATE(&Batch[i]);
+        PassRoutes += Batch[i].no_routes;
+    }
+    return PACKET_BATCH;
+}
+
+// Builds the sender's table of tableRoutes routes and cuts it into the fragments it advertises
+static void buildFragments(int tableRoutes)
+{
+    struct pkt_INIT_RESPONSE senderInit;
+    bzero((char *)&senderInit, sizeof(senderInit));
+    senderInit.no_nbr = 1;
+    senderInit.nbrcost[0].nbr = UPSTREAM_ID;
+    senderInit.nbrcost[0].cost = 1;
+    struct routing_ctx *sender = CreateRoutingCtx();
+    SelectRoutingCtx(sender);
+    InitRoutingTbl(&senderInit, SENDER_ID);
+
+    // The upstream router advertises the rest of the destinations with varied costs
+    unsigned int dest = UPSTREAM_ID + 1;
+    while (dest < (unsigned int)tableRoutes)
+    {
+        bzero((char *)&Scratch, RT_UPDATE_HDRSIZE);
+        Scratch.sender_id = UPSTREAM_ID;
+        while (Scratch.no_routes < ROUTES_PER_PKT && dest < (unsigned int)tableRoutes)
+        {
+            struct route_entry *route = &Scratch.route[Scratch.no_routes++];
+            bzero((char *)route, sizeof(struct route_entry));
+            route->dest_id = dest;
+            route->next_hop = dest;
+            route->cost = 1 + (dest * 7) % 50;
+            dest++;
+        }
+        UpdateRoutes(&Scratch, senderInit.nbrcost[0].cost, SENDER_ID);
+    }
+
+    FragmentCount = ConvertTabletoFragment(&Scratch, SENDER_ID, 0);
+    Fragments = malloc(2 * FragmentCount * sizeof(struct pkt_RT_UPDATE));
+    if (Fragments == NULL)
+    {
+        printf("Failed to allocate %d fragments\n", FragmentCount);
+        exit(EXIT_FAILURE);
+    }
+    Costlier = Fragments + FragmentCount;
+    int f;
+    for (f = 0; f < FragmentCount; f++)
+    {
+        ConvertTabletoFragment(&Fragments[f], SENDER_ID, f);
+        memcpy(&Costlier[f], &Fragments[f], sizeof(struct pkt_RT_UPDATE));
+        unsigned int i;
+        for (i = 0; i < Costlier[f].no_routes; i++)
+        {
+            if (Costlier[f].route[i].dest_id != SENDER_ID)
+                Costlier[f].route[i].cost += 1;
+        }
+    }
+    DestroyRoutingCtx(sender);
+}
+
+static void freeFragments(void)
+{
+    free(Fragments);
+    Fragments = NULL;
+    Costlier = NULL;
+}
+
+// Runs passes of one benchmark for at least runNs and prints its row
+static void measure(const benchmark *bench, int routes, long long runNs)
+{
+    if (bench->setup != NULL)
+        bench->setup();
+    long long calls = 0, routesDone = 0, allocs = 0, bytes = 0, elapsed = 0;
+    while (elapsed < runNs)
+    {
+        if (bench->prepare != NULL)
+            bench->prepare();
+        PassRoutes = 0;
+        long long allocsBefore = AllocCount, bytesBefore = AllocBytes;
+        long long start = nowNs();
+        calls += bench->pass();
+        elapsed += nowNs() - start;
+        allocs += AllocCount - allocsBefore;
+        bytes += AllocBytes - bytesBefore;
+        routesDone += PassRoutes;
+    }
+#ifdef PATHVECTOR
+    const char *mode = "PATHVECTOR";
+#else
+    const char *mode = "DISTVECTOR";
+#endif
+    printf("%s,%s,%s,%d,%lld,%.1f,%.2f,%.3f,%.1f\n", mode, bench->primitive, bench->pattern, routes, calls,
+           (double)elapsed / calls, routesDone ? (double)elapsed / routesDone : 0.0, (double)allocs / calls,
+           (double)bytes / calls);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    int option;
+    int maxRoutes = DEFAULT_MAX_ROUTES;
+    long long runNs = DEFAULT_RUN_MS * 1000000LL;
+    while ((option = getopt(argc, argv, "m:t:")) != -1)
+    {
+        switch (option)
+        {
+        case 'm':
+            maxRoutes = atoi(optarg);
+            break;
+        case 't':
+            runNs = atoll(optarg) * 1000000LL;
+            break;
+        default:
+            maxRoutes = 0;
+        }
+    }
+    if (maxRoutes < SMALLEST_TABLE || runNs <= 0 || optind != argc)
+    {
+        printf("Usage: routing-bench [-m max routes] [-t ms]\n");
+        printf("       -m max routes  largest table, tables grow tenfold from %d (default %d)\n", SMALLEST_TABLE,
+               DEFAULT_MAX_ROUTES);
+        printf("       -t ms          minimum time of each measurement (default %d)\n", DEFAULT_RUN_MS);
+        return EXIT_FAILURE;
+    }
+    DevNull = fopen("/dev/null", "w");
+    if (DevNull == NULL)
+    {
+        printf("Failed to open /dev/null with errno: %d\n", errno);
+        return EXIT_FAILURE;
+    }
+    ReceiverInit.no_nbr = 1;
+    ReceiverInit.nbrcost[0].nbr = SENDER_ID;
+    ReceiverInit.nbrcost[0].cost = 1;
+
+    const benchmark tableBenchmarks[] = {
+        {"UpdateRoutes", "new-routes", NULL, emptyTable, applySame},
+        {"UpdateRoutes", "forced-update", fillTable, NULL, applyNext},
+        {"UpdateRoutes", "no-change", fillTable, NULL, applySame},
+        {"ConvertTabletoPkt", "first-fragment", fillTable, NULL, tableToPkt},
+        {"ConvertTabletoFragment", "all-fragments", fillTable, NULL, tableToFragments},
+        {"PrintRoutes", "whole-table", fillTable, NULL, printTable},
+    };
+    const benchmark packetBenchmarks[] = {
+        {"hton_pkt_RT_UPDATE", "full-fragment", NULL, copyHostBatch, htonBatch},
+        {"ntoh_pkt_RT_UPDATE", "full-fragment", NULL, copyNetworkBatch, ntohBatch},
+    };
+
+    printf("mode,primitive,pattern,routes,calls,ns_per_call,ns_per_route,allocs_per_call,bytes_per_call\n");
+    int routes;
+    for (routes = SMALLEST_TABLE; routes <= maxRoutes; routes *= 10)
+    {
+        buildFragments(routes);
+        Receiver = CreateRoutingCtx();
+        int b;
+        for (b = 0; b < (int)(sizeof(tableBenchmarks) / sizeof(tableBenchmarks[0])); b++)
+        {
+            measure(&tableBenchmarks[b], routes, runNs);
+        }
+        DestroyRoutingCtx(Receiver);
+        if (routes * 10 <= maxRoutes)
+            freeFragments();
+    }
+
+    // The packets are the first fragment of the largest table, as full as a fragment gets
+    int b;
+    for (b = 0; b < (int)(sizeof(packetBenchmarks) / sizeof(packetBenchmarks[0])); b++)
+    {
+        measure(&packetBenchmarks[b], Fragments[0].no_routes, runNs);
+    }
+    freeFragments();
+    fclose(DevNull);
+    return EXIT_SUCCESS;
+}
@@ -1,130 +1,1276 @@
 #include "ne.h"
 #include "router.h"
+#include "pathtable.h"
 #include <stdbool.h>
 
+#define INITIAL_TABLE_SIZE 16 /* starting capacity of the routing table, grows by doubling */
+#define EMPTY_SLOT -1         /* marks an unused bucket in the dest_id index */
+#define PATH_REUSE_SLOTS 1024 /* buckets of a fragment's path offsets, over twice the hops a fragment holds */
+
 // Global Variables as required by "router.h"
-struct route_entry routingTable[MAX_ROUTERS];
+struct route_entry *routingTable;
 int NumRoutes;
 
+// Per route bookkeeping that never goes on the wire
+struct route_meta
+{
+    unsigned int version; // tableVersion at which the route last changed
+    unsigned int feasibleCost; // lowest cost of the route since it was last unreachable
+    int older;            // slot of the route changed just before this one, EMPTY_SLOT if none
+    int newer;            // slot of the route changed just after this one, EMPTY_SLOT if none
+    bool stale;           // restored from a checkpoint and not yet heard again from its next hop
+    int noEqualHops;      // entries of equalHops in use
+    unsigned int equalHops[MAX_NEXT_HOPS - 1]; // other neighbors with a loop free route as cheap, by id
+};
+
+// Last route to every destination one neighbor advertised, kept by routingTable slot so a route
+// that loses its next hop can move to another neighbor without waiting for it to advertise again
+struct adj_rib_in
+{
+    int nbr;            // neighbor id
+    int costToNbr;      // cost of the link the routes were heard over
+    unsigned int *cost; // advertised cost of every slot, INFINITY if none or if it loops back here
+#ifdef PATHVECTOR
+    unsigned int *path; // path through the neighbor of every slot, holding a reference, PATH_EMPTY if none
+#endif
+};
+
+// Everything one router instance keeps about its routes. The selected context
+// lives in the routingTable and NumRoutes globals while it is selected.
+struct routing_ctx
+{
+    struct route_entry *table; // routingTable while the context is not selected
+    int numRoutes;             // NumRoutes while the context is not selected
+    int tableCapacity;         // allocated size of the table
+    struct route_meta *routeMeta;
+
+    // Every route change bumps tableVersion. Routes are kept on a list ordered by
+    // version so the changes since any version can be found without a table scan.
+    unsigned int tableVersion;
+    int oldestChange;
+    int newestChange;
+    unsigned int worsenedVersion; // tableVersion of the last change that made a route more expensive
+    int staleRoutes;              // routes with stale set
+    int summaryLimit;             // routes past which summaries add no destinations
+    int clampedSummaries;         // summaries cut short at summaryLimit
+
+    // Adj-RIB-In of every neighbor heard from, sized like the table
+    struct adj_rib_in *ribs;
+    int numRibs;
+    int ribCapacity;
+
+    // Open addressed dest_id -> routingTable slot index, kept at most half full
+    int *routeIndex;
+    unsigned int indexMask;
+};
+
+// Context of processes that run a single router and never create one
+static struct routing_ctx DefaultCtx = {NULL, 0, 0, NULL, 0, EMPTY_SLOT, EMPTY_SLOT, 0, 0, MAX_TABLE_ROUTES, 0, NULL, 0, 0, NULL, 0};
+static struct routing_ctx *Ctx = &DefaultCtx;
+
+// Scratch array used by PrintRoutes to walk the table in dest_id order
+static int *PrintOrder;
+static int PrintOrderCapacity;
+
+// Fibonacci hash of a router id into the index
+static unsigned int HashRouterID(unsigned int dest_id)
+{
+    return (dest_id * 2654435761u) & Ctx->indexMask;
+}
+
+// Returns the routingTable slot holding dest_id, or EMPTY_SLOT if it is not known
+static int FindRoute(unsigned int dest_id)
+{
+    unsigned int bucket = HashRouterID(dest_id);
+    while (Ctx->routeIndex[bucket] != EMPTY_SLOT)
+    {
+        if (routingTable[Ctx->routeIndex[bucket]].dest_id == dest_id)
+        {
+            return Ctx->routeIndex[bucket];
+        }
+        bucket = (bucket + 1) & Ctx->indexMask;
+    }
+    return EMPTY_SLOT;
+}
+
+// Places slot into the first free bucket for its dest_id
+static void IndexRoute(int slot)
+{
+    unsigned int bucket = HashRouterID(routingTable[slot].dest_id);
+    while (Ctx->routeIndex[bucket] != EMPTY_SLOT)
+    {
+        bucket = (bucket + 1) & Ctx->indexMask;
+    }
+    Ctx->routeIndex[bucket] = slot;
+}
+
+// Sizes the arrays of an Adj-RIB-In to capacity slots, those from firstEmpty on hold no route
+static void SizeAdjRibIn(struct adj_rib_in *rib, int capacity, int firstEmpty)
+{
+    unsigned int *grownCost = realloc(rib->cost, capacity * sizeof(unsigned int));
+#ifdef PATHVECTOR
+    unsigned int *grownPath = realloc(rib->path, capacity * sizeof(unsigned int));
+    if (grownPath == NULL)
+        grownCost = NULL;
+#endif
+    if (grownCost == NULL)
+    {
+        printf("Failed to grow the routes of neighbor %d to %d\n", rib->nbr, capacity);
+        exit(EXIT_FAILURE);
+    }
+    rib->cost = grownCost;
+#ifdef PATHVECTOR
+    rib->path = grownPath;
+#endif
+    int slot;
+    for (slot = firstEmpty; slot < capacity; slot++)
+    {
+        rib->cost[slot] = INFINITY;
+#ifdef PATHVECTOR
+        rib->path[slot] = PATH_EMPTY;
+#endif
+    }
+}
+
+static void GrowAdjRibsIn(int capacity)
+{
+    int i;
+    for (i = 0; i < Ctx->numRibs; i++)
+    {
+        SizeAdjRibIn(&Ctx->ribs[i], capacity, NumRoutes);
+    }
+}
+
+// Forgets every route a neighbor advertised
+static void ClearAdjRibIn(struct adj_rib_in *rib)
+{
+    int slot;
+    for (slot = 0; slot < NumRoutes; slot++)
+    {
+        rib->cost[slot] = INFINITY;
+#ifdef PATHVECTOR
+        PathRelease(rib->path[slot]);
+        rib->path[slot] = PATH_EMPTY;
+#endif
+    }
+}
+
+// Drops the Adj-RIB-In of every neighbor of a context whose table holds numRoutes routes
+static void FreeAdjRibsIn(struct routing_ctx *ctx, int numRoutes)
+{
+    int i;
+    for (i = 0; i < ctx->numRibs; i++)
+    {
+#ifdef PATHVECTOR
+        int slot;
+        for (slot = 0; slot < numRoutes; slot++)
+        {
+            PathRelease(ctx->ribs[i].path[slot]);
+        }
+        free(ctx->ribs[i].path);
+#endif
+        free(ctx->ribs[i].cost);
+    }
+    ctx->numRibs = 0;
+}
+
+// Returns the Adj-RIB-In of a neighbor, NULL if it never advertised anything
+static struct adj_rib_in *FindAdjRibIn(int nbr)
+{
+    int i;
+    for (i = 0; i < Ctx->numRibs; i++)
+    {
+        if (Ctx->ribs[i].nbr == nbr)
+            return &Ctx->ribs[i];
+    }
+    return NULL;
+}
+
+// Returns the Adj-RIB-In of a neighbor, starting an empty one the first time it is heard from
+static struct adj_rib_in *GetAdjRibIn(int nbr, int costToNbr)
+{
+    struct adj_rib_in *rib = FindAdjRibIn(nbr);
+    if (rib == NULL)
+    {
+        if (Ctx->numRibs == Ctx->ribCapacity)
+        {
+            int capacity = (Ctx->ribCapacity == 0) ? 8 : 2 * Ctx->ribCapacity;
+            struct adj_rib_in *grown = realloc(Ctx->ribs, capacity * sizeof(struct adj_rib_in));
+            if (grown == NULL)
+            {
+                printf("Failed to grow the neighbor routes to %d neighbors\n", capacity);
+                exit(EXIT_FAILURE);
+            }
+            Ctx->ribs = grown;
+            Ctx->ribCapacity = capacity;
+        }
+        rib = &Ctx->ribs[Ctx->numRibs++];
+        memset(rib, 0, sizeof(struct adj_rib_in));
+        rib->nbr = nbr;
+        SizeAdjRibIn(rib, Ctx->tableCapacity, 0);
+    }
+    rib->costToNbr = costToNbr;
+    return rib;
+}
+
+// Cost of the route to the destination of slot through the neighbor of rib
+static unsigned int RibDistance(const struct adj_rib_in *rib, int slot)
+{
+    unsigned int distance = rib->cost[slot] + rib->costToNbr;
+    return (distance > INFINITY) ? INFINITY : distance;
+}
+
+// Resizes the table and rebuilds the index so that capacity routes fit
+static void GrowRoutingTbl(int capacity)
+{
+    struct route_entry *grownTable = realloc(routingTable, capacity * sizeof(struct route_entry));
+    struct route_meta *grownMeta = realloc(Ctx->routeMeta, capacity * sizeof(struct route_meta));
+    int *grownIndex = malloc(2 * capacity * sizeof(int));
+    if (grownTable == NULL || grownMeta == NULL || grownIndex == NULL)
+    {
+        printf("Failed to grow the routing table to %d routes\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+    routingTable = grownTable;
+    Ctx->routeMeta = grownMeta;
+    Ctx->tableCapacity = capacity;
+
+    GrowAdjRibsIn(capacity);
+
+    free(Ctx->routeIndex);
+    Ctx->routeIndex = grownIndex;
+    Ctx->indexMask = 2 * capacity - 1;
+    memset(Ctx->routeIndex, 0xff, 2 * capacity * sizeof(int));
+    int slot;
+    for (slot = 0; slot < NumRoutes; slot++)
+    {
+        IndexRoute(slot);
+    }
+}
+
+// Stamps slot with a new table version and moves it to the newest end of the change list
+static void TouchRoute(int slot, bool isNew)
+{
+    struct route_meta *meta = &Ctx->routeMeta[slot];
+    if (!isNew)
+    {
+        if (slot == Ctx->newestChange)
+        {
+            meta->version = ++Ctx->tableVersion;
+            return;
+        }
+        // Unlink from the current position
+        if (meta->older == EMPTY_SLOT)
+            Ctx->oldestChange = meta->newer;
+        else
+            Ctx->routeMeta[meta->older].newer = meta->newer;
+        Ctx->routeMeta[meta->newer].older = meta->older;
+    }
+    meta->version = ++Ctx->tableVersion;
+    meta->older = Ctx->newestChange;
+    meta->newer = EMPTY_SLOT;
+    if (Ctx->newestChange == EMPTY_SLOT)
+        Ctx->oldestChange = slot;
+    else
+        Ctx->routeMeta[Ctx->newestChange].newer = slot;
+    Ctx->newestChange = slot;
+}
+
+// Appends a new route to the table and returns its slot
+static int AddRoute(unsigned int dest_id, unsigned int next_hop, unsigned int cost)
+{
+    if (NumRoutes == Ctx->tableCapacity)
+    {
+        GrowRoutingTbl(2 * Ctx->tableCapacity);
+    }
+    routingTable[NumRoutes].dest_id = dest_id;
+    routingTable[NumRoutes].next_hop = next_hop;
+    routingTable[NumRoutes].cost = cost;
+#ifdef PATHVECTOR
+    routingTable[NumRoutes].path_len = 0;
+    routingTable[NumRoutes].path = PATH_EMPTY;
+#endif
+    Ctx->routeMeta[NumRoutes].feasibleCost = cost;
+    Ctx->routeMeta[NumRoutes].stale = false;
+    Ctx->routeMeta[NumRoutes].noEqualHops = 0;
+    IndexRoute(NumRoutes);
+    TouchRoute(NumRoutes, true);
+    return NumRoutes++;
+}
+
+// A route heard again from its next hop, or replaced, no longer relies on the checkpoint
+static void FreshenRoute(int slot)
+{
+    if (Ctx->routeMeta[slot].stale)
+    {
+        Ctx->routeMeta[slot].stale = false;
+        Ctx->staleRoutes -= 1;
+    }
+}
+
+#ifdef PATHVECTOR
+// Hands the reference to path over to a route, dropping the one to its old path
+static void SetRoutePath(struct route_entry *route, unsigned int path)
+{
+    PathRelease(route->path);
+    route->path = path;
+    route->path_len = PathNode(path)->length;
+}
+
+// Tells whether path is first followed by the count routers in hops, without interning them
+static bool IsPath(unsigned int path, unsigned int first, const unsigned int *hops, int count)
+{
+    const struct path_node *node = PathNode(path);
+    if (node->length != (unsigned int)count + 1)
+    {
+        return false;
+    }
+    while (count > 0)
+    {
+        if (node->hop != hops[--count])
+            return false;
+        node = PathNode(node->parent);
+    }
+    return node->hop == first;
+}
+
+// Hops of a fragment being filled, moved behind its routes once it is full
+struct fragment_paths
+{
+    int words;                                   // hops placed so far
+    unsigned int hops[RT_UPDATE_WORDS];
+    unsigned int reuse_path[PATH_REUSE_SLOTS];   // paths placed and every path they start with, PATH_EMPTY if unused
+    unsigned int reuse_offset[PATH_REUSE_SLOTS]; // offset of their first hop
+};
+
+static void StartFragmentPaths(struct fragment_paths *paths)
+{
+    paths->words = 0;
+    memset(paths->reuse_path, 0, sizeof(paths->reuse_path));
+}
+
+// Returns the offset of the hops of a path placed in the fragment, or -1 if it was not
+static int FindFragmentPath(const struct fragment_paths *paths, unsigned int path)
+{
+    unsigned int bucket = (path * 2654435761u) & (PATH_REUSE_SLOTS - 1);
+    while (paths->reuse_path[bucket] != PATH_EMPTY)
+    {
+        if (paths->reuse_path[bucket] == path)
+            return paths->reuse_offset[bucket];
+        bucket = (bucket + 1) & (PATH_REUSE_SLOTS - 1);
+    }
+    return -1;
+}
+
+static void RememberFragmentPath(struct fragment_paths *paths, unsigned int path, int offset)
+{
+    unsigned int bucket = (path * 2654435761u) & (PATH_REUSE_SLOTS - 1);
+    while (paths->reuse_path[bucket] != PATH_EMPTY)
+    {
+        if (paths->reuse_path[bucket] == path)
+            return;
+        bucket = (bucket + 1) & (PATH_REUSE_SLOTS - 1);
+    }
+    paths->reuse_path[bucket] = path;
+    paths->reuse_offset[bucket] = offset;
+}
+
+// Returns the offset of the hops of path in a fragment that holds routeCount routes, or -1 if
+// the route and its hops do not fit. A path that starts with one placed before shares its words,
+// and a path placed last is extended in place by the paths that start with it.
+static int PlaceFragmentPath(struct fragment_paths *paths, unsigned int path, int routeCount)
+{
+    int freeWords = RT_UPDATE_WORDS - (routeCount + 1) * (int)(sizeof(struct route_entry) / sizeof(unsigned int)) -
+                    paths->words;
+    const struct path_node *node = PathNode(path);
+    int offset = (node->length == 0) ? 0 : FindFragmentPath(paths, path);
+    if (offset >= 0)
+    {
+        return (freeWords >= 0) ? offset : -1;
+    }
+
+    // The longest placed prefix is only extended when nothing was placed after it
+    offset = paths->words;
+    unsigned int prefix = node->parent;
+    while (PathNode(prefix)->length > 0)
+    {
+        int prefixOffset = FindFragmentPath(paths, prefix);
+        if (prefixOffset >= 0)
+        {
+            if (prefixOffset + (int)PathNode(prefix)->length == paths->words)
+                offset = prefixOffset;
+            break;
+        }
+        prefix = PathNode(prefix)->parent;
+    }
+    if (offset + (int)node->length - paths->words > freeWords)
+    {
+        return -1;
+    }
+
+    // Written last hop first, each shorter path met on the way starts at the same offset
+    int end = offset + node->length;
+    prefix = path;
+    while (offset + (int)node->length > paths->words)
+    {
+        paths->hops[offset + node->length - 1] = node->hop;
+        RememberFragmentPath(paths, prefix, offset);
+        prefix = node->parent;
+        node = PathNode(prefix);
+    }
+    paths->words = end;
+    return offset;
+}
+
+// Copies the hops behind the routeCount routes of the fragment
+static void FinishFragmentPaths(const struct fragment_paths *paths, struct pkt_RT_UPDATE *fragment, int routeCount,
+                                bool networkOrder)
+{
+    unsigned int *hops = (unsigned int *)&fragment->route[routeCount];
+    int i;
+    for (i = 0; i < paths->words; i++)
+    {
+        hops[i] = networkOrder ? htonl(paths->hops[i]) : paths->hops[i];
+    }
+}
+
+// Drops the paths held by count routes
+static void ReleaseRoutePaths(struct route_entry *routes, int count)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        PathRelease(routes[i].path);
+    }
+}
+#endif
+
+struct routing_ctx *CreateRoutingCtx(void)
+{
+    struct routing_ctx *ctx = malloc(sizeof(struct routing_ctx));
+    if (ctx == NULL)
+    {
+        printf("Failed to allocate a routing context\n");
+        exit(EXIT_FAILURE);
+    }
+    ctx->table = NULL;
+    ctx->numRoutes = 0;
+    ctx->tableCapacity = 0;
+    ctx->routeMeta = NULL;
+    ctx->tableVersion = 0;
+    ctx->oldestChange = EMPTY_SLOT;
+    ctx->newestChange = EMPTY_SLOT;
+    ctx->worsenedVersion = 0;
+    ctx->staleRoutes = 0;
+    ctx->summaryLimit = MAX_TABLE_ROUTES;
+    ctx->clampedSummaries = 0;
+    ctx->ribs = NULL;
+    ctx->numRibs = 0;
+    ctx->ribCapacity = 0;
+    ctx->routeIndex = NULL;
+    ctx->indexMask = 0;
+    return ctx;
+}
+
+struct routing_ctx *SelectRoutingCtx(struct routing_ctx *ctx)
+{
+    struct routing_ctx *previous = Ctx;
+    if (ctx == Ctx)
+    {
+        return previous;
+    }
+    // Park the globals in the context being left and load the new one
+    Ctx->table = routingTable;
+    Ctx->numRoutes = NumRoutes;
+    Ctx = (ctx == NULL) ? &DefaultCtx : ctx;
+    routingTable = Ctx->table;
+    NumRoutes = Ctx->numRoutes;
+    return previous;
+}
+
+void DestroyRoutingCtx(struct routing_ctx *ctx)
+{
+    if (ctx == NULL || ctx == &DefaultCtx)
+    {
+        return;
+    }
+    if (ctx == Ctx)
+    {
+        SelectRoutingCtx(&DefaultCtx);
+    }
+#ifdef PATHVECTOR
+    ReleaseRoutePaths(ctx->table, ctx->numRoutes);
+#endif
+    FreeAdjRibsIn(ctx, ctx->numRoutes);
+    free(ctx->ribs);
+    free(ctx->table);
+    free(ctx->routeMeta);
+    free(ctx->routeIndex);
+    free(ctx);
+}
+
 // Takes the neighboring router values from the InitResponse and copies to the routing
-// table  global variable, struct route_entry routingTable[MAX_ROUTERS]
+// table global variable, struct route_entry *routingTable
 void InitRoutingTbl(struct pkt_INIT_RESPONSE *InitResponse, int myID)
 {
+    // Start from an empty table of the default size, no neighbor has advertised anything yet
+#ifdef PATHVECTOR
+    ReleaseRoutePaths(routingTable, NumRoutes);
+#endif
+    FreeAdjRibsIn(Ctx, NumRoutes);
+    NumRoutes = 0;
+    Ctx->tableVersion = 0;
+    Ctx->oldestChange = EMPTY_SLOT;
+    Ctx->newestChange = EMPTY_SLOT;
+    Ctx->worsenedVersion = 0;
+    Ctx->staleRoutes = 0;
+    GrowRoutingTbl(INITIAL_TABLE_SIZE);
+
     // Inserting the current router details
-    routingTable[0].dest_id = myID;
-    routingTable[0].next_hop = myID;
-    routingTable[0].cost = 0;
-    NumRoutes = 1;
+    AddRoute(myID, myID, 0);
 
     // Initializing the table with neighboring values
     int neighborIterator;
 
     for (neighborIterator = 0; neighborIterator < InitResponse->no_nbr; neighborIterator++)
     {
-        routingTable[neighborIterator + 1].dest_id = InitResponse->nbrcost[neighborIterator].nbr;
-        routingTable[neighborIterator + 1].next_hop = InitResponse->nbrcost[neighborIterator].nbr;
-        routingTable[neighborIterator + 1].cost = InitResponse->nbrcost[neighborIterator].cost;
-        NumRoutes += 1;
+        AddRoute(InitResponse->nbrcost[neighborIterator].nbr,
+                 InitResponse->nbrcost[neighborIterator].nbr,
+                 InitResponse->nbrcost[neighborIterator].cost);
+#ifdef PATHVECTOR
+        SetRoutePath(&routingTable[NumRoutes - 1], PathExtend(PATH_EMPTY, InitResponse->nbrcost[neighborIterator].nbr));
+#endif
     }
 }
 
+// Tells whether the neighbor of rib offers a loop free route as cheap as the route of slot without being its next hop
+static bool IsEqualCostHop(int slot, const struct adj_rib_in *rib)
+{
+    const struct route_entry *route = &routingTable[slot];
+    if (route->cost >= INFINITY || route->next_hop == (unsigned int)rib->nbr || RibDistance(rib, slot) != route->cost)
+    {
+        return false;
+    }
+#ifdef PATHVECTOR
+    return true;
+#else
+    // Like FindAlternate, only a neighbor that advertised less than the feasible cost cannot route through it
+    return rib->cost[slot] < Ctx->routeMeta[slot].feasibleCost;
+#endif
+}
+
+static bool HasEqualCostHop(int slot, unsigned int nbr)
+{
+    const struct route_meta *meta = &Ctx->routeMeta[slot];
+    int i;
+    for (i = 0; i < meta->noEqualHops; i++)
+    {
+        if (meta->equalHops[i] == nbr)
+            return true;
+    }
+    return false;
+}
+
+// Collects the equal cost next hops of the route of slot in increasing id order, the lowest
+// MAX_NEXT_HOPS - 1 of them if there are more. Returns true if they changed.
+static bool SetEqualCostHops(int slot)
+{
+    unsigned int hops[MAX_NEXT_HOPS - 1];
+    int count = 0;
+    int i;
+    for (i = 0; i < Ctx->numRibs; i++)
+    {
+        if (!IsEqualCostHop(slot, &Ctx->ribs[i]))
+            continue;
+        unsigned int nbr = Ctx->ribs[i].nbr;
+        int at = count;
+        while (at > 0 && hops[at - 1] > nbr)
+        {
+            if (at < MAX_NEXT_HOPS - 1)
+                hops[at] = hops[at - 1];
+            at -= 1;
+        }
+        if (at < MAX_NEXT_HOPS - 1)
+        {
+            hops[at] = nbr;
+            if (count < MAX_NEXT_HOPS - 1)
+                count += 1;
+        }
+    }
+    struct route_meta *meta = &Ctx->routeMeta[slot];
+    if (count == meta->noEqualHops && memcmp(hops, meta->equalHops, count * sizeof(unsigned int)) == 0)
+    {
+        return false;
+    }
+    meta->noEqualHops = count;
+    memcpy(meta->equalHops, hops, count * sizeof(unsigned int));
+    return true;
+}
+
+// Lowers the feasible cost of the route of slot to its cost, or resets it once the destination is unreachable
+static void SetFeasibleCost(int slot)
+{
+    struct route_meta *meta = &Ctx->routeMeta[slot];
+    unsigned int cost = routingTable[slot].cost;
+    if (cost >= INFINITY || cost < meta->feasibleCost)
+        meta->feasibleCost = cost;
+}
+
+// Stamps a route whose cost or next hop changed, along with the equal cost next hops that go with it
+static void ChangeRoute(int slot)
+{
+    SetFeasibleCost(slot);
+    SetEqualCostHops(slot);
+    TouchRoute(slot, false);
+}
+
+// Returns the Adj-RIB-In with the cheapest loop free route to the destination of slot, NULL if none has one.
+// Without paths a neighbor is only known not to reach the destination through this router when it
+// advertised less than feasibleCost, the lowest cost this router had since the destination was last
+// unreachable. Any route through this router costs at least that much.
+static struct adj_rib_in *FindAlternate(int slot, unsigned int feasibleCost, unsigned int *distance)
+{
+    struct adj_rib_in *best = NULL;
+    *distance = INFINITY;
+    int i;
+    for (i = 0; i < Ctx->numRibs; i++)
+    {
+        struct adj_rib_in *rib = &Ctx->ribs[i];
+#ifndef PATHVECTOR
+        if (rib->cost[slot] >= feasibleCost)
+            continue;
+#endif
+        unsigned int ribDistance = RibDistance(rib, slot);
+        if (ribDistance < *distance)
+        {
+            best = rib;
+            *distance = ribDistance;
+        }
+    }
+    return best;
+}
+
+// Points the route of slot at the route the neighbor of rib advertised
+static void TakeRibRoute(int slot, const struct adj_rib_in *rib, unsigned int distance)
+{
+    routingTable[slot].next_hop = rib->nbr;
+    routingTable[slot].cost = distance;
+#ifdef PATHVECTOR
+    if (routingTable[slot].path != rib->path[slot])
+    {
+        PathRetain(rib->path[slot]);
+        SetRoutePath(&routingTable[slot], rib->path[slot]);
+    }
+#endif
+}
+
+// Moves a route that got worse to the distance the neighbor of rib now offers, or with rib NULL to
+// INFINITY for a dead next hop, unless a loop free alternate is cheaper
+static void WorsenRoute(int slot, const struct adj_rib_in *rib, unsigned int distance)
+{
+    unsigned int oldCost = routingTable[slot].cost;
+    unsigned int altDistance;
+    struct adj_rib_in *alt = FindAlternate(slot, Ctx->routeMeta[slot].feasibleCost, &altDistance);
+    if (alt != NULL && altDistance < distance)
+        TakeRibRoute(slot, alt, altDistance);
+    else if (rib != NULL)
+        TakeRibRoute(slot, rib, distance);
+    else
+        routingTable[slot].cost = distance;
+    ChangeRoute(slot);
+    if (routingTable[slot].cost > oldCost)
+        Ctx->worsenedVersion = Ctx->tableVersion;
+}
+
+// Applies the forced update and split horizon rules to the route of slot for what the neighbor of rib
+// advertised, returns 1 if its cost or next hop changed
+static int ApplyRibRoute(int slot, const struct adj_rib_in *rib)
+{
+    struct route_entry *route = &routingTable[slot];
+    unsigned int distance = RibDistance(rib, slot);
+    bool routeChanged = route->cost != distance;
+#ifdef PATHVECTOR
+    routeChanged = routeChanged || route->path != rib->path[slot];
+#endif
+    // Forced Update
+    if (route->next_hop == (unsigned int)rib->nbr && routeChanged)
+    {
+        if (distance > route->cost)
+        {
+            WorsenRoute(slot, rib, distance);
+        }
+        else
+        {
+            TakeRibRoute(slot, rib, distance);
+            ChangeRoute(slot);
+        }
+        return 1;
+    }
+    // Split Horizon, a route the neighbor reaches through this router was recorded as INFINITY
+    if (distance < route->cost)
+    {
+        FreshenRoute(slot);
+        TakeRibRoute(slot, rib, distance);
+        ChangeRoute(slot);
+        return 1;
+    }
+    // The route stands, the neighbor may have joined or left its equal cost next hops. That is
+    // stamped for the FIB but changes nothing the neighbors are told.
+    if (IsEqualCostHop(slot, rib) != HasEqualCostHop(slot, rib->nbr) && SetEqualCostHops(slot))
+    {
+        TouchRoute(slot, false);
+    }
+    return 0;
+}
+
+// Applies what the sender of a packet advertised for dest, the destination of updateIterator or one
+// more of those it covers as a summary, returns 1 if the table changed
+static int ApplyAdvertisedRoute(struct pkt_RT_UPDATE *RecvdUpdatePacket, struct route_entry *updateIterator,
+                                unsigned int dest, struct adj_rib_in *rib, int myID)
+{
+    int slot = FindRoute(dest);
+    if (slot != EMPTY_SLOT && routingTable[slot].next_hop == RecvdUpdatePacket->sender_id)
+    {
+        FreshenRoute(slot);
+    }
+#ifdef PATHVECTOR
+    if (updateIterator->path_len >= MAX_PATH_LEN)
+    {
+        return 0;
+    }
+    unsigned int cost = updateIterator->cost;
+#else
+    unsigned int cost = ROUTE_COST(updateIterator);
+#endif
+    // If update dest_id is not in the table add it, the route is filled in from the Adj-RIB-In
+    bool isNew = slot == EMPTY_SLOT;
+    if (isNew)
+    {
+        slot = AddRoute(dest, RecvdUpdatePacket->sender_id, INFINITY);
+    }
+
+    // Record what the sender advertised. A route back through this router offers nothing.
+    unsigned int advertised = (cost > INFINITY) ? INFINITY : cost;
+    if (updateIterator->next_hop == (unsigned int)myID)
+    {
+        advertised = INFINITY;
+    }
+#ifdef PATHVECTOR
+    // The path through the sender is the sender followed by the path it advertised. It is interned
+    // when it differs from the one the sender advertised before, and a path that already holds my
+    // router's id loops.
+    const unsigned int *hops = RT_UPDATE_PATHS(RecvdUpdatePacket) + updateIterator->path;
+    if (rib->path[slot] == PATH_EMPTY ||
+        !IsPath(rib->path[slot], RecvdUpdatePacket->sender_id, hops, updateIterator->path_len))
+    {
+        PathRelease(rib->path[slot]);
+        rib->path[slot] = PathFromHops(RecvdUpdatePacket->sender_id, hops, updateIterator->path_len);
+    }
+    if (PathContains(rib->path[slot], myID))
+    {
+        advertised = INFINITY;
+    }
+#endif
+    rib->cost[slot] = advertised;
+
+    if (isNew)
+    {
+        TakeRibRoute(slot, rib, RibDistance(rib, slot));
+        SetFeasibleCost(slot);
+        return 1;
+    }
+    return ApplyRibRoute(slot, rib);
+}
+
 // Update the route information based on split horizon and forced updates
 int UpdateRoutes(struct pkt_RT_UPDATE *RecvdUpdatePacket, int costToNbr, int myID)
 {
-    int i, j, distance, updateOccured = 0;
-    bool notInTable = true;
+    int i, updateOccured = 0;
     struct route_entry *updateIterator;
-    struct route_entry *routingTableIterator;
+    struct adj_rib_in *rib = GetAdjRibIn(RecvdUpdatePacket->sender_id, costToNbr);
     // Iterate through all updates in the update packet
     for (i = 0; i < RecvdUpdatePacket->no_routes; i++)
     {
         updateIterator = &RecvdUpdatePacket->route[i];
-        distance = updateIterator->cost + costToNbr;
-        if (distance > INFINITY)
+        unsigned int dest = updateIterator->dest_id;
+#ifdef PATHVECTOR
+        unsigned int range = 0;
+#else
+        // A summary is expanded here, each destination it covers is applied as if sent on its own
+        unsigned int range = ROUTE_RANGE(updateIterator);
+        if (range > ~dest)
+            range = ~dest;
+#endif
+        updateOccured |= ApplyAdvertisedRoute(RecvdUpdatePacket, updateIterator, dest, rib, myID);
+        while (range-- > 0)
         {
-            distance = INFINITY;
-        }
-        notInTable = true;
-        // Make changed to the required routing table entires
-        for (j = 0; j < NumRoutes; j++)
-        {
-            routingTableIterator = &routingTable[j];
-            if (routingTableIterator->dest_id == updateIterator->dest_id)
+            // One entry can cover MAX_ROUTE_RANGE destinations, so past the limit a summary adds
+            // no more routes and the rest of its block is dropped
+            if (NumRoutes >= Ctx->summaryLimit && FindRoute(dest + 1) == EMPTY_SLOT)
             {
-                notInTable = false;
-                // Forced Update
-                if (routingTableIterator->next_hop == RecvdUpdatePacket->sender_id && routingTableIterator->cost != distance)
-                {
-                    routingTableIterator->cost = distance;
-                    updateOccured = 1;
-                }
-                // Split Horizon
-                else if (distance < routingTableIterator->cost && updateIterator->next_hop != myID)
-                {
-                    routingTableIterator->next_hop = RecvdUpdatePacket->sender_id;
-                    routingTableIterator->cost = distance;
-                    updateOccured = 1;
-                }
-                else
-                {
-                    break;
-                }
+                Ctx->clampedSummaries += 1;
+                break;
             }
-        }
-        // If update dest_id is not in the table add the data to the table
-        if (notInTable)
-        {
-            routingTable[NumRoutes].dest_id = updateIterator->dest_id;
-            routingTable[NumRoutes].next_hop = RecvdUpdatePacket->sender_id;
-            routingTable[NumRoutes].cost = distance;
-            NumRoutes += 1;
-            updateOccured = 1;
+            updateOccured |= ApplyAdvertisedRoute(RecvdUpdatePacket, updateIterator, ++dest, rib, myID);
         }
     }
     return updateOccured;
 }
 
+#ifndef PATHVECTOR
+// Widens summary over route when route continues its block of destinations through the same next
+// hop at the same cost, returns false if route needs an entry of its own
+static bool ExtendSummary(struct route_entry *summary, const struct route_entry *route)
+{
+    unsigned int range = ROUTE_RANGE(summary);
+    unsigned int added = ROUTE_RANGE(route) + 1;
+    if (route->dest_id <= summary->dest_id || route->dest_id - summary->dest_id != range + 1 ||
+        route->next_hop != summary->next_hop || ROUTE_COST(route) != ROUTE_COST(summary) ||
+        range + added > MAX_ROUTE_RANGE)
+    {
+        return false;
+    }
+    summary->cost += added << ROUTE_RANGE_SHIFT;
+    return true;
+}
+#endif
+
+int SummarizeFragment(struct pkt_RT_UPDATE *UpdatePacketToSend)
+{
+#ifndef PATHVECTOR
+    unsigned int i, kept = 0;
+    for (i = 0; i < UpdatePacketToSend->no_routes; i++)
+    {
+        if (kept > 0 && ExtendSummary(&UpdatePacketToSend->route[kept - 1], &UpdatePacketToSend->route[i]))
+            continue;
+        UpdatePacketToSend->route[kept++] = UpdatePacketToSend->route[i];
+    }
+    UpdatePacketToSend->no_routes = kept;
+#endif
+    return UpdatePacketToSend->no_routes;
+}
+
+void SetSummaryLimit(int maxRoutes)
+{
+    Ctx->summaryLimit = maxRoutes;
+}
+
+int CountClampedSummaries(void)
+{
+    return Ctx->clampedSummaries;
+}
+
+int UpdateNbrCost(int nbrID, int costToNbr, int myID)
+{
+    struct adj_rib_in *rib = GetAdjRibIn(nbrID, costToNbr);
+    int updateOccured = 0;
+
+    // The neighbor reaches itself for nothing whether or not its updates said so yet
+    int slot = FindRoute(nbrID);
+    if (slot == EMPTY_SLOT)
+    {
+        slot = AddRoute(nbrID, nbrID, INFINITY);
+        updateOccured = 1;
+    }
+    rib->cost[slot] = 0;
+#ifdef PATHVECTOR
+    if (rib->path[slot] == PATH_EMPTY)
+        rib->path[slot] = PathExtend(PATH_EMPTY, nbrID);
+#endif
+
+    // Routes the neighbor never advertised, like restored ones, are left to its next update
+    for (slot = 0; slot < NumRoutes; slot++)
+    {
+        if (rib->cost[slot] != INFINITY)
+            updateOccured |= ApplyRibRoute(slot, rib);
+    }
+    return updateOccured;
+}
+
+#ifdef PATHVECTOR
+// Fills a fragment with the routes from slot firstRoute on that fit, returns the slot of the first one left out
+static int FillTableFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int firstRoute)
+{
+    struct fragment_paths paths;
+    StartFragmentPaths(&paths);
+    int slot = firstRoute;
+    UpdatePacketToSend->no_routes = 0;
+    while (slot < NumRoutes && UpdatePacketToSend->no_routes < ROUTES_PER_PKT)
+    {
+        int offset = PlaceFragmentPath(&paths, routingTable[slot].path, UpdatePacketToSend->no_routes);
+        if (offset < 0)
+            break;
+        struct route_entry *route = &UpdatePacketToSend->route[UpdatePacketToSend->no_routes++];
+        *route = routingTable[slot++];
+        route->path = offset;
+    }
+    FinishFragmentPaths(&paths, UpdatePacketToSend, UpdatePacketToSend->no_routes, false);
+    return slot;
+}
+
+// Fragments end wherever their paths fill them, so the one asked for is found by filling those before it
+int ConvertTabletoFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID, int fragNo)
+{
+    struct pkt_RT_UPDATE skipped;
+    int fragCount = 0;
+    int nextRoute = 0;
+    do
+    {
+        nextRoute = FillTableFragment((fragCount == fragNo) ? UpdatePacketToSend : &skipped, nextRoute);
+        fragCount += 1;
+    } while (nextRoute < NumRoutes);
+
+    UpdatePacketToSend->sender_id = myID;
+    UpdatePacketToSend->frag_no = fragNo;
+    UpdatePacketToSend->frag_count = fragCount;
+    if (fragNo >= fragCount)
+    {
+        UpdatePacketToSend->no_routes = 0;
+    }
+    return fragCount;
+}
+#else
+// Converts one ROUTES_PER_PKT sized slice of the table to an update fragment
+int ConvertTabletoFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID, int fragNo)
+{
+    int fragCount = (NumRoutes + ROUTES_PER_PKT - 1) / ROUTES_PER_PKT;
+    int firstRoute = fragNo * ROUTES_PER_PKT;
+    int routesLeft = NumRoutes - firstRoute;
+
+    UpdatePacketToSend->sender_id = myID;
+    UpdatePacketToSend->frag_no = fragNo;
+    UpdatePacketToSend->frag_count = fragCount;
+    UpdatePacketToSend->no_routes = (routesLeft < 0) ? 0 : (routesLeft < ROUTES_PER_PKT) ? routesLeft : ROUTES_PER_PKT;
+    memcpy(UpdatePacketToSend->route, &routingTable[firstRoute],
+           UpdatePacketToSend->no_routes * sizeof(struct route_entry));
+    return fragCount;
+}
+#endif
+
 // Converts table to an update packet
 void ConvertTabletoPkt(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID)
 {
+    ConvertTabletoFragment(UpdatePacketToSend, myID, 0);
+}
+
+unsigned int GetTableVersion(void)
+{
+    return Ctx->tableVersion;
+}
+
+unsigned int GetWorsenedVersion(void)
+{
+    return Ctx->worsenedVersion;
+}
+
+// Walks the change list back from the newest route to the oldest one changed after sinceVersion
+static int FirstChangeSince(unsigned int sinceVersion, int *changeCount)
+{
+    int slot = Ctx->newestChange;
+    int firstSlot = EMPTY_SLOT;
+    *changeCount = 0;
+    while (slot != EMPTY_SLOT && Ctx->routeMeta[slot].version > sinceVersion)
+    {
+        firstSlot = slot;
+        *changeCount += 1;
+        slot = Ctx->routeMeta[slot].older;
+    }
+    return firstSlot;
+}
+
+int CountRouteChanges(unsigned int sinceVersion)
+{
+    int changeCount;
+    FirstChangeSince(sinceVersion, &changeCount);
+    return changeCount;
+}
+
+// Copies the next ROUTES_PER_PKT routes changed after sinceVersion into an update fragment
+int ConvertChangestoFragment(struct pkt_RT_UPDATE *UpdatePacketToSend, int myID, unsigned int sinceVersion, int *cursor)
+{
+    int changeCount;
+    int slot = (*cursor == EMPTY_SLOT) ? FirstChangeSince(sinceVersion, &changeCount) : *cursor;
+
     UpdatePacketToSend->sender_id = myID;
-    UpdatePacketToSend->no_routes = NumRoutes;
-    int routingTableIterator = 0;
-    for (routingTableIterator = 0; routingTableIterator < NumRoutes; routingTableIterator++)
+    UpdatePacketToSend->no_routes = 0;
+#ifdef PATHVECTOR
+    struct fragment_paths paths;
+    StartFragmentPaths(&paths);
+#endif
+    while (slot != EMPTY_SLOT && UpdatePacketToSend->no_routes < ROUTES_PER_PKT)
     {
-        UpdatePacketToSend->route[routingTableIterator] = routingTable[routingTableIterator];
+#ifdef PATHVECTOR
+        int offset = PlaceFragmentPath(&paths, routingTable[slot].path, UpdatePacketToSend->no_routes);
+        if (offset < 0)
+            break;
+        UpdatePacketToSend->route[UpdatePacketToSend->no_routes] = routingTable[slot];
+        UpdatePacketToSend->route[UpdatePacketToSend->no_routes++].path = offset;
+#else
+        UpdatePacketToSend->route[UpdatePacketToSend->no_routes++] = routingTable[slot];
+#endif
+        slot = Ctx->routeMeta[slot].newer;
+    }
+#ifdef PATHVECTOR
+    FinishFragmentPaths(&paths, UpdatePacketToSend, UpdatePacketToSend->no_routes, false);
+#endif
+    *cursor = slot;
+    return UpdatePacketToSend->no_routes;
+}
+
+struct route_snapshot *SnapshotRoutingTbl(void)
+{
+    // One allocation holds the header and both arrays
+    size_t size = sizeof(struct route_snapshot) + NumRoutes * (sizeof(struct route_entry) + sizeof(unsigned int));
+    struct route_snapshot *snapshot = malloc(size);
+    if (snapshot == NULL)
+    {
+        printf("Failed to allocate a snapshot of %d routes\n", NumRoutes);
+        exit(EXIT_FAILURE);
+    }
+    snapshot->table_version = Ctx->tableVersion;
+    snapshot->num_routes = NumRoutes;
+    snapshot->routes = (struct route_entry *)(snapshot + 1);
+    snapshot->versions = (unsigned int *)(snapshot->routes + NumRoutes);
+
+    // The change list already orders the routes by version
+    int slot = Ctx->oldestChange;
+    int i = 0;
+    while (slot != EMPTY_SLOT)
+    {
+        snapshot->routes[i] = routingTable[slot];
+        snapshot->versions[i] = Ctx->routeMeta[slot].version;
+#ifdef PATHVECTOR
+        PathRetain(snapshot->routes[i].path);
+#endif
+        i += 1;
+        slot = Ctx->routeMeta[slot].newer;
+    }
+    return snapshot;
+}
+
+void FreeRouteSnapshot(struct route_snapshot *snapshot)
+{
+#ifdef PATHVECTOR
+    ReleaseRoutePaths(snapshot->routes, snapshot->num_routes);
+#endif
+    free(snapshot);
+}
+
+// Returns the index of the first route in the snapshot changed after sinceVersion
+static int FirstSnapshotChangeSince(const struct route_snapshot *snapshot, unsigned int sinceVersion)
+{
+    int low = 0;
+    int high = snapshot->num_routes;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (snapshot->versions[middle] <= sinceVersion)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+int CountSnapshotChanges(const struct route_snapshot *snapshot, unsigned int sinceVersion)
+{
+    return snapshot->num_routes - FirstSnapshotChangeSince(snapshot, sinceVersion);
+}
+
+// Writes the next routes changed after sinceVersion that fit straight into network byte order
+int EncodeSnapshotFragment(const struct route_snapshot *snapshot, struct pkt_RT_UPDATE *UpdatePacketToSend,
+                           unsigned int sinceVersion, int *cursor, int nbrID, int summarize, size_t *pktSize)
+{
+    int routeCount = 0;
+    int i = (*cursor == EMPTY_SLOT) ? FirstSnapshotChangeSince(snapshot, sinceVersion) : *cursor;
+#ifdef PATHVECTOR
+    struct fragment_paths paths;
+    StartFragmentPaths(&paths);
+#else
+    struct route_entry summary; // the last entry written, in host byte order
+#endif
+
+    while (i < snapshot->num_routes && routeCount < ROUTES_PER_PKT)
+    {
+        const struct route_entry *route = &snapshot->routes[i];
+        // Poisoned reverse, routes through the neighbor are advertised back to it as unreachable
+        unsigned int cost = (route->next_hop == nbrID) ? INFINITY : route->cost;
+#ifdef PATHVECTOR
+        int offset = PlaceFragmentPath(&paths, route->path, routeCount);
+        if (offset < 0)
+            break;
+#else
+        struct route_entry sent = {route->dest_id, route->next_hop, cost};
+        if (summarize && routeCount > 0 && ExtendSummary(&summary, &sent))
+        {
+            UpdatePacketToSend->route[routeCount - 1].cost = htonl(summary.cost);
+            i += 1;
+            continue;
+        }
+        summary = sent;
+#endif
+        struct route_entry *wireRoute = &UpdatePacketToSend->route[routeCount++];
+        wireRoute->dest_id = htonl(route->dest_id);
+        wireRoute->next_hop = htonl(route->next_hop);
+        wireRoute->cost = htonl(cost);
+#ifdef PATHVECTOR
+        wireRoute->path_len = htonl(route->path_len);
+        wireRoute->path = htonl(offset);
+#endif
+        i += 1;
     }
+    *pktSize = RT_UPDATE_PKTSIZE(routeCount);
+#ifdef PATHVECTOR
+    FinishFragmentPaths(&paths, UpdatePacketToSend, routeCount, true);
+    *pktSize += paths.words * sizeof(unsigned int);
+#endif
+    *cursor = i;
+    return routeCount;
+}
+
+// Orders routingTable slots by destination id
+static int CompareRouteSlots(const void *a, const void *b)
+{
+    unsigned int destA = routingTable[*(const int *)a].dest_id;
+    unsigned int destB = routingTable[*(const int *)b].dest_id;
+    return (destA > destB) - (destA < destB);
 }
 
 // Prints the routing table to a log file
 void PrintRoutes(FILE *Logfile, int myID)
 {
-    int maxRouterCounter = 0;
     int routingTableIterator = 0;
+    if (PrintOrderCapacity < NumRoutes)
+    {
+        free(PrintOrder);
+        PrintOrderCapacity = Ctx->tableCapacity;
+        PrintOrder = malloc(PrintOrderCapacity * sizeof(int));
+        if (PrintOrder == NULL)
+        {
+            printf("Failed to allocate the routing table print order\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (routingTableIterator = 0; routingTableIterator < NumRoutes; routingTableIterator++)
+    {
+        PrintOrder[routingTableIterator] = routingTableIterator;
+    }
+    qsort(PrintOrder, NumRoutes, sizeof(int), CompareRouteSlots);
+
     // Print to file
     fprintf(Logfile, "\nRouting Table:\n");
-    for (maxRouterCounter = 0; maxRouterCounter < MAX_ROUTERS; maxRouterCounter++)
+    for (routingTableIterator = 0; routingTableIterator < NumRoutes; routingTableIterator++)
     {
-        for (routingTableIterator = 0; routingTableIterator < NumRoutes; routingTableIterator++)
+        int slot = PrintOrder[routingTableIterator];
+        struct route_entry *route = &routingTable[slot];
+        fprintf(Logfile, "R%d -> R%d: R%d", myID, route->dest_id, route->next_hop);
+        // Equal cost next hops follow the advertised one
+        int i;
+        for (i = 0; i < Ctx->routeMeta[slot].noEqualHops; i++)
         {
-            if (routingTable[routingTableIterator].dest_id == maxRouterCounter)
-            {
-                fprintf(Logfile, "R%d -> R%d: R%d, %d\n", myID, maxRouterCounter,
-                        routingTable[routingTableIterator].next_hop, routingTable[routingTableIterator].cost);
-            }
+            fprintf(Logfile, "|R%d", Ctx->routeMeta[slot].equalHops[i]);
         }
+        fprintf(Logfile, ", %d\n", route->cost);
     }
     fflush(Logfile);
 }
 
 void UninstallRoutesOnNbrDeath(int DeadNbr)
 {
+    // Nothing the neighbor advertised holds any more, the other neighbors' routes take over at once
+    struct adj_rib_in *deadRib = FindAdjRibIn(DeadNbr);
+    if (deadRib != NULL)
+    {
+        ClearAdjRibIn(deadRib);
+    }
     int routingTableIterator = 0;
     for (routingTableIterator = 0; routingTableIterator < NumRoutes; routingTableIterator++)
     {
-        if (routingTable[routingTableIterator].next_hop == DeadNbr)
+        if (routingTable[routingTableIterator].next_hop != DeadNbr)
+        {
+            if (HasEqualCostHop(routingTableIterator, DeadNbr) && SetEqualCostHops(routingTableIterator))
+                TouchRoute(routingTableIterator, false);
+            continue;
+        }
+        FreshenRoute(routingTableIterator);
+        if (routingTable[routingTableIterator].cost != INFINITY)
         {
-            routingTable[routingTableIterator].cost = INFINITY;
+            WorsenRoute(routingTableIterator, NULL, INFINITY);
         }
     }
-}
\ No newline at end of file
+}
+
+int RestoreRoute(unsigned int dest_id, unsigned int next_hop, unsigned int cost)
+{
+    // A neighbor may have been reached more cheaply through another one than over its own link
+    int slot = FindRoute(dest_id);
+    if (slot == EMPTY_SLOT)
+    {
+        slot = AddRoute(dest_id, next_hop, cost);
+    }
+    else if (cost < routingTable[slot].cost && !Ctx->routeMeta[slot].stale)
+    {
+        routingTable[slot].next_hop = next_hop;
+        routingTable[slot].cost = cost;
+        ChangeRoute(slot);
+    }
+    else
+    {
+        return 0;
+    }
+#ifdef PATHVECTOR
+    // Paths are not checkpointed, the route goes straight from next_hop to dest_id until it is heard again
+    unsigned int path = PathExtend(PATH_EMPTY, next_hop);
+    if (dest_id != next_hop)
+    {
+        unsigned int longer = PathExtend(path, dest_id);
+        PathRelease(path);
+        path = longer;
+    }
+    SetRoutePath(&routingTable[slot], path);
+#endif
+    Ctx->routeMeta[slot].stale = true;
+    Ctx->staleRoutes += 1;
+    return 1;
+}
+
+int RefreshStaleRoutes(int nbrID, int wholeTable)
+{
+    int expired = 0;
+    int slot;
+    for (slot = 0; slot < NumRoutes && Ctx->staleRoutes > 0; slot++)
+    {
+        if (!Ctx->routeMeta[slot].stale || routingTable[slot].next_hop != nbrID)
+        {
+            continue;
+        }
+        FreshenRoute(slot);
+        // The neighbor's whole table left the route out, it no longer goes through the neighbor
+        if (wholeTable && routingTable[slot].cost != INFINITY)
+        {
+            routingTable[slot].cost = INFINITY;
+            ChangeRoute(slot);
+            Ctx->worsenedVersion = Ctx->tableVersion;
+            expired += 1;
+        }
+    }
+    return expired;
+}
+
+int CountStaleRoutes(void)
+{
+    return Ctx->staleRoutes;
+}
+
+int GetNextHops(unsigned int dest_id, unsigned int *nextHops)
+{
+    int slot = FindRoute(dest_id);
+    if (slot == EMPTY_SLOT)
+    {
+        return 0;
+    }
+    const struct route_meta *meta = &Ctx->routeMeta[slot];
+    nextHops[0] = routingTable[slot].next_hop;
+    memcpy(&nextHops[1], meta->equalHops, meta->noEqualHops * sizeof(unsigned int));
+    return 1 + meta->noEqualHops;
+}
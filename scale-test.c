@@ -0,0 +1,702 @@
+  /*
+   *  File Name: scale-test.c
+   *
+   *  Purpose: Randomized test of routingtable.c at scale. Each run generates a
+   *  connected random topology of thousands of routers, gives every router its own
+   *  routing context and exchanges changed routes between them in rounds until no
+   *  table changes. It then fails random links, brings them back and changes link
+   *  costs, converging again after each step. After every phase each table is
+   *  checked against shortest paths computed with Dijkstra: the cost of every
+   *  route, that every next hop starts a shortest path and, in PATHVECTOR mode,
+   *  that the path is loop free and adds up to the cost.
+   *
+   *  Usage: scale-test [-a] [-n routers] [-d degree] [-c max cost] [-f links] [-r runs] [-s seed]
+   *
+   *  Prints a CSV row per phase with the rounds, updates and wall time it took, and
+   *  exits with EXIT_FAILURE if any table disagrees with the oracle.
+   */
+
+
+#include "ne.h"
+#include "router.h"
+#ifdef PATHVECTOR
+#include "pathtable.h"
+#endif
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+
+#define DEFAULT_ROUTERS 1000
+#define DEFAULT_DEGREE 4      /* average number of links of a router */
+#define DEFAULT_MAX_COST 20   /* link costs are drawn from 1 .. max cost, small ranges give equal cost paths */
+#define DEFAULT_FAILURES 10   /* links failed, restored and changed in cost per run */
+#define DEFAULT_RUNS 3
+#define MAX_REPORTED 10       /* mismatches printed per phase, the rest are only counted */
+
+// Struct that stores one direction of a link
+typedef struct
+{
+    int nbr;                    // index of the router at the far end
+    int reverse;                // index of the opposite direction among the far end's links
+    unsigned int cost;          // cost of the link
+    unsigned int sent_version;  // table version the far end was last sent changes up to
+    bool up;                    // routes cross the link
+} test_link;
+
+// Struct that stores one router under test
+typedef struct
+{
+    struct routing_ctx *ctx;    // the router's routing table
+    int no_links;
+    int link_capacity;
+    test_link *links;
+    unsigned int seen_worsened; // GetWorsenedVersion when the neighbors were last asked for full tables
+} test_router;
+
+// Struct that counts the work of one phase
+typedef struct
+{
+    int rounds;                 // passes over all routers until none had changes to send
+    long long updates;          // fragments applied with UpdateRoutes
+    long long routes;           // routes those fragments carried, a summary counting as one
+    long long table_changes;    // UpdateRoutes calls that changed a table
+} test_stats;
+
+extern struct route_entry *routingTable;
+extern int NumRoutes;
+
+static test_router *Routers;
+static int NumRouters;
+static int NumLinks;
+static test_stats Stats;
+// Shortest path costs, Distance[d * NumRouters + r] is the cost from r to d, at most INFINITY
+static unsigned short *Distance;
+// State of the xorshift generator behind topologies and link events (-s)
+static unsigned long long RandomState;
+// Routers advertise runs of consecutive destinations as summaries (-a)
+static bool SummarizeUpdates = false;
+
+//-------------------------------------- FUNCTION DECLARATIONS---------------------*/
+
+/* Returns a uniformly distributed number in [0, bound) */
+int randomBelow(int bound);
+/* Returns CLOCK_MONOTONIC in milliseconds */
+double wallClockMs(void);
+/* Returns the link from router a to router b, NULL if there is none */
+test_link *findLink(int a, int b);
+/* Links routers a and b in both directions, returns false if they already are */
+bool addLink(int a, int b, unsigned int cost);
+/* Generates a random connected topology, a random spanning tree plus random links */
+void buildTopology(int degree, unsigned int maxCost);
+/* Frees the routers, their links and their routing contexts */
+void freeTopology(void);
+/* Builds each router's initial table from its links */
+void startRouters(void);
+/* Sends every router's changed routes to its neighbors until no table changes */
+void converge(void);
+/* Applies one fragment from router r to its neighbor across link */
+void deliver(int r, test_link *link, struct pkt_RT_UPDATE *fragment);
+/* Asks every neighbor of router r for its whole table once one of r's routes got worse */
+void noteWorsened(int r);
+/* Brings a link up or down at both ends */
+void setLinkState(int r, test_link *link, bool up);
+/* Changes the cost of a link at both ends */
+void setLinkCost(int r, test_link *link, unsigned int cost);
+/* Returns a random link that is up, choosing its lower numbered end */
+test_link *randomUpLink(int *from);
+/* Fills Distance with Dijkstra from every router over the links that are up */
+void computeDistances(void);
+/* Checks every routing table against Distance, returns the number of wrong routes */
+long long checkTables(long long *checked);
+/* Converges, checks and prints the CSV row of one phase */
+long long runPhase(int run, unsigned long long seed, const char *phase);
+
+/*------------------------------ START OF THE PROGRAM ---------------------------*/
+
+int main(int argc, char **argv)
+{
+    int option;
+    bool badOption = false;
+    int degree = DEFAULT_DEGREE;
+    int maxCost = DEFAULT_MAX_COST;
+    int failures = DEFAULT_FAILURES;
+    int runs = DEFAULT_RUNS;
+    unsigned long long seed = 1;
+    NumRouters = DEFAULT_ROUTERS;
+    while ((option = getopt(argc, argv, "an:d:c:f:r:s:")) != -1)
+    {
+        switch (option)
+        {
+        case 'a':
+            SummarizeUpdates = true;
+            break;
+        case 'n':
+            NumRouters = atoi(optarg);
+            badOption = NumRouters < 2;
+            break;
+        case 'd':
+            degree = atoi(optarg);
+            badOption = degree < 2;
+            break;
+        case 'c':
+            maxCost = atoi(optarg);
+            badOption = maxCost < 1 || maxCost >= INFINITY;
+            break;
+        case 'f':
+            failures = atoi(optarg);
+            badOption = failures < 0;
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            badOption = runs < 1;
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            badOption = true;
+        }
+        if (badOption)
+            break;
+    }
+    if (badOption || optind != argc)
+    {
+        printf("usage: scale-test [-a] [-n routers] [-d degree] [-c max cost] [-f links] [-r runs] [-s seed]\n");
+        printf("       -a           advertise consecutive destinations with the same next hop and cost as\n");
+        printf("                    one summary route (DISTVECTOR only)\n");
+        printf("       -n routers   routers of each topology (default %d)\n", DEFAULT_ROUTERS);
+        printf("       -d degree    average links of a router (default %d)\n", DEFAULT_DEGREE);
+        printf("       -c max cost  link costs are drawn from 1 .. max cost (default %d)\n", DEFAULT_MAX_COST);
+        printf("       -f links     links failed, restored and changed in cost per run (default %d)\n",
+               DEFAULT_FAILURES);
+        printf("       -r runs      topologies to test, seeded seed, seed + 1 ... (default %d)\n", DEFAULT_RUNS);
+        printf("       -s seed      seed of the first run (default 1)\n");
+        return EXIT_FAILURE;
+    }
+
+    Distance = malloc((size_t)NumRouters * NumRouters * sizeof(unsigned short));
+    if (Distance == NULL)
+    {
+        printf("Failed to allocate the distances of %d routers\n", NumRouters);
+        return EXIT_FAILURE;
+    }
+    long long mismatches = 0;
+    printf("run,seed,routers,links,phase,rounds,updates,routes_sent,table_changes,routes_checked,mismatches,"
+           "converge_ms,check_ms\n");
+    int run;
+    for (run = 0; run < runs; run++)
+    {
+        RandomState = (seed + run) * 2654435761ULL + 1;
+        buildTopology(degree, maxCost);
+        startRouters();
+        mismatches += runPhase(run, seed + run, "cold-start");
+
+        // The same links fail, come back and then change their costs
+        test_link **changed = malloc((failures + 1) * sizeof(test_link *));
+        int *ends = malloc((failures + 1) * sizeof(int));
+        if (changed == NULL || ends == NULL)
+        {
+            printf("Failed to allocate %d link events\n", failures);
+            return EXIT_FAILURE;
+        }
+        int i, count = 0;
+        for (i = 0; i < failures && count < NumLinks; i++)
+        {
+            changed[count] = randomUpLink(&ends[count]);
+            setLinkState(ends[count], changed[count], false);
+            count++;
+        }
+        mismatches += runPhase(run, seed + run, "link-failure");
+        for (i = 0; i < count; i++)
+        {
+            setLinkState(ends[i], changed[i], true);
+        }
+        mismatches += runPhase(run, seed + run, "link-restore");
+        for (i = 0; i < count; i++)
+        {
+            setLinkCost(ends[i], changed[i], 1 + randomBelow(maxCost));
+        }
+        mismatches += runPhase(run, seed + run, "cost-change");
+        free(changed);
+        free(ends);
+        freeTopology();
+    }
+    free(Distance);
+    return (mismatches == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int randomBelow(int bound)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return (int)((RandomState >> 11) % (unsigned long long)bound);
+}
+
+double wallClockMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+test_link *findLink(int a, int b)
+{
+    int i;
+    for (i = 0; i < Routers[a].no_links; i++)
+    {
+        if (Routers[a].links[i].nbr == b)
+            return &Routers[a].links[i];
+    }
+    return NULL;
+}
+
+bool addLink(int a, int b, unsigned int cost)
+{
+    if (a == b || findLink(a, b) != NULL)
+    {
+        return false;
+    }
+    int ends[2] = {a, b};
+    int slots[2] = {Routers[a].no_links, Routers[b].no_links};
+    int end;
+    for (end = 0; end < 2; end++)
+    {
+        test_router *router = &Routers[ends[end]];
+        if (router->no_links == router->link_capacity)
+        {
+            router->link_capacity = (router->link_capacity == 0) ? 4 : 2 * router->link_capacity;
+            router->links = realloc(router->links, router->link_capacity * sizeof(test_link));
+            if (router->links == NULL)
+            {
+                printf("Failed to allocate the links of R%d\n", ends[end]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        test_link *link = &router->links[router->no_links];
+        link->nbr = ends[1 - end];
+        link->reverse = slots[1 - end];
+        link->cost = cost;
+        link->sent_version = 0;
+        link->up = true;
+        router->no_links += 1;
+    }
+    NumLinks += 1;
+    return true;
+}
+
+void buildTopology(int degree, unsigned int maxCost)
+{
+    Routers = calloc(NumRouters, sizeof(test_router));
+    if (Routers == NULL)
+    {
+        printf("Failed to allocate %d routers\n", NumRouters);
+        exit(EXIT_FAILURE);
+    }
+    NumLinks = 0;
+
+    // The spanning tree keeps the topology connected
+    int r;
+    for (r = 1; r < NumRouters; r++)
+    {
+        addLink(randomBelow(r), r, 1 + randomBelow(maxCost));
+    }
+    long long wanted = (long long)NumRouters * degree / 2;
+    long long possible = (long long)NumRouters * (NumRouters - 1) / 2;
+    if (wanted > possible)
+    {
+        wanted = possible;
+    }
+    while (NumLinks < wanted)
+    {
+        addLink(randomBelow(NumRouters), randomBelow(NumRouters), 1 + randomBelow(maxCost));
+    }
+}
+
+void freeTopology(void)
+{
+    int r;
+    for (r = 0; r < NumRouters; r++)
+    {
+        DestroyRoutingCtx(Routers[r].ctx);
+        free(Routers[r].links);
+    }
+    free(Routers);
+    Routers = NULL;
+}
+
+void startRouters(void)
+{
+    // Routers with more neighbors than an INIT_RESPONSE holds learn them through a one route update
+    struct pkt_INIT_RESPONSE noNeighbors;
+    struct pkt_RT_UPDATE nbrRoute;
+    bzero((char *)&noNeighbors, sizeof(noNeighbors));
+    bzero((char *)&nbrRoute, sizeof(nbrRoute));
+    nbrRoute.no_routes = 1;
+
+    int r;
+    for (r = 0; r < NumRouters; r++)
+    {
+        test_router *router = &Routers[r];
+        router->ctx = CreateRoutingCtx();
+        SelectRoutingCtx(router->ctx);
+        InitRoutingTbl(&noNeighbors, r);
+        int i;
+        for (i = 0; i < router->no_links; i++)
+        {
+            nbrRoute.sender_id = router->links[i].nbr;
+            nbrRoute.route[0].dest_id = router->links[i].nbr;
+            nbrRoute.route[0].next_hop = router->links[i].nbr;
+            nbrRoute.route[0].cost = 0;
+            UpdateRoutes(&nbrRoute, router->links[i].cost, r);
+        }
+        router->seen_worsened = GetWorsenedVersion();
+    }
+}
+
+void converge(void)
+{
+    struct pkt_RT_UPDATE fragment;
+    bool sent = true;
+    while (sent)
+    {
+        sent = false;
+        Stats.rounds += 1;
+        int r;
+        for (r = 0; r < NumRouters; r++)
+        {
+            test_router *router = &Routers[r];
+            SelectRoutingCtx(router->ctx);
+            unsigned int tableVersion = GetTableVersion();
+            int i;
+            for (i = 0; i < router->no_links; i++)
+            {
+                test_link *link = &router->links[i];
+                if (!link->up || link->sent_version == tableVersion)
+                {
+                    continue;
+                }
+                // Delivering selects the neighbor's context, r's table does not change meanwhile.
+                // The neighbor may ask for r's whole table while it applies the changes.
+                unsigned int sinceVersion = link->sent_version;
+                link->sent_version = tableVersion;
+                int cursor = -1;
+                do
+                {
+                    SelectRoutingCtx(router->ctx);
+                    ConvertChangestoFragment(&fragment, r, sinceVersion, &cursor);
+                    fragment.dest_id = link->nbr;
+                    deliver(r, link, &fragment);
+                } while (cursor != -1);
+                sent = true;
+            }
+        }
+    }
+}
+
+void deliver(int r, test_link *link, struct pkt_RT_UPDATE *fragment)
+{
+    // Poisoned reverse, routes through the neighbor are advertised back to it as unreachable
+    unsigned int i;
+    for (i = 0; i < fragment->no_routes; i++)
+    {
+        if (fragment->route[i].next_hop == (unsigned int)link->nbr)
+        {
+            fragment->route[i].cost = INFINITY;
+        }
+    }
+    if (SummarizeUpdates)
+    {
+        SummarizeFragment(fragment);
+    }
+    Stats.updates += 1;
+    Stats.routes += fragment->no_routes;
+    SelectRoutingCtx(Routers[link->nbr].ctx);
+    if (UpdateRoutes(fragment, link->cost, link->nbr))
+    {
+        Stats.table_changes += 1;
+    }
+    noteWorsened(link->nbr);
+}
+
+void noteWorsened(int r)
+{
+    // Like the router, cheaper routes the neighbors advertised before are not resent otherwise
+    test_router *router = &Routers[r];
+    if (GetWorsenedVersion() == router->seen_worsened)
+    {
+        return;
+    }
+    router->seen_worsened = GetWorsenedVersion();
+    int i;
+    for (i = 0; i < router->no_links; i++)
+    {
+        test_link *link = &router->links[i];
+        Routers[link->nbr].links[link->reverse].sent_version = 0;
+    }
+}
+
+void setLinkState(int r, test_link *link, bool up)
+{
+    struct pkt_RT_UPDATE nbrRoute;
+    bzero((char *)&nbrRoute, sizeof(nbrRoute));
+    nbrRoute.no_routes = 1;
+    test_link *ends[2] = {link, &Routers[link->nbr].links[link->reverse]};
+    int routers[2] = {r, link->nbr};
+    int end;
+    for (end = 0; end < 2; end++)
+    {
+        test_link *side = ends[end];
+        side->up = up;
+        side->sent_version = 0;
+        SelectRoutingCtx(Routers[routers[end]].ctx);
+        if (up)
+        {
+            nbrRoute.sender_id = side->nbr;
+            nbrRoute.route[0].dest_id = side->nbr;
+            nbrRoute.route[0].next_hop = side->nbr;
+            UpdateRoutes(&nbrRoute, side->cost, routers[end]);
+        }
+        else
+        {
+            UninstallRoutesOnNbrDeath(side->nbr);
+        }
+        noteWorsened(routers[end]);
+    }
+}
+
+void setLinkCost(int r, test_link *link, unsigned int cost)
+{
+    test_link *ends[2] = {link, &Routers[link->nbr].links[link->reverse]};
+    int routers[2] = {r, link->nbr};
+    int end;
+    for (end = 0; end < 2; end++)
+    {
+        ends[end]->cost = cost;
+        SelectRoutingCtx(Routers[routers[end]].ctx);
+        UpdateNbrCost(ends[end]->nbr, cost, routers[end]);
+        noteWorsened(routers[end]);
+        // As in the simulator, the far end resends its table to be priced at the new cost
+        Routers[ends[end]->nbr].links[ends[end]->reverse].sent_version = 0;
+    }
+}
+
+test_link *randomUpLink(int *from)
+{
+    while (true)
+    {
+        int r = randomBelow(NumRouters);
+        test_router *router = &Routers[r];
+        if (router->no_links == 0)
+            continue;
+        test_link *link = &router->links[randomBelow(router->no_links)];
+        if (link->up)
+        {
+            *from = r;
+            return link;
+        }
+    }
+}
+
+void computeDistances(void)
+{
+    // Binary heap of routers keyed by tentative cost, a router may be on it more than once
+    int capacity = 2 * NumLinks + NumRouters;
+    int *heap = malloc(capacity * sizeof(int));
+    unsigned int *heapCost = malloc(capacity * sizeof(unsigned int));
+    unsigned int *cost = malloc(NumRouters * sizeof(unsigned int));
+    if (heap == NULL || heapCost == NULL || cost == NULL)
+    {
+        printf("Failed to allocate Dijkstra over %d routers\n", NumRouters);
+        exit(EXIT_FAILURE);
+    }
+    int d;
+    for (d = 0; d < NumRouters; d++)
+    {
+        int r;
+        for (r = 0; r < NumRouters; r++)
+        {
+            cost[r] = UINT_MAX;
+        }
+        cost[d] = 0;
+        heap[0] = d;
+        heapCost[0] = 0;
+        int size = 1;
+        while (size > 0)
+        {
+            int top = heap[0];
+            unsigned int topCost = heapCost[0];
+            size -= 1;
+            int hole = 0;
+            while (true)
+            {
+                int child = 2 * hole + 1;
+                if (child >= size)
+                    break;
+                if (child + 1 < size && heapCost[child + 1] < heapCost[child])
+                    child += 1;
+                if (heapCost[size] <= heapCost[child])
+                    break;
+                heap[hole] = heap[child];
+                heapCost[hole] = heapCost[child];
+                hole = child;
+            }
+            heap[hole] = heap[size];
+            heapCost[hole] = heapCost[size];
+            if (topCost != cost[top])
+            {
+                continue;
+            }
+
+            // Links are symmetric, so the cost from d to every router is the cost from it to d
+            int i;
+            for (i = 0; i < Routers[top].no_links; i++)
+            {
+                test_link *link = &Routers[top].links[i];
+                unsigned int through = topCost + link->cost;
+                if (!link->up || through >= cost[link->nbr])
+                    continue;
+                cost[link->nbr] = through;
+                hole = size++;
+                while (hole > 0 && heapCost[(hole - 1) / 2] > through)
+                {
+                    heap[hole] = heap[(hole - 1) / 2];
+                    heapCost[hole] = heapCost[(hole - 1) / 2];
+                    hole = (hole - 1) / 2;
+                }
+                heap[hole] = link->nbr;
+                heapCost[hole] = through;
+            }
+        }
+        unsigned short *row = &Distance[(size_t)d * NumRouters];
+        for (r = 0; r < NumRouters; r++)
+        {
+            row[r] = (cost[r] < INFINITY) ? cost[r] : INFINITY;
+        }
+    }
+    free(heap);
+    free(heapCost);
+    free(cost);
+}
+
+// Prints a wrong route while only a few were found
+static void reportMismatch(long long *mismatches, int r, const struct route_entry *route, const char *problem,
+                           unsigned int expected)
+{
+    if (*mismatches < MAX_REPORTED)
+    {
+        fprintf(stderr, "R%d -> R%u: next hop R%u, cost %u: %s (expected cost %u)\n", r, route->dest_id,
+                route->next_hop, route->cost, problem, expected);
+    }
+    *mismatches += 1;
+}
+
+long long checkTables(long long *checked)
+{
+    long long mismatches = 0;
+    unsigned int nextHops[MAX_NEXT_HOPS];
+    *checked = 0;
+    int r;
+    for (r = 0; r < NumRouters; r++)
+    {
+        SelectRoutingCtx(Routers[r].ctx);
+        int reachable = 0, known = 0;
+        int d;
+        for (d = 0; d < NumRouters; d++)
+        {
+            if (Distance[(size_t)d * NumRouters + r] < INFINITY)
+                reachable++;
+        }
+
+        int i;
+        for (i = 0; i < NumRoutes; i++)
+        {
+            const struct route_entry *route = &routingTable[i];
+            if (route->dest_id >= (unsigned int)NumRouters)
+            {
+                reportMismatch(&mismatches, r, route, "unknown destination", INFINITY);
+                continue;
+            }
+            const unsigned short *row = &Distance[(size_t)route->dest_id * NumRouters];
+            unsigned int expected = row[r];
+            *checked += 1;
+            if (route->cost != expected)
+            {
+                reportMismatch(&mismatches, r, route, "wrong cost", expected);
+                continue;
+            }
+            if (expected == INFINITY)
+                continue;
+            known++;
+            if (route->dest_id == (unsigned int)r)
+                continue;
+
+            // Every next hop of an equal cost set must start a shortest path
+            int hops = GetNextHops(route->dest_id, nextHops);
+            int h;
+            for (h = 0; h < hops; h++)
+            {
+                test_link *link = findLink(r, nextHops[h]);
+                if (link == NULL || !link->up || link->cost + row[link->nbr] != expected)
+                {
+                    reportMismatch(&mismatches, r, route, "next hop is not on a shortest path", expected);
+                    break;
+                }
+            }
+#ifdef PATHVECTOR
+            // The path runs from the next hop to the destination over links that add up to the cost
+            unsigned int pathHops[MAX_PATH_LEN + 1];
+            const struct path_node *node = PathNode(route->path);
+            if (node->length != route->path_len || node->length == 0 || node->length > MAX_PATH_LEN + 1 ||
+                PathContains(route->path, r))
+            {
+                reportMismatch(&mismatches, r, route, "path length does not match or loops", expected);
+                continue;
+            }
+            PathCopyHops(route->path, pathHops);
+            unsigned int pathCost = 0;
+            int from = r;
+            unsigned int p;
+            for (p = 0; p < node->length; p++)
+            {
+                test_link *link = findLink(from, pathHops[p]);
+                if (link == NULL || !link->up)
+                {
+                    pathCost = INFINITY;
+                    break;
+                }
+                pathCost += link->cost;
+                from = link->nbr;
+            }
+            if (pathHops[0] != route->next_hop || from != (int)route->dest_id || pathCost != expected)
+            {
+                reportMismatch(&mismatches, r, route, "path does not add up to the cost", expected);
+            }
+#endif
+        }
+        if (known != reachable)
+        {
+            if (mismatches < MAX_REPORTED)
+                fprintf(stderr, "R%d: routes to %d of %d reachable routers\n", r, known, reachable);
+            mismatches += 1;
+        }
+    }
+    return mismatches;
+}
+
+long long runPhase(int run, unsigned long long seed, const char *phase)
+{
+    bzero((char *)&Stats, sizeof(Stats));
+    double startMs = wallClockMs();
+    converge();
+    double convergedMs = wallClockMs();
+    computeDistances();
+    long long checked;
+    long long mismatches = checkTables(&checked);
+    double checkMs = wallClockMs() - convergedMs;
+    printf("%d,%llu,%d,%d,%s,%d,%lld,%lld,%lld,%lld,%lld,%.1f,%.1f\n", run, seed, NumRouters, NumLinks, phase,
+           Stats.rounds, Stats.updates, Stats.routes, Stats.table_changes, checked, mismatches,
+           convergedMs - startMs, checkMs);
+    fflush(stdout);
+    return mismatches;
+}
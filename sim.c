@@ -0,0 +1,637 @@
+  /*
+   *  File Name: sim.c
+   *
+   *  Purpose: Discrete-event simulator that runs every router of a topology in one
+   *  process. Each router keeps its own routing context from routingtable.c, links
+   *  are in-memory queues with a delay and a loss rate, and all events run on a
+   *  virtual millisecond clock driven by the same timer wheel the router uses.
+   *
+   *  Usage: sim [-a] [-s seed] [-D ms] [-l percent] [-p ms] [-t ms] [-m ms] [-S script] [-v] <topology file>
+   *
+   *  The topology file uses the format of the network emulator, see topology.h.
+   *  Links without a delay of their own take -D, links with a delay of 0 deliver
+   *  on the next tick. The times of a link script (-S) count from the moment the
+   *  routers first converge. A router notices a failed link FAILURE_DETECTION after
+   *  it went down, as a router that stops hearing from its neighbor would.
+   */
+
+
+#include "ne.h"
+#include "router.h"
+#include "timerwheel.h"
+#include "topology.h"
+#include <stdbool.h>
+#include <time.h>
+
+#define DEFAULT_LINK_DELAY_MS 1 /* one way delay of links that do not give one */
+#define DEFAULT_MAX_TIME_MS (3600 * 1000LL) /* virtual time after which the simulation stops */
+
+// Types of timers kept in the simulator's wheel
+#define UPDATE_EVENT 1  /* periodic full update of router nbr */
+#define TRIGGER_EVENT 2 /* triggered update of router nbr may be sent */
+#define DELIVER_EVENT 3 /* a packet reaches the far end of its link */
+#define DETECT_EVENT 4  /* router nbr notices that one of its links went down */
+#define SCRIPT_EVENT 5  /* the next line of the link script is due */
+
+// Struct that stores one direction of a link
+typedef struct
+{
+    int nbr;                    // index of the router at the far end
+    unsigned int cost;          // cost of the link
+    int delay_ms;               // one way delay
+    double loss;                // probability that a packet is dropped
+    unsigned int sent_version;  // table version the far end was last sent changes up to
+    bool up;                    // packets cross the link
+    bool nbr_dead;              // the router has noticed the link is down
+    struct wheel_timer detectTimer; // DETECT_EVENT while the link is down and not noticed yet
+} sim_link;
+
+// Struct that stores one simulated router
+typedef struct
+{
+    struct routing_ctx *ctx;    // the router's routing table
+    int no_links;
+    int link_capacity;
+    sim_link *links;
+    struct wheel_timer updateTimer;
+    struct wheel_timer triggerTimer;
+    long long last_trigger_ms;  // virtual time the last triggered update went out
+    unsigned int seen_worsened; // GetWorsenedVersion when the neighbors were last asked for full tables
+} sim_router;
+
+// Struct that carries one update fragment across a link
+typedef struct
+{
+    struct wheel_timer timer;   // DELIVER_EVENT, nbr holds the receiving router
+    sim_link *link;             // link the packet travels on, seen from the sender
+    struct pkt_RT_UPDATE pkt;   // allocated only up to the routes it carries
+} sim_packet;
+
+// Struct that counts what happened during a run
+typedef struct
+{
+    long long messages;         // fragments sent, including lost ones
+    long long bytes;            // bytes those fragments would take on the wire
+    long long lost;             // fragments dropped by lossy or failed links
+    long long table_changes;    // UpdateRoutes calls that changed a table
+    long long last_change_ms;   // virtual time of the last table change
+} sim_stats;
+
+static sim_router *Routers;
+static int NumRouters;
+static int NumLinks;
+static struct timer_wheel Wheel;
+static sim_stats Stats;
+// Stats when the routers first converged, the link script runs from there
+static sim_stats InitialStats;
+static long long InitialWallMs;
+static long long WallStartMs;
+
+static struct topo_event *Script;
+static int ScriptLength;
+static int ScriptNext;
+static long long ScriptStartMs = -1;
+static struct wheel_timer ScriptTimer;
+// Failed links no router has noticed yet, the routers cannot have converged before they do
+static int PendingDetections;
+
+// Periodic full updates every UpdatePeriodMs (-p), 0 sends triggered updates only
+static long long UpdatePeriodMs = UPDATE_INTERVAL * 1000;
+// Minimum gap between two triggered updates of one router (-t)
+static long long TriggerSpacingMs = TRIGGER_SPACING_MS;
+// Routers advertise runs of consecutive destinations as summaries, like router -a (-a)
+static bool SummarizeUpdates = false;
+// State of the xorshift generator behind link loss and update phases (-s)
+static unsigned long long RandomState = 88172645463325252ULL;
+
+//-------------------------------------- FUNCTION DECLARATIONS---------------------*/
+
+/* Reads the topology file and creates the routers and links */
+void loadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss);
+/* Adds one direction of a link to a router */
+void addLink(int from, int to, unsigned int cost, int delayMs, double loss);
+/* Returns the link from router a to router b */
+sim_link *findLink(int a, int b);
+/* Builds each router's initial table from its links and starts its timers */
+void startRouters(void);
+/* Returns a uniformly distributed number in [0, 1) */
+double randomUnit(void);
+/* Sends router r's routes changed after each link's sent_version, all routes if full is set */
+void sendUpdate(int r, bool full);
+/* Puts one fragment on a link, unless the link loses it */
+void transmit(int r, sim_link *link, struct pkt_RT_UPDATE *fragment);
+/* Applies a delivered fragment to the receiving router's table */
+void deliver(sim_packet *packet);
+/* Counts a change of router r's table and tells its neighbors about it */
+void noteTableChange(int r);
+/* Schedules a triggered update of router r, no sooner than TriggerSpacingMs after the last one */
+void scheduleTrigger(int r);
+/* Makes router r send its whole table over the link from r to nbr with its next triggered update */
+void requestFullUpdate(int r, int nbr);
+/* Router r notices that its link to link->nbr is down and uninstalls the routes through it */
+void detectFailure(int r, sim_link *link);
+/* Applies every line of the link script that is due */
+void runScript(void);
+/* Returns true once the routers have stopped changing their tables */
+bool isConverged(long long nextMs);
+/* Runs events until the routers converge or maxTimeMs passes, returns the virtual time reached */
+long long runSimulation(long long maxTimeMs);
+/* Returns CLOCK_MONOTONIC in milliseconds */
+long long wallClockMs(void);
+/* Prints the CSV row of one phase of the run */
+void printPhase(const char *phase, sim_stats *end, sim_stats *start, long long startMs, long long wallMs);
+
+/*------------------------------ START OF THE PROGRAM ---------------------------*/
+
+int main(int argc, char **argv)
+{
+    int option;
+    bool badOption = false;
+    bool verbose = false;
+    int defaultDelay = DEFAULT_LINK_DELAY_MS;
+    double defaultLoss = 0;
+    long long maxTimeMs = DEFAULT_MAX_TIME_MS;
+    char *scriptFile = NULL;
+    while ((option = getopt(argc, argv, "as:D:l:p:t:m:S:v")) != -1)
+    {
+        switch (option)
+        {
+        case 'a':
+            SummarizeUpdates = true;
+            break;
+        case 's':
+            RandomState = strtoull(optarg, NULL, 0) * 2654435761ULL + 1;
+            break;
+        case 'D':
+            defaultDelay = atoi(optarg);
+            badOption = defaultDelay < 1;
+            break;
+        case 'l':
+            defaultLoss = atof(optarg) / 100;
+            badOption = defaultLoss < 0 || defaultLoss >= 1;
+            break;
+        case 'p':
+            UpdatePeriodMs = atoll(optarg);
+            badOption = UpdatePeriodMs < 0;
+            break;
+        case 't':
+            TriggerSpacingMs = atoll(optarg);
+            badOption = TriggerSpacingMs < 0;
+            break;
+        case 'm':
+            maxTimeMs = atoll(optarg);
+            badOption = maxTimeMs <= 0;
+            break;
+        case 'S':
+            scriptFile = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            badOption = true;
+        }
+        if (badOption)
+            break;
+    }
+    if (badOption || argc - optind != 1)
+    {
+        printf("usage: sim [-a] [-s seed] [-D ms] [-l percent] [-p ms] [-t ms] [-m ms] [-S script] [-v] <topology file>\n");
+        printf("       -a          routers advertise consecutive destinations behind the same next hop at the\n");
+        printf("                   same cost as one summary route (DISTVECTOR only)\n");
+        printf("       -s seed     seed of link loss and update phases\n");
+        printf("       -D ms       delay of links that do not give one (default %d)\n", DEFAULT_LINK_DELAY_MS);
+        printf("       -l percent  loss of links that do not give one (default 0)\n");
+        printf("       -p ms       period of full updates, 0 for triggered updates only (default %d)\n",
+               UPDATE_INTERVAL * 1000);
+        printf("       -t ms       minimum gap between triggered updates of a router (default %d)\n",
+               TRIGGER_SPACING_MS);
+        printf("       -m ms       virtual time after which to give up (default %lld)\n", DEFAULT_MAX_TIME_MS);
+        printf("       -S script   link changes to make once the routers converged\n");
+        printf("       -v          print every routing table at the end\n");
+        return EXIT_FAILURE;
+    }
+
+    struct topology topo;
+    loadTopology(argv[optind], &topo, defaultDelay, defaultLoss);
+    if (scriptFile != NULL)
+    {
+        Script = LoadLinkScript(scriptFile, &topo, &ScriptLength);
+    }
+    free(topo.links);
+
+    WallStartMs = wallClockMs();
+    TimerWheelInit(&Wheel, 0);
+    TimerInit(&ScriptTimer, SCRIPT_EVENT, 0);
+    startRouters();
+    long long endMs = runSimulation(maxTimeMs);
+    long long wallMs = wallClockMs() - WallStartMs;
+
+    if (verbose)
+    {
+        int r;
+        for (r = 0; r < NumRouters; r++)
+        {
+            SelectRoutingCtx(Routers[r].ctx);
+            PrintRoutes(stdout, r);
+        }
+        printf("\n");
+    }
+    // converge_ms of the events phase counts from the first line of the script, -1 if the run gave up
+    bool gaveUp = endMs >= maxTimeMs;
+    printf("phase,routers,links,converge_ms,messages,bytes,lost,table_changes,wall_ms\n");
+    if (ScriptStartMs < 0)
+    {
+        sim_stats noStats;
+        bzero((char *)&noStats, sizeof(noStats));
+        if (gaveUp)
+            Stats.last_change_ms = -1;
+        printPhase("initial", &Stats, &noStats, 0, wallMs);
+    }
+    else
+    {
+        sim_stats noStats;
+        bzero((char *)&noStats, sizeof(noStats));
+        printPhase("initial", &InitialStats, &noStats, 0, InitialWallMs);
+        if (gaveUp)
+            Stats.last_change_ms = -1;
+        printPhase("events", &Stats, &InitialStats, ScriptStartMs, wallMs - InitialWallMs);
+    }
+    return EXIT_SUCCESS;
+}
+
+void printPhase(const char *phase, sim_stats *end, sim_stats *start, long long startMs, long long wallMs)
+{
+    long long convergeMs = end->last_change_ms;
+    if (convergeMs >= 0)
+        convergeMs = (convergeMs > startMs) ? convergeMs - startMs : 0;
+    printf("%s,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld\n", phase, NumRouters, NumLinks, convergeMs,
+           end->messages - start->messages, end->bytes - start->bytes, end->lost - start->lost,
+           end->table_changes - start->table_changes, wallMs);
+}
+
+void loadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss)
+{
+    LoadTopology(fileName, topo, defaultDelay, defaultLoss);
+    NumRouters = topo->no_routers;
+    NumLinks = topo->no_links;
+    Routers = calloc(NumRouters, sizeof(sim_router));
+    if (Routers == NULL)
+    {
+        printf("Failed to allocate %d routers\n", NumRouters);
+        exit(EXIT_FAILURE);
+    }
+    int i;
+    for (i = 0; i < topo->no_links; i++)
+    {
+        struct topo_link *link = &topo->links[i];
+        addLink(link->a, link->b, link->cost, link->delay_ms, link->loss);
+        addLink(link->b, link->a, link->cost, link->delay_ms, link->loss);
+    }
+}
+
+void addLink(int from, int to, unsigned int cost, int delayMs, double loss)
+{
+    sim_router *router = &Routers[from];
+    if (router->no_links == router->link_capacity)
+    {
+        router->link_capacity = (router->link_capacity == 0) ? 4 : 2 * router->link_capacity;
+        router->links = realloc(router->links, router->link_capacity * sizeof(sim_link));
+        if (router->links == NULL)
+        {
+            printf("Failed to allocate the links of R%d\n", from);
+            exit(EXIT_FAILURE);
+        }
+    }
+    sim_link *link = &router->links[router->no_links++];
+    link->nbr = to;
+    link->cost = cost;
+    link->delay_ms = delayMs;
+    link->loss = loss;
+    link->sent_version = 0;
+    link->up = true;
+    link->nbr_dead = false;
+    TimerInit(&link->detectTimer, DETECT_EVENT, from);
+}
+
+sim_link *findLink(int a, int b)
+{
+    int i;
+    for (i = 0; i < Routers[a].no_links; i++)
+    {
+        if (Routers[a].links[i].nbr == b)
+            return &Routers[a].links[i];
+    }
+    return NULL;
+}
+
+void startRouters(void)
+{
+    // Routers with more neighbors than an INIT_RESPONSE holds learn them through a one route update
+    struct pkt_INIT_RESPONSE noNeighbors;
+    struct pkt_RT_UPDATE nbrRoute;
+    bzero((char *)&noNeighbors, sizeof(noNeighbors));
+    bzero((char *)&nbrRoute, sizeof(nbrRoute));
+    nbrRoute.no_routes = 1;
+
+    int r;
+    for (r = 0; r < NumRouters; r++)
+    {
+        sim_router *router = &Routers[r];
+        router->ctx = CreateRoutingCtx();
+        SelectRoutingCtx(router->ctx);
+        InitRoutingTbl(&noNeighbors, r);
+        int i;
+        for (i = 0; i < router->no_links; i++)
+        {
+            nbrRoute.sender_id = router->links[i].nbr;
+            nbrRoute.route[0].dest_id = router->links[i].nbr;
+            nbrRoute.route[0].next_hop = router->links[i].nbr;
+            nbrRoute.route[0].cost = 0;
+            UpdateRoutes(&nbrRoute, router->links[i].cost, r);
+        }
+
+        // Routers boot together but their periodic updates are spread over one period
+        TimerInit(&router->updateTimer, UPDATE_EVENT, r);
+        TimerInit(&router->triggerTimer, TRIGGER_EVENT, r);
+        router->last_trigger_ms = -TriggerSpacingMs;
+        if (UpdatePeriodMs > 0)
+        {
+            TimerWheelSchedule(&Wheel, &router->updateTimer, (long long)(randomUnit() * UpdatePeriodMs));
+        }
+        scheduleTrigger(r);
+    }
+}
+
+double randomUnit(void)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return (RandomState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void sendUpdate(int r, bool full)
+{
+    sim_router *router = &Routers[r];
+    SelectRoutingCtx(router->ctx);
+    unsigned int tableVersion = GetTableVersion();
+    struct pkt_RT_UPDATE fragment;
+
+    int i;
+    for (i = 0; i < router->no_links; i++)
+    {
+        sim_link *link = &router->links[i];
+        unsigned int sinceVersion = full ? 0 : link->sent_version;
+        if (!full && sinceVersion == tableVersion)
+        {
+            continue;
+        }
+        int cursor = -1;
+        do
+        {
+            ConvertChangestoFragment(&fragment, r, sinceVersion, &cursor);
+            fragment.dest_id = link->nbr;
+            transmit(r, link, &fragment);
+        } while (cursor != -1);
+        link->sent_version = tableVersion;
+    }
+}
+
+void transmit(int r, sim_link *link, struct pkt_RT_UPDATE *fragment)
+{
+    // Poisoned reverse, routes through the neighbor are advertised back to it as unreachable
+    unsigned int i;
+    for (i = 0; i < fragment->no_routes; i++)
+    {
+        if (fragment->route[i].next_hop == link->nbr)
+        {
+            fragment->route[i].cost = INFINITY;
+        }
+    }
+    if (SummarizeUpdates)
+    {
+        SummarizeFragment(fragment);
+    }
+    size_t pktSize = size_pkt_RT_UPDATE(fragment);
+    Stats.messages += 1;
+    Stats.bytes += pktSize;
+    if (!link->up || (link->loss > 0 && randomUnit() < link->loss))
+    {
+        Stats.lost += 1;
+        return;
+    }
+
+    sim_packet *packet = malloc(offsetof(sim_packet, pkt) + pktSize);
+    if (packet == NULL)
+    {
+        printf("Failed to allocate a packet from R%d to R%d\n", r, link->nbr);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&packet->pkt, fragment, pktSize);
+    packet->link = link;
+    TimerInit(&packet->timer, DELIVER_EVENT, link->nbr);
+    TimerWheelSchedule(&Wheel, &packet->timer, Wheel.now + link->delay_ms);
+}
+
+void deliver(sim_packet *packet)
+{
+    int r = packet->timer.nbr;
+    // Packets in flight when the link failed never arrive
+    if (!packet->link->up)
+    {
+        Stats.lost += 1;
+        free(packet);
+        return;
+    }
+    SelectRoutingCtx(Routers[r].ctx);
+    if (UpdateRoutes(&packet->pkt, findLink(r, packet->pkt.sender_id)->cost, r))
+    {
+        noteTableChange(r);
+    }
+    free(packet);
+}
+
+void noteTableChange(int r)
+{
+    sim_router *router = &Routers[r];
+    Stats.table_changes += 1;
+    Stats.last_change_ms = Wheel.now;
+    scheduleTrigger(r);
+
+    // Like the router, ask the neighbors for their whole tables once a route got worse,
+    // cheaper routes they advertised before are not resent otherwise
+    if (GetWorsenedVersion() != router->seen_worsened)
+    {
+        router->seen_worsened = GetWorsenedVersion();
+        int i;
+        for (i = 0; i < router->no_links; i++)
+        {
+            if (!router->links[i].nbr_dead)
+                requestFullUpdate(router->links[i].nbr, r);
+        }
+    }
+}
+
+void scheduleTrigger(int r)
+{
+    sim_router *router = &Routers[r];
+    if (router->triggerTimer.level != -1)
+    {
+        return;
+    }
+    long long dueMs = router->last_trigger_ms + TriggerSpacingMs;
+    TimerWheelSchedule(&Wheel, &router->triggerTimer, (dueMs > Wheel.now) ? dueMs : Wheel.now);
+}
+
+void requestFullUpdate(int r, int nbr)
+{
+    findLink(r, nbr)->sent_version = 0;
+    scheduleTrigger(r);
+}
+
+void detectFailure(int r, sim_link *link)
+{
+    PendingDetections -= 1;
+    link->nbr_dead = true;
+    SelectRoutingCtx(Routers[r].ctx);
+    unsigned int tableVersion = GetTableVersion();
+    UninstallRoutesOnNbrDeath(link->nbr);
+    if (GetTableVersion() != tableVersion)
+    {
+        noteTableChange(r);
+    }
+}
+
+void runScript(void)
+{
+    while (ScriptNext < ScriptLength && ScriptStartMs + Script[ScriptNext].at_ms <= Wheel.now)
+    {
+        struct topo_event *event = &Script[ScriptNext++];
+        int ends[2] = {event->a, event->b};
+        int end;
+        for (end = 0; end < 2; end++)
+        {
+            int r = ends[end];
+            int nbr = ends[1 - end];
+            sim_link *link = findLink(r, nbr);
+            switch (event->action)
+            {
+            case LINK_DOWN:
+                if (link->up)
+                {
+                    link->up = false;
+                    PendingDetections += 1;
+                    TimerWheelSchedule(&Wheel, &link->detectTimer, Wheel.now + FAILURE_DETECTION * 1000);
+                }
+                break;
+            case LINK_UP:
+                if (!link->up && link->detectTimer.level != -1)
+                {
+                    TimerWheelCancel(&Wheel, &link->detectTimer);
+                    PendingDetections -= 1;
+                }
+                // The neighbors resync in full as soon as they hear from each other again
+                link->up = true;
+                link->nbr_dead = false;
+                requestFullUpdate(r, nbr);
+                break;
+            case LINK_COST:
+            {
+                // Like handleLinkCost in the router, the routes through the neighbor are
+                // recosted from what it advertised and it resends its whole table
+                link->cost = (unsigned int)event->value;
+                SelectRoutingCtx(Routers[r].ctx);
+                if (UpdateNbrCost(nbr, link->cost, r))
+                {
+                    noteTableChange(r);
+                }
+                requestFullUpdate(nbr, r);
+                break;
+            }
+            case LINK_DELAY:
+                link->delay_ms = (int)event->value;
+                break;
+            case LINK_LOSS:
+                link->loss = event->value / 100;
+                break;
+            }
+        }
+    }
+    if (ScriptNext < ScriptLength)
+    {
+        TimerWheelSchedule(&Wheel, &ScriptTimer, ScriptStartMs + Script[ScriptNext].at_ms);
+    }
+}
+
+bool isConverged(long long nextMs)
+{
+    if (nextMs < 0)
+    {
+        return true;
+    }
+    // With periodic updates events never run out, the tables must sit still for CONVERGE_TIMEOUT
+    long long quietSinceMs = (Stats.last_change_ms > ScriptStartMs) ? Stats.last_change_ms : ScriptStartMs;
+    return UpdatePeriodMs > 0 && PendingDetections == 0 && nextMs - quietSinceMs >= CONVERGE_TIMEOUT * 1000;
+}
+
+long long runSimulation(long long maxTimeMs)
+{
+    long long nextMs;
+    while (true)
+    {
+        nextMs = TimerWheelNextWakeup(&Wheel);
+        if (isConverged(nextMs))
+        {
+            if (ScriptNext == ScriptLength && (ScriptStartMs >= 0 || ScriptLength == 0))
+            {
+                return (nextMs < 0) ? Wheel.now : nextMs;
+            }
+            // The script starts once the routers converged the first time
+            if (ScriptStartMs < 0)
+            {
+                ScriptStartMs = (nextMs < 0) ? Wheel.now : nextMs;
+                InitialStats = Stats;
+                InitialWallMs = wallClockMs() - WallStartMs;
+                TimerWheelSchedule(&Wheel, &ScriptTimer, ScriptStartMs + Script[0].at_ms);
+                continue;
+            }
+        }
+        if (nextMs > maxTimeMs)
+        {
+            return maxTimeMs;
+        }
+
+        struct wheel_timer *timer;
+        while ((timer = TimerWheelAdvance(&Wheel, nextMs)) != NULL)
+        {
+            switch (timer->type)
+            {
+            case UPDATE_EVENT:
+                sendUpdate(timer->nbr, true);
+                TimerWheelSchedule(&Wheel, timer, nextMs + UpdatePeriodMs);
+                break;
+            case TRIGGER_EVENT:
+                Routers[timer->nbr].last_trigger_ms = nextMs;
+                sendUpdate(timer->nbr, false);
+                break;
+            case DELIVER_EVENT:
+                deliver((sim_packet *)timer);
+                break;
+            case DETECT_EVENT:
+                detectFailure(timer->nbr, (sim_link *)((char *)timer - offsetof(sim_link, detectTimer)));
+                break;
+            case SCRIPT_EVENT:
+                runScript();
+                break;
+            }
+        }
+    }
+}
+
+long long wallClockMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,77 @@
+  /*
+   *  File Name: stats.c
+   *
+   *  Purpose: Latency histograms with power of two buckets.
+   */
+
+
+#include <time.h>
+#include "stats.h"
+
+long long StatsNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void StatsRecord(struct stats_histogram *hist, long long ns)
+{
+    unsigned long long latency = (ns < 0) ? 0 : (unsigned long long)ns;
+    // Bucket b holds latencies with b significant bits
+    int bucket = (latency == 0) ? 0 : 64 - __builtin_clzll(latency);
+    if (bucket >= STATS_HIST_BUCKETS)
+    {
+        bucket = STATS_HIST_BUCKETS - 1;
+    }
+    StatsAdd(&hist->buckets[bucket], 1);
+    StatsAdd(&hist->count, 1);
+    StatsAdd(&hist->sum_ns, latency);
+
+    unsigned long long max = StatsRead(&hist->max_ns);
+    while (latency > max && !__atomic_compare_exchange_n(&hist->max_ns, &max, latency, 1, __ATOMIC_RELAXED,
+                                                         __ATOMIC_RELAXED))
+    {
+    }
+}
+
+// Returns the upper bound of the bucket holding the given fraction of the latencies
+static unsigned long long Percentile(unsigned long long *buckets, unsigned long long count, double fraction)
+{
+    unsigned long long wanted = (unsigned long long)(fraction * count + 0.5);
+    unsigned long long seen = 0;
+    int bucket;
+    for (bucket = 0; bucket < STATS_HIST_BUCKETS; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= wanted && seen > 0)
+            return 1ULL << bucket;
+    }
+    return 0;
+}
+
+void StatsPrintHistogram(FILE *out, const char *name, struct stats_histogram *hist)
+{
+    // Take a copy so the summary and the buckets agree even while latencies are recorded
+    unsigned long long buckets[STATS_HIST_BUCKETS];
+    unsigned long long count = 0;
+    int bucket;
+    for (bucket = 0; bucket < STATS_HIST_BUCKETS; bucket++)
+    {
+        buckets[bucket] = StatsRead(&hist->buckets[bucket]);
+        count += buckets[bucket];
+    }
+    unsigned long long sum = StatsRead(&hist->sum_ns);
+    unsigned long long max = StatsRead(&hist->max_ns);
+
+    // A bucket bound can overshoot the largest latency seen
+    unsigned long long p50 = Percentile(buckets, count, 0.50);
+    unsigned long long p99 = Percentile(buckets, count, 0.99);
+    fprintf(out, "%s count %llu mean_ns %llu p50_ns %llu p99_ns %llu max_ns %llu\n", name, count,
+            count ? sum / count : 0, (p50 < max) ? p50 : max, (p99 < max) ? p99 : max, max);
+    for (bucket = 0; bucket < STATS_HIST_BUCKETS; bucket++)
+    {
+        if (buckets[bucket] != 0)
+            fprintf(out, "%s_bucket le_ns %llu %llu\n", name, 1ULL << bucket, buckets[bucket]);
+    }
+}
@@ -0,0 +1,63 @@
+/*stats.h*/
+
+#ifndef STATS_H
+#define STATS_H
+
+  /*
+   *  File Name: stats.h
+   *
+   *  Purpose: Counters and latency histograms that are cheap enough to leave on.
+   *  Updates are relaxed atomic adds, so a counter may be bumped from any thread
+   *  and read while it is being updated without tearing.
+   */
+
+#include <stdio.h>
+
+#define STATS_HIST_BUCKETS 48 /* bucket b counts latencies of at least 2^(b-1) and below 2^b ns */
+
+struct stats_histogram {
+  unsigned long long count; /* latencies recorded */
+  unsigned long long sum_ns; /* their sum */
+  unsigned long long max_ns; /* the largest one */
+  unsigned long long buckets[STATS_HIST_BUCKETS]; /* log2 buckets, see STATS_HIST_BUCKETS */
+};
+
+/* Adds n to a counter */
+static inline void StatsAdd(unsigned long long *counter, unsigned long long n)
+{
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+/* Reads a counter */
+static inline unsigned long long StatsRead(const unsigned long long *counter)
+{
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* Routine Name    : StatsNowNs
+ * INPUT ARGUMENTS : None
+ * RETURN VALUE    : long long - CLOCK_MONOTONIC in ns
+ * USAGE           : Taken before and after the code being timed, the difference goes to StatsRecord.
+ */
+long long StatsNowNs(void);
+
+/* Routine Name    : StatsRecord
+ * INPUT ARGUMENTS : 1. (struct stats_histogram *) - The histogram
+ *                   2. long long - A latency in ns
+ * RETURN VALUE    : void
+ * USAGE           : Adds one latency to the histogram.
+ */
+void StatsRecord(struct stats_histogram *hist, long long ns);
+
+/* Routine Name    : StatsPrintHistogram
+ * INPUT ARGUMENTS : 1. (FILE *) - Where to print
+ *                   2. (const char *) - Name of the histogram
+ *                   3. (struct stats_histogram *) - The histogram
+ * RETURN VALUE    : void
+ * USAGE           : Prints one summary line "<name> count .. mean_ns .. p50_ns .. p99_ns .. max_ns .."
+ *                   followed by one "<name>_bucket le_ns <bound> <count>" line per non empty bucket.
+ *                   Percentiles are the upper bound of the bucket they fall in, capped at max_ns.
+ */
+void StatsPrintHistogram(FILE *out, const char *name, struct stats_histogram *hist);
+
+#endif
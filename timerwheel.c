@@ -0,0 +1,203 @@
+  /*
+   *  File Name: timerwheel.c
+   *
+   *  Purpose: Hierarchical timer wheel with a 1 ms tick. Level 0 holds timers due within
+   *  the next 64 ms, each level above covers 64 times the span of the one below. Timers
+   *  in an upper level are moved down (cascaded) when the wheel reaches their slot.
+   */
+
+
+#include <stddef.h>
+#include "timerwheel.h"
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define EXPIRED_LEVEL WHEEL_LEVELS /* level of timers waiting on the expired list */
+#define UNSCHEDULED -1             /* level of timers that are not pending */
+
+// Rotates a slot bitmap right so that bit 0 corresponds to slot first
+static unsigned long long RotateSlots(unsigned long long occupied, int first)
+{
+    return first ? (occupied >> first) | (occupied << (WHEEL_SLOTS - first)) : occupied;
+}
+
+// Pushes a timer on the front of a list
+static void LinkTimer(struct wheel_timer **head, struct wheel_timer *timer)
+{
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head != NULL)
+    {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+}
+
+// Removes a pending timer from its slot or from the expired list
+static void UnlinkTimer(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+    struct wheel_timer **head = (timer->level == EXPIRED_LEVEL) ? &wheel->expired
+                                                                : &wheel->slots[timer->level][timer->slot];
+    if (timer->prev != NULL)
+        timer->prev->next = timer->next;
+    else
+        *head = timer->next;
+    if (timer->next != NULL)
+    {
+        timer->next->prev = timer->prev;
+    }
+    if (timer->level != EXPIRED_LEVEL && *head == NULL)
+    {
+        wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+    }
+    timer->level = UNSCHEDULED;
+}
+
+// Puts a timer in the slot matching how far away its deadline is
+static void PlaceTimer(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+    long long expires = (timer->expires < wheel->now) ? wheel->now : timer->expires;
+    long long delay = expires - wheel->now;
+    if (delay > WHEEL_MAX_DELAY)
+    {
+        // Parked at the far end of the wheel and placed again when it cascades down
+        expires = wheel->now + WHEEL_MAX_DELAY;
+        delay = WHEEL_MAX_DELAY;
+    }
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delay >= (1LL << ((level + 1) * WHEEL_SLOT_BITS)))
+    {
+        level++;
+    }
+    timer->level = level;
+    timer->slot = (expires >> (level * WHEEL_SLOT_BITS)) & WHEEL_MASK;
+    LinkTimer(&wheel->slots[level][timer->slot], timer);
+    wheel->occupied[level] |= 1ULL << timer->slot;
+}
+
+// Moves the timers of the current slot of a level down, and the level above when this one wrapped
+static void Cascade(struct timer_wheel *wheel, int level)
+{
+    int slot = (wheel->now >> (level * WHEEL_SLOT_BITS)) & WHEEL_MASK;
+    struct wheel_timer *timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+    while (timer != NULL)
+    {
+        struct wheel_timer *next = timer->next;
+        PlaceTimer(wheel, timer);
+        timer = next;
+    }
+    if (slot == 0 && level + 1 < WHEEL_LEVELS)
+    {
+        Cascade(wheel, level + 1);
+    }
+}
+
+void TimerInit(struct wheel_timer *timer, int type, int nbr)
+{
+    timer->type = type;
+    timer->nbr = nbr;
+    timer->expires = 0;
+    timer->level = UNSCHEDULED;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+void TimerWheelInit(struct timer_wheel *wheel, long long nowMs)
+{
+    int level, slot;
+    wheel->now = nowMs;
+    wheel->expired = NULL;
+    for (level = 0; level < WHEEL_LEVELS; level++)
+    {
+        wheel->occupied[level] = 0;
+        for (slot = 0; slot < WHEEL_SLOTS; slot++)
+        {
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+}
+
+void TimerWheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer, long long expiresMs)
+{
+    TimerWheelCancel(wheel, timer);
+    timer->expires = expiresMs;
+    PlaceTimer(wheel, timer);
+}
+
+void TimerWheelCancel(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+    if (timer->level != UNSCHEDULED)
+    {
+        UnlinkTimer(wheel, timer);
+    }
+}
+
+struct wheel_timer *TimerWheelAdvance(struct timer_wheel *wheel, long long nowMs)
+{
+    while (wheel->expired == NULL && wheel->now <= nowMs)
+    {
+        // Everything in the level 0 slot of this tick has fired
+        int slot = wheel->now & WHEEL_MASK;
+        while (wheel->slots[0][slot] != NULL)
+        {
+            struct wheel_timer *timer = wheel->slots[0][slot];
+            UnlinkTimer(wheel, timer);
+            timer->level = EXPIRED_LEVEL;
+            LinkTimer(&wheel->expired, timer);
+        }
+
+        // Skip the empty ticks up to the next pending slot or the end of this turn of level 0
+        slot += 1;
+        unsigned long long ahead = (slot < WHEEL_SLOTS) ? wheel->occupied[0] >> slot : 0;
+        long long next = (ahead != 0) ? wheel->now + 1 : (wheel->now | WHEEL_MASK) + 1;
+        if (next > nowMs + 1)
+        {
+            wheel->now = nowMs + 1;
+            break;
+        }
+        wheel->now = next;
+        if ((wheel->now & WHEEL_MASK) == 0)
+        {
+            Cascade(wheel, 1);
+        }
+    }
+
+    struct wheel_timer *timer = wheel->expired;
+    if (timer != NULL)
+    {
+        UnlinkTimer(wheel, timer);
+    }
+    return timer;
+}
+
+long long TimerWheelNextWakeup(struct timer_wheel *wheel)
+{
+    if (wheel->expired != NULL)
+    {
+        return wheel->now;
+    }
+
+    long long wakeup = -1;
+    int level;
+    // Level 0 holds exact deadlines within the next WHEEL_SLOTS ticks
+    if (wheel->occupied[0] != 0)
+    {
+        int first = wheel->now & WHEEL_MASK;
+        wakeup = wheel->now + __builtin_ctzll(RotateSlots(wheel->occupied[0], first));
+    }
+    // Upper levels only say when their next occupied slot cascades
+    for (level = 1; level < WHEEL_LEVELS; level++)
+    {
+        if (wheel->occupied[level] == 0)
+        {
+            continue;
+        }
+        long long turn = (wheel->now >> (level * WHEEL_SLOT_BITS)) + 1;
+        int first = turn & WHEEL_MASK;
+        long long cascadeAt = (turn + __builtin_ctzll(RotateSlots(wheel->occupied[level], first)))
+                              << (level * WHEEL_SLOT_BITS);
+        wakeup = (wakeup < 0 || cascadeAt < wakeup) ? cascadeAt : wakeup;
+    }
+    return wakeup;
+}
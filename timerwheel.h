@@ -0,0 +1,88 @@
+/*timerwheel.h*/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+  /*
+   *  File Name: timerwheel.h
+   *
+   *  Purpose: Defines a hierarchical timer wheel that keeps every deadline of the
+   *  router (updates, convergence, neighbor failure detection) behind one timerfd.
+   *  Scheduling and cancelling a timer is O(1) no matter how many timers exist.
+   */
+
+#define WHEEL_LEVELS 4 /* levels of the wheel, each covering 64 times the span of the one below */
+#define WHEEL_SLOTS 64 /* slots per level */
+#define WHEEL_SLOT_BITS 6 /* log2(WHEEL_SLOTS) */
+#define WHEEL_MAX_DELAY ((1LL << (WHEEL_LEVELS * WHEEL_SLOT_BITS)) - 1) /* longest delay in ms, about 4.6 hours */
+
+struct wheel_timer {
+  int type; /* what the timer is for, interpreted by the owner */
+  int nbr; /* neighbor index for per neighbor timers */
+  long long expires; /* monotonic time in ms at which the timer fires */
+  int level; /* level of the wheel holding the timer, -1 if not scheduled */
+  int slot; /* slot within that level */
+  struct wheel_timer *next; /* next timer in the same slot */
+  struct wheel_timer *prev; /* previous timer in the same slot */
+};
+
+struct timer_wheel {
+  long long now; /* every tick before now has been processed */
+  unsigned long long occupied[WHEEL_LEVELS]; /* bit s is set when slot s of a level holds timers */
+  struct wheel_timer *slots[WHEEL_LEVELS][WHEEL_SLOTS]; /* doubly linked lists of pending timers */
+  struct wheel_timer *expired; /* timers that fired and have not been handed out yet */
+};
+
+/* Routine Name    : TimerInit
+ * INPUT ARGUMENTS : 1. (struct wheel_timer *) - The timer to initialize
+ *                   2. int - What the timer is for
+ *                   3. int - Neighbor index for per neighbor timers, ignored otherwise
+ * RETURN VALUE    : void
+ * USAGE           : Must be called once before a timer is first scheduled.
+ */
+void TimerInit(struct wheel_timer *timer, int type, int nbr);
+
+/* Routine Name    : TimerWheelInit
+ * INPUT ARGUMENTS : 1. (struct timer_wheel *) - The wheel to initialize
+ *                   2. long long - The current monotonic time in ms
+ * RETURN VALUE    : void
+ * USAGE           : Empties the wheel and starts it at the given time.
+ */
+void TimerWheelInit(struct timer_wheel *wheel, long long nowMs);
+
+/* Routine Name    : TimerWheelSchedule
+ * INPUT ARGUMENTS : 1. (struct timer_wheel *) - The wheel
+ *                   2. (struct wheel_timer *) - The timer, scheduled or not
+ *                   3. long long - Monotonic time in ms at which the timer should fire
+ * RETURN VALUE    : void
+ * USAGE           : (Re)schedules the timer. A timer that is already pending is moved.
+ *                   Deadlines in the past fire on the next TimerWheelAdvance.
+ */
+void TimerWheelSchedule(struct timer_wheel *wheel, struct wheel_timer *timer, long long expiresMs);
+
+/* Routine Name    : TimerWheelCancel
+ * INPUT ARGUMENTS : 1. (struct timer_wheel *) - The wheel
+ *                   2. (struct wheel_timer *) - The timer
+ * RETURN VALUE    : void
+ * USAGE           : Stops the timer if it is pending, otherwise does nothing.
+ */
+void TimerWheelCancel(struct timer_wheel *wheel, struct wheel_timer *timer);
+
+/* Routine Name    : TimerWheelAdvance
+ * INPUT ARGUMENTS : 1. (struct timer_wheel *) - The wheel
+ *                   2. long long - The current monotonic time in ms
+ * RETURN VALUE    : struct wheel_timer * - The next timer that has fired, or NULL once there are none.
+ * USAGE           : Moves the wheel forward to nowMs and hands out the timers that fired, one per call.
+ *                   A timer that is handed out is no longer scheduled and may be rescheduled right away.
+ */
+struct wheel_timer *TimerWheelAdvance(struct timer_wheel *wheel, long long nowMs);
+
+/* Routine Name    : TimerWheelNextWakeup
+ * INPUT ARGUMENTS : 1. (struct timer_wheel *) - The wheel
+ * RETURN VALUE    : long long - Time in ms at which TimerWheelAdvance should next be called, -1 if no timer is pending.
+ * USAGE           : The time returned is never later than the earliest pending deadline. It may be
+ *                   earlier when timers on an upper level have to be moved down first.
+ */
+long long TimerWheelNextWakeup(struct timer_wheel *wheel);
+
+#endif
@@ -0,0 +1,236 @@
+  /*
+   *  File Name: topogen.c
+   *
+   *  Purpose: Writes topology files for the simulator and the emulator. Every
+   *  topology it generates is connected and link costs are drawn from 1 to MAX_GEN_COST.
+   *
+   *  Usage: topogen <ring|grid|random|scalefree|sites> <routers> [seed]
+   *
+   *  ring       each router is linked to the next one, the last to the first
+   *  grid       routers fill the rows of a square grid, linked to their right and lower neighbors
+   *  random     a random spanning tree plus random links, four links per router on average
+   *  scalefree  preferential attachment, each new router links to two routers chosen by degree
+   *  sites      sites of SITE_SIZE routers with consecutive ids, the first is the site's gateway
+   *             and the others hang off it at cost 1, gateways are linked like a random topology
+   */
+
+
+#include "ne.h"
+
+#define MAX_GEN_COST 20 /* largest link cost generated */
+#define RANDOM_DEGREE 4 /* average number of links per router in random topologies */
+#define ATTACH_LINKS 2  /* links each router adds in scale-free topologies */
+#define SITE_SIZE 16    /* routers of a site in site topologies, gateway included */
+
+// Struct that remembers which links exist so none is generated twice
+typedef struct
+{
+    unsigned long long *keys; // a * routers + b + 1 for a < b, 0 for an empty bucket
+    unsigned long long mask;
+} link_set;
+
+static unsigned long long RandomState = 88172645463325252ULL;
+static link_set Links;
+static int NumRouters;
+
+//-------------------------------------- FUNCTION DECLARATIONS---------------------*/
+
+/* Returns a uniformly distributed number in [0, n) */
+int randomBelow(int n);
+/* Prints the link between a and b unless it exists already, returns 1 if it was new */
+int addLink(int a, int b);
+/* Like addLink with the given cost, a cost of 0 draws one from 1 to MAX_GEN_COST */
+int addLinkCost(int a, int b, int cost);
+void ring(void);
+void grid(void);
+void randomGraph(void);
+void scaleFree(void);
+void sites(void);
+
+/*------------------------------ START OF THE PROGRAM ---------------------------*/
+
+int main(int argc, char **argv)
+{
+    if (argc < 3 || argc > 4 || atoi(argv[2]) <= 0)
+    {
+        printf("usage: topogen <ring|grid|random|scalefree|sites> <routers> [seed]\n");
+        return EXIT_FAILURE;
+    }
+    NumRouters = atoi(argv[2]);
+    if (argc == 4)
+    {
+        RandomState = strtoull(argv[3], NULL, 0) * 2654435761ULL + 1;
+    }
+
+    // Sized for every generator at under half load
+    unsigned long long buckets = 1;
+    while (buckets < 4ULL * RANDOM_DEGREE * NumRouters)
+    {
+        buckets <<= 1;
+    }
+    Links.keys = calloc(buckets, sizeof(unsigned long long));
+    Links.mask = buckets - 1;
+    if (Links.keys == NULL)
+    {
+        printf("Failed to allocate the link set\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%d\n", NumRouters);
+    if (strcmp(argv[1], "ring") == 0)
+        ring();
+    else if (strcmp(argv[1], "grid") == 0)
+        grid();
+    else if (strcmp(argv[1], "random") == 0)
+        randomGraph();
+    else if (strcmp(argv[1], "scalefree") == 0)
+        scaleFree();
+    else if (strcmp(argv[1], "sites") == 0)
+        sites();
+    else
+    {
+        fprintf(stderr, "Unknown topology %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    free(Links.keys);
+    return EXIT_SUCCESS;
+}
+
+int randomBelow(int n)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 7;
+    RandomState ^= RandomState << 17;
+    return (int)((RandomState >> 11) % n);
+}
+
+int addLink(int a, int b)
+{
+    return addLinkCost(a, b, 0);
+}
+
+int addLinkCost(int a, int b, int cost)
+{
+    if (a == b)
+    {
+        return 0;
+    }
+    unsigned long long key = (a < b) ? (unsigned long long)a * NumRouters + b + 1
+                                     : (unsigned long long)b * NumRouters + a + 1;
+    unsigned long long bucket = (key * 11400714819323198485ULL) & Links.mask;
+    while (Links.keys[bucket] != 0)
+    {
+        if (Links.keys[bucket] == key)
+            return 0;
+        bucket = (bucket + 1) & Links.mask;
+    }
+    Links.keys[bucket] = key;
+    printf("%d %d %d\n", a, b, (cost > 0) ? cost : 1 + randomBelow(MAX_GEN_COST));
+    return 1;
+}
+
+void ring(void)
+{
+    int r;
+    for (r = 0; r + 1 < NumRouters; r++)
+    {
+        addLink(r, r + 1);
+    }
+    if (NumRouters > 2)
+    {
+        addLink(NumRouters - 1, 0);
+    }
+}
+
+void grid(void)
+{
+    int width = 1;
+    while (width * width < NumRouters)
+    {
+        width++;
+    }
+    int r;
+    for (r = 0; r < NumRouters; r++)
+    {
+        if ((r + 1) % width != 0 && r + 1 < NumRouters)
+            addLink(r, r + 1);
+        if (r + width < NumRouters)
+            addLink(r, r + width);
+    }
+}
+
+void randomGraph(void)
+{
+    // The spanning tree keeps the topology connected
+    int r;
+    for (r = 1; r < NumRouters; r++)
+    {
+        addLink(randomBelow(r), r);
+    }
+    long long links = NumRouters - 1;
+    long long wanted = (long long)NumRouters * RANDOM_DEGREE / 2;
+    long long possible = (long long)NumRouters * (NumRouters - 1) / 2;
+    if (wanted > possible)
+    {
+        wanted = possible;
+    }
+    while (links < wanted)
+    {
+        links += addLink(randomBelow(NumRouters), randomBelow(NumRouters));
+    }
+}
+
+void scaleFree(void)
+{
+    // Every link end goes on this list, so a uniform pick from it is proportional to degree
+    int *ends = malloc(2 * ATTACH_LINKS * (long long)NumRouters * sizeof(int));
+    if (ends == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the degree list\n");
+        exit(EXIT_FAILURE);
+    }
+    int endCount = 0;
+    int r, i;
+    for (r = 1; r < NumRouters; r++)
+    {
+        int attach = (r < ATTACH_LINKS) ? r : ATTACH_LINKS;
+        for (i = 0; i < attach; i++)
+        {
+            int target;
+            do
+            {
+                target = (endCount == 0) ? 0 : ends[randomBelow(endCount)];
+            } while (!addLink(target, r));
+            ends[endCount++] = target;
+            ends[endCount++] = r;
+        }
+    }
+    free(ends);
+}
+
+void sites(void)
+{
+    // The gateways form a random topology among themselves, like randomGraph over every SITE_SIZE-th id
+    int siteCount = (NumRouters + SITE_SIZE - 1) / SITE_SIZE;
+    int site, r;
+    for (site = 1; site < siteCount; site++)
+    {
+        addLink(randomBelow(site) * SITE_SIZE, site * SITE_SIZE);
+    }
+    long long links = siteCount - 1;
+    long long wanted = (long long)siteCount * RANDOM_DEGREE / 2;
+    long long possible = (long long)siteCount * (siteCount - 1) / 2;
+    if (wanted > possible)
+    {
+        wanted = possible;
+    }
+    while (links < wanted)
+    {
+        links += addLink(randomBelow(siteCount) * SITE_SIZE, randomBelow(siteCount) * SITE_SIZE);
+    }
+    for (r = 0; r < NumRouters; r++)
+    {
+        if (r % SITE_SIZE != 0)
+            addLinkCost(r - r % SITE_SIZE, r, 1);
+    }
+}
@@ -0,0 +1,148 @@
+  /*
+   *  File Name: topology.c
+   *
+   *  Purpose: Parses topology files in the network emulator format.
+   */
+
+
+#include "ne.h"
+#include "topology.h"
+
+void LoadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss)
+{
+    FILE *topologyFile = fopen(fileName, "r");
+    if (topologyFile == NULL)
+    {
+        printf("Failed to open topology file %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    if (fscanf(topologyFile, "%d", &topo->no_routers) != 1 || topo->no_routers <= 0)
+    {
+        printf("Topology file %s does not start with the number of routers\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    int capacity = 16;
+    topo->no_links = 0;
+    topo->links = malloc(capacity * sizeof(struct topo_link));
+    char line[256];
+    int lineNo = 1;
+    while (topo->links != NULL && fgets(line, sizeof(line), topologyFile) != NULL)
+    {
+        struct topo_link link;
+        double lossPercent = defaultLoss * 100;
+        link.delay_ms = defaultDelay;
+        int fields = sscanf(line, "%d %d %u %d %lf", &link.a, &link.b, &link.cost, &link.delay_ms, &lossPercent);
+        if (fields <= 0)
+        {
+            lineNo++;
+            continue;
+        }
+        if (fields < 3 || link.a < 0 || link.b < 0 || link.a >= topo->no_routers || link.b >= topo->no_routers ||
+            link.a == link.b || link.cost == 0 || link.cost >= INFINITY || link.delay_ms < 0 ||
+            lossPercent < 0 || lossPercent >= 100)
+        {
+            printf("Bad link on line %d of %s\n", lineNo, fileName);
+            exit(EXIT_FAILURE);
+        }
+        link.loss = lossPercent / 100;
+        if (topo->no_links == capacity)
+        {
+            capacity *= 2;
+            topo->links = realloc(topo->links, capacity * sizeof(struct topo_link));
+            if (topo->links == NULL)
+                break;
+        }
+        topo->links[topo->no_links++] = link;
+        lineNo++;
+    }
+    if (topo->links == NULL)
+    {
+        printf("Failed to allocate the links of %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    fclose(topologyFile);
+}
+
+// Returns 1 if the topology has a link between a and b
+static int HasLink(struct topology *topo, int a, int b)
+{
+    int i;
+    for (i = 0; i < topo->no_links; i++)
+    {
+        if ((topo->links[i].a == a && topo->links[i].b == b) || (topo->links[i].a == b && topo->links[i].b == a))
+            return 1;
+    }
+    return 0;
+}
+
+// Orders events by time, keeping the file order of events due at the same time
+static int CompareEvents(const void *a, const void *b)
+{
+    const struct topo_event *eventA = a;
+    const struct topo_event *eventB = b;
+    if (eventA->at_ms != eventB->at_ms)
+        return (eventA->at_ms > eventB->at_ms) - (eventA->at_ms < eventB->at_ms);
+    return (eventA > eventB) - (eventA < eventB);
+}
+
+struct topo_event *LoadLinkScript(const char *fileName, struct topology *topo, int *eventCount)
+{
+    FILE *scriptFile = fopen(fileName, "r");
+    if (scriptFile == NULL)
+    {
+        printf("Failed to open script file %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *actions[] = {NULL, "down", "up", "cost", "delay", "loss"};
+    struct topo_event *events = NULL;
+    int capacity = 0;
+    char line[256];
+    int lineNo = 0;
+    *eventCount = 0;
+    while (fgets(line, sizeof(line), scriptFile) != NULL)
+    {
+        lineNo++;
+        char actionName[16];
+        struct topo_event event;
+        event.value = 0;
+        int fields = sscanf(line, "%lld %15s %d %d %lf", &event.at_ms, actionName, &event.a, &event.b, &event.value);
+        if (fields <= 0 || line[0] == '#')
+        {
+            continue;
+        }
+        event.action = 0;
+        int action;
+        for (action = LINK_DOWN; action <= LINK_LOSS; action++)
+        {
+            if (fields >= 2 && strcmp(actionName, actions[action]) == 0)
+                event.action = action;
+        }
+        int needsValue = event.action >= LINK_COST;
+        if (fields < 4 || event.action == 0 || event.at_ms < 0 || (needsValue && fields < 5) ||
+            event.a < 0 || event.a >= topo->no_routers || event.b < 0 || event.b >= topo->no_routers ||
+            !HasLink(topo, event.a, event.b) ||
+            (event.action == LINK_COST && (event.value < 1 || event.value >= INFINITY)) ||
+            (event.action == LINK_DELAY && event.value < 0) ||
+            (event.action == LINK_LOSS && (event.value < 0 || event.value >= 100)))
+        {
+            printf("Bad line %d in script %s\n", lineNo, fileName);
+            exit(EXIT_FAILURE);
+        }
+        if (*eventCount == capacity)
+        {
+            capacity = (capacity == 0) ? 16 : 2 * capacity;
+            events = realloc(events, capacity * sizeof(struct topo_event));
+            if (events == NULL)
+            {
+                printf("Failed to allocate the script\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        events[(*eventCount)++] = event;
+    }
+    fclose(scriptFile);
+    qsort(events, *eventCount, sizeof(struct topo_event), CompareEvents);
+    return events;
+}
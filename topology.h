@@ -0,0 +1,66 @@
+/*topology.h*/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+  /*
+   *  File Name: topology.h
+   *
+   *  Purpose: Reads topology files in the network emulator format, shared by the
+   *  emulator and the simulator. The first line holds the number of routers, each
+   *  following line one link "router router cost [delay_ms [loss_percent]]".
+   *
+   *  Link scripts hold one change per line, "<ms> <action> <router> <router> [value]",
+   *  where action is one of down, up, cost, delay or loss (in percent).
+   */
+
+struct topo_link {
+  int a; /* router at one end */
+  int b; /* router at the other end */
+  unsigned int cost; /* cost of the link in both directions */
+  int delay_ms; /* one way delay */
+  double loss; /* probability that a packet is dropped, in [0, 1) */
+};
+
+struct topology {
+  int no_routers; /* routers are numbered 0 to no_routers - 1 */
+  int no_links;
+  struct topo_link *links;
+};
+
+#define LINK_DOWN 1 /* the link stops carrying packets */
+#define LINK_UP 2 /* the link carries packets again */
+#define LINK_COST 3 /* value is the new cost */
+#define LINK_DELAY 4 /* value is the new one way delay in ms */
+#define LINK_LOSS 5 /* value is the new loss in percent */
+
+struct topo_event {
+  long long at_ms; /* when the change happens, the owner of the script decides from when it counts */
+  int action; /* LINK_* */
+  int a; /* router at one end of the link */
+  int b; /* router at the other end */
+  double value; /* new cost, delay or loss */
+};
+
+/* Routine Name    : LoadTopology
+ * INPUT ARGUMENTS : 1. (const char *) - Path of the topology file
+ *                   2. (struct topology *) - Filled with the routers and links of the file
+ *                   3. int - Delay in ms of links that do not give one
+ *                   4. double - Loss in [0, 1) of links that do not give one
+ * RETURN VALUE    : void
+ * USAGE           : Exits with a message naming the line if the file is malformed.
+ */
+void LoadTopology(const char *fileName, struct topology *topo, int defaultDelay, double defaultLoss);
+
+/* Routine Name    : LoadLinkScript
+ * INPUT ARGUMENTS : 1. (const char *) - Path of the script file
+ *                   2. (struct topology *) - The topology the script applies to
+ *                   3. (int *) - Set to the number of events read
+ * RETURN VALUE    : struct topo_event * - Heap allocated events sorted by time, lines due at the
+ *                   same time keep their order in the file.
+ * USAGE           : Exits with a message naming the line if it is malformed or names a link
+ *                   that is not in the topology. Lines starting with # are comments.
+ */
+struct topo_event *LoadLinkScript(const char *fileName, struct topology *topo, int *eventCount);
+
+#endif
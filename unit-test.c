@@ -10,6 +10,14 @@
 
 #include "ne.h"
 #include "router.h"
+#include "routelog.h"
+#include "fib.h"
+#include "checkpoint.h"
+#ifdef PATHVECTOR
+#include "pathtable.h"
+#endif
+
+#define LARGE_TABLE_ROUTES 100000
 
 #define MyAssert(X,Y) ASSERT(__FILE__,__FUNCTION__,__LINE__,X,Y)
 
@@ -21,6 +29,9 @@ void ASSERT(char *file,const char *func,int line,int x,char *y) {
     }
 }
 
+extern struct route_entry *routingTable;
+extern int NumRoutes;
+
 struct pkt_INIT_RESPONSE nbrs;
 int MyRouterId = 0;
 
@@ -61,6 +72,7 @@ int TestNewRoute() {
     int nbr = 999;
 
     struct pkt_RT_UPDATE updpkt, resultpkt; 
+    bzero((char *)&updpkt, sizeof(updpkt));
  
     updpkt.sender_id = 1;
     updpkt.dest_id = 0;
@@ -86,6 +98,7 @@ int TestDVUpdate() {
     int i;
     int nbr = 999;
     struct pkt_RT_UPDATE updpkt, resultpkt;   
+    bzero((char *)&updpkt, sizeof(updpkt));
 
     updpkt.sender_id = 2;
     updpkt.dest_id = 0;
@@ -111,6 +124,7 @@ int TestForcedUpd() {
     int i;
     int nbr = 999;
     struct pkt_RT_UPDATE updpkt, resultpkt;   
+    bzero((char *)&updpkt, sizeof(updpkt));
 
     updpkt.sender_id = 2;
     updpkt.dest_id = 0;
@@ -136,6 +150,7 @@ int TestSplitHorizon() {
     int i;
     int nbr = 999;
     struct pkt_RT_UPDATE updpkt, resultpkt;   
+    bzero((char *)&updpkt, sizeof(updpkt));
 
     updpkt.sender_id = 2;
     updpkt.dest_id = 0;
@@ -157,6 +172,689 @@ int TestSplitHorizon() {
 }
 
 
+int TestLargeTable() {
+
+    int i, j;
+    int changed = 0;
+    int startRoutes = NumRoutes;
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+
+    updpkt.sender_id = 1;
+    updpkt.dest_id = 0;
+    for(i=0; i<LARGE_TABLE_ROUTES; i+=MAX_ROUTERS) {
+        updpkt.no_routes = MAX_ROUTERS;
+        for(j=0; j<MAX_ROUTERS; j++) {
+            updpkt.route[j].dest_id = 100 + i + j;
+            updpkt.route[j].next_hop = 1;
+            updpkt.route[j].cost = 1;
+        }
+        changed += UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    }
+    MyAssert(changed==LARGE_TABLE_ROUTES/MAX_ROUTERS,"A packet of new destinations did not change the routing table");
+    MyAssert(NumRoutes==startRoutes+LARGE_TABLE_ROUTES,"Incorrect number of routes after adding many destinations");
+
+    // Advertising the same routes again must not change or grow the table
+    changed = 0;
+    for(i=0; i<LARGE_TABLE_ROUTES; i+=MAX_ROUTERS) {
+        for(j=0; j<MAX_ROUTERS; j++) {
+            updpkt.route[j].dest_id = 100 + i + j;
+        }
+        changed += UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    }
+    MyAssert(changed==0,"Re-advertising known routes changed the routing table");
+    MyAssert(NumRoutes==startRoutes+LARGE_TABLE_ROUTES,"Re-advertising known routes grew the routing table");
+    for(i=startRoutes; i<NumRoutes; i++) {
+        MyAssert((routingTable[i].next_hop==1 && routingTable[i].cost==5),"Incorrect next hop or cost in a large routing table");
+    }
+    return 0;
+}
+
+int TestFragments() {
+
+    int fragNo;
+    int fragCount = 1;
+    int routesSeen = 0;
+    struct pkt_RT_UPDATE fragpkt;
+
+    for(fragNo=0; fragNo<fragCount; fragNo++) {
+        fragCount = ConvertTabletoFragment(&fragpkt, MyRouterId, fragNo);
+        MyAssert(fragpkt.frag_no==fragNo && fragpkt.frag_count==fragCount,"Incorrect fragment numbering");
+        MyAssert(fragpkt.no_routes>0 && fragpkt.no_routes<=ROUTES_PER_PKT,"Incorrect number of routes in a fragment");
+        MyAssert(fragpkt.route[0].dest_id==routingTable[routesSeen].dest_id,"Fragment does not start where the previous one ended");
+        MyAssert(RT_UPDATE_PKTSIZE(fragpkt.no_routes)<=PACKETSIZE,"Fragment does not fit in one datagram");
+        routesSeen += fragpkt.no_routes;
+    }
+    MyAssert(fragCount>1,"A large routing table was not fragmented");
+    MyAssert(routesSeen==NumRoutes,"Fragments do not cover the whole routing table");
+    return 0;
+}
+
+int TestDeltaUpdate() {
+
+    int cursor = -1;
+    unsigned int version = GetTableVersion();
+    struct pkt_RT_UPDATE updpkt, resultpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+
+    MyAssert(CountRouteChanges(version)==0,"Routes reported as changed without an update");
+    MyAssert(CountRouteChanges(0)==NumRoutes,"A full update does not cover the whole routing table");
+
+    updpkt.sender_id = 1;
+    updpkt.dest_id = 0;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 100;
+    updpkt.route[0].next_hop = 1;
+    updpkt.route[0].cost = 7;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    MyAssert(GetTableVersion()>version,"Table version did not advance on a route change");
+    MyAssert(CountRouteChanges(version)==1,"Incorrect number of changed routes in a delta update");
+    ConvertChangestoFragment(&resultpkt, MyRouterId, version, &cursor);
+    MyAssert(resultpkt.no_routes==1,"Incorrect number of routes in a delta update");
+    MyAssert((resultpkt.route[0].dest_id==100 && resultpkt.route[0].cost==11),"Incorrect route in a delta update");
+    return 0;
+}
+
+int TestWorsenedVersion() {
+
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    unsigned int worsened = GetWorsenedVersion();
+
+    // Route 100 goes through neighbor 1 since TestDeltaUpdate, a cheaper cost is not a worsening
+    updpkt.sender_id = 1;
+    updpkt.dest_id = 0;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 100;
+    updpkt.route[0].next_hop = 1;
+    updpkt.route[0].cost = 5;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    MyAssert(GetWorsenedVersion()==worsened,"A cheaper route counted as a worsening");
+
+    updpkt.route[0].cost = 40;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    MyAssert(GetWorsenedVersion()==GetTableVersion(),"A forced update to a higher cost was not counted as a worsening");
+
+    worsened = GetWorsenedVersion();
+    UninstallRoutesOnNbrDeath(1);
+    MyAssert(GetWorsenedVersion()>worsened,"Uninstalling routes was not counted as a worsening");
+    return 0;
+}
+
+// Reads past count routes of a routing log, returns the number read
+unsigned int SkipLoggedRoutes(FILE *logfd, unsigned int count) {
+
+    unsigned int i;
+    struct routelog_route route;
+    unsigned int nextHops[MAX_NEXT_HOPS];
+    for(i=0; i<count; i++) {
+        if(fread(&route, sizeof(route), 1, logfd)!=1 || route.no_next_hops<1 || route.no_next_hops>MAX_NEXT_HOPS ||
+           fread(nextHops, sizeof(unsigned int), route.no_next_hops, logfd)!=route.no_next_hops)
+            break;
+    }
+    return i;
+}
+
+int TestRouteLog() {
+
+    char fileName[] = "/tmp/unit-test-XXXXXX";
+    int fd = mkstemp(fileName);
+    MyAssert(fd>=0,"Could not create a temporary routing log");
+    close(fd);
+    MyAssert(RouteLogOpen(fileName, MyRouterId)==0,"Could not open the routing log");
+
+    // The first record holds the whole table, the next one only what changed
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    RouteLogTable();
+    updpkt.sender_id = 2;
+    updpkt.dest_id = 0;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 100;
+    updpkt.route[0].next_hop = 2;
+    updpkt.route[0].cost = 1;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    RouteLogTable();
+    RouteLogConverged(7);
+    RouteLogClose();
+
+    FILE *logfd = fopen(fileName, "rb");
+    struct routelog_file_header header;
+    struct routelog_record record;
+    struct routelog_route route;
+    unsigned int nextHop;
+    MyAssert((fread(&header, sizeof(header), 1, logfd)==1 && header.magic==ROUTELOG_MAGIC),"Routing log header missing");
+    MyAssert((fread(&record, sizeof(record), 1, logfd)==1 && record.type==ROUTELOG_FULL && record.no_routes==NumRoutes),"First record does not hold the whole table");
+    MyAssert(SkipLoggedRoutes(logfd, record.no_routes)==record.no_routes,"First record holds fewer routes than it says");
+    MyAssert((fread(&record, sizeof(record), 1, logfd)==1 && record.type==ROUTELOG_TABLE && record.no_routes==1),"Second record does not hold only the changed route");
+    MyAssert((fread(&route, sizeof(route), 1, logfd)==1 && route.dest_id==100 && route.no_next_hops==1 && route.cost==4),"Incorrect route in a routing log diff");
+    MyAssert((fread(&nextHop, sizeof(nextHop), 1, logfd)==1 && nextHop==2),"Incorrect next hop in a routing log diff");
+    MyAssert((fread(&record, sizeof(record), 1, logfd)==1 && record.type==ROUTELOG_CONVERGED && record.value==7),"Converged record missing");
+    fclose(logfd);
+
+    // A table larger than the ring is still logged whole, in pieces, and logging goes on after it
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+    MyAssert(RouteLogOpen(fileName, MyRouterId)==0,"Could not open the routing log");
+    updpkt.no_routes = ROUTES_PER_PKT;
+    int i, j;
+    for(i=0; i<ROUTELOG_RING_BYTES / (int)sizeof(route); i+=ROUTES_PER_PKT) {
+        for(j=0; j<ROUTES_PER_PKT; j++) {
+            updpkt.route[j].dest_id = 1000 + i + j;
+            updpkt.route[j].next_hop = 2;
+            updpkt.route[j].cost = 1;
+#ifdef PATHVECTOR
+            updpkt.route[j].path_len = 0;
+#endif
+        }
+        UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    }
+    RouteLogTable();
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost + nbrs.nbrcost[1].cost, MyRouterId);
+    RouteLogTable();
+    MyAssert(RouteLogDropped()==0,"A record was dropped");
+    RouteLogClose();
+    logfd = fopen(fileName, "rb");
+    MyAssert(fread(&header, sizeof(header), 1, logfd)==1,"Routing log header missing");
+    MyAssert((fread(&record, sizeof(record), 1, logfd)==1 && record.type==ROUTELOG_FULL && record.no_routes==NumRoutes),"Large table was not logged whole");
+    MyAssert(SkipLoggedRoutes(logfd, record.no_routes)==record.no_routes,"Large table record holds fewer routes than it says");
+    MyAssert((fread(&record, sizeof(record), 1, logfd)==1 && record.type==ROUTELOG_TABLE && record.no_routes==ROUTES_PER_PKT),"Changes after a large table were not logged");
+    fclose(logfd);
+    unlink(fileName);
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    return 0;
+}
+
+int TestFib() {
+
+    int i;
+    struct fib *fib = FibCreate();
+    MyAssert(FibSync(fib)==NumRoutes,"First FIB sync did not compile the whole table");
+    for(i=0; i<NumRoutes; i++) {
+        unsigned int expected = (routingTable[i].cost >= INFINITY) ? FIB_NO_ROUTE : routingTable[i].next_hop;
+        MyAssert(FibLookup(fib, routingTable[i].dest_id)==expected,"FIB next hop differs from the routing table");
+    }
+    MyAssert(FibLookup(fib, 100 + LARGE_TABLE_ROUTES)==FIB_NO_ROUTE,"FIB found a route to an unknown destination");
+
+    // Only the changed route is applied on the next sync
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 2;
+    updpkt.dest_id = 0;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 200;
+    updpkt.route[0].next_hop = 2;
+    updpkt.route[0].cost = 0;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    MyAssert(FibSync(fib)==1,"FIB sync applied more than the changed route");
+    MyAssert(FibLookup(fib, 200)==2,"FIB missed a changed next hop");
+    FibDestroy(fib);
+    return 0;
+}
+
+int TestSwapKernels() {
+
+    int kernel, count, offset, i;
+    unsigned int words[64];
+
+    for (kernel = SWAP_KERNEL_SCALAR; kernel <= SWAP_KERNEL_AVX2; kernel++) {
+        if (!select_swap_kernel(kernel))
+            continue;
+        // Every length and alignment the vector loops and their scalar tails can see
+        for (count = 0; count <= 40; count++) {
+            for (offset = 0; offset < 4; offset++) {
+                for (i = 0; i < 64; i++)
+                    words[i] = 0x01020304u * (i + 1);
+                swap_words(&words[offset], count);
+                for (i = 0; i < 64; i++) {
+                    unsigned int expected = 0x01020304u * (i + 1);
+                    if (i >= offset && i < offset + count)
+                        expected = htonl(expected);
+                    MyAssert(words[i]==expected,"Byte swap kernel disagrees with htonl");
+                }
+            }
+        }
+    }
+    select_swap_kernel(SWAP_KERNEL_AUTO);
+
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 3;
+    updpkt.no_routes = 2;
+    updpkt.ack_version = 9;
+    updpkt.route[1].dest_id = 7;
+    updpkt.route[1].cost = 12;
+    hton_pkt_RT_UPDATE(&updpkt);
+    MyAssert((updpkt.no_routes==htonl(2) && updpkt.route[1].cost==htonl(12)),"Update not converted to network order");
+    ntoh_pkt_RT_UPDATE(&updpkt);
+    MyAssert((updpkt.sender_id==3 && updpkt.ack_version==9 && updpkt.route[1].dest_id==7),"Update did not survive a round trip");
+    return 0;
+}
+
+int TestCheckpoint() {
+
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // Neighbor 1 reaches 50 and neighbor 2 reaches 60, one hop further
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.no_routes = 1;
+    updpkt.route[0].cost = 1;
+#ifdef PATHVECTOR
+    updpkt.route[0].path_len = 1;
+#endif
+    int i;
+    for(i=0; i<2; i++) {
+        updpkt.sender_id = nbrs.nbrcost[i].nbr;
+        updpkt.route[0].dest_id = 50 + 10 * i;
+        updpkt.route[0].next_hop = 50 + 10 * i;
+#ifdef PATHVECTOR
+        RT_UPDATE_PATHS(&updpkt)[0] = 50 + 10 * i;
+#endif
+        UpdateRoutes(&updpkt, nbrs.nbrcost[i].cost, MyRouterId);
+    }
+
+    char fileName[] = "/tmp/unit-test-XXXXXX";
+    int fd = mkstemp(fileName);
+    MyAssert(fd>=0,"Could not create a temporary checkpoint");
+    // A file sized for a capacity that is not a power of two is started over at the initial size
+    MyAssert(ftruncate(fd, sizeof(struct checkpoint_header) + 1500 * sizeof(struct checkpoint_route))==0,"Could not size the temporary checkpoint");
+    close(fd);
+    struct checkpoint *checkpoint = CheckpointOpen(fileName, MyRouterId);
+    MyAssert((checkpoint!=NULL && !checkpoint->restorable),"An empty file was taken for a checkpoint");
+    MyAssert(checkpoint->header->capacity==CHECKPOINT_INITIAL_ROUTES,"An odd sized file kept its capacity");
+    struct checkpoint_nbr savedNbrs[2];
+    for(i=0; i<2; i++) {
+        savedNbrs[i].nbr = nbrs.nbrcost[i].nbr;
+        savedNbrs[i].cost = nbrs.nbrcost[i].cost;
+        savedNbrs[i].epoch = 11;
+        savedNbrs[i].applied_version = 5 + i;
+    }
+    MyAssert(CheckpointSync(checkpoint, savedNbrs, 2)==NumRoutes,"First sync did not save the whole table");
+    updpkt.route[0].cost = 2;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    MyAssert(CheckpointSync(checkpoint, savedNbrs, 2)==1,"Sync saved more than the changed route");
+    CheckpointClose(checkpoint);
+
+    // Reopened, the file holds the routes and neighbors saved
+    checkpoint = CheckpointOpen(fileName, MyRouterId);
+    MyAssert((checkpoint!=NULL && checkpoint->restorable),"A saved checkpoint was not restorable");
+    MyAssert((checkpoint->header->no_routes==NumRoutes && checkpoint->header->no_nbr==2 &&
+              checkpoint->header->nbrs[1].applied_version==6),"Checkpoint header differs from what was saved");
+
+    // Restored into a fresh table every route beyond the neighbors comes back stale
+    struct routing_ctx *restoredCtx = CreateRoutingCtx();
+    SelectRoutingCtx(restoredCtx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+    int restored = 0;
+    for(i=0; i<checkpoint->header->no_routes; i++) {
+        struct checkpoint_route *route = &checkpoint->routes[i];
+        restored += RestoreRoute(route->dest_id, route->next_hop, route->cost);
+    }
+    MyAssert((restored==2 && CountStaleRoutes()==2),"Restore did not add exactly the routes beyond the neighbors");
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 60; i++);
+    MyAssert((i<NumRoutes && routingTable[i].next_hop==2 && routingTable[i].cost==5),"Restored route differs from the saved one");
+    // A header claiming a capacity that is not a power of two is not trusted
+    checkpoint->header->capacity = 1500;
+    CheckpointClose(checkpoint);
+    checkpoint = CheckpointOpen(fileName, MyRouterId);
+    MyAssert((checkpoint!=NULL && !checkpoint->restorable),"A checkpoint with an odd capacity was restorable");
+    CheckpointClose(checkpoint);
+    unlink(fileName);
+
+    // Neighbor 1 advertises 50 again, neighbor 2's whole table leaves 60 out
+    updpkt.sender_id = nbrs.nbrcost[0].nbr;
+    updpkt.route[0].dest_id = 50;
+    updpkt.route[0].next_hop = 50;
+    updpkt.route[0].cost = 1;
+#ifdef PATHVECTOR
+    RT_UPDATE_PATHS(&updpkt)[0] = 50;
+#endif
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    MyAssert(CountStaleRoutes()==1,"A route heard again from its next hop stayed stale");
+    MyAssert(RefreshStaleRoutes(nbrs.nbrcost[0].nbr, 1)==0,"A route heard again was expired");
+    unsigned int worsenedBefore = GetWorsenedVersion();
+    MyAssert(RefreshStaleRoutes(nbrs.nbrcost[1].nbr, 1)==1,"A route left out of a whole table was not expired");
+    MyAssert((routingTable[i].cost==INFINITY && CountStaleRoutes()==0 && GetWorsenedVersion()>worsenedBefore),"Expired route is not unreachable");
+
+    DestroyRoutingCtx(restoredCtx);
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    return 0;
+}
+
+int TestFailover() {
+
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // Neighbor 1 reaches 7 and 8 directly, neighbor 2 reaches 7 at a cost that cannot go through
+    // this router and 8 only at a cost that might
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.no_routes = 2;
+    updpkt.sender_id = 1;
+    updpkt.route[0].dest_id = 7;
+    updpkt.route[0].next_hop = 7;
+    updpkt.route[0].cost = 1;
+    updpkt.route[1].dest_id = 8;
+    updpkt.route[1].next_hop = 8;
+    updpkt.route[1].cost = 2;
+#ifdef PATHVECTOR
+    updpkt.route[0].path_len = 1;
+    updpkt.route[1].path_len = 1;
+    updpkt.route[1].path = 1;
+    RT_UPDATE_PATHS(&updpkt)[0] = 7;
+    RT_UPDATE_PATHS(&updpkt)[1] = 8;
+#endif
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    updpkt.sender_id = 2;
+    updpkt.route[0].cost = 4;
+    updpkt.route[1].next_hop = 1;
+    updpkt.route[1].cost = 10;
+#ifdef PATHVECTOR
+    // The path of neighbor 2 to 8 comes back through this router
+    updpkt.route[1].path_len = 3;
+    RT_UPDATE_PATHS(&updpkt)[1] = MyRouterId;
+    RT_UPDATE_PATHS(&updpkt)[2] = 1;
+    RT_UPDATE_PATHS(&updpkt)[3] = 8;
+#endif
+    MyAssert(UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId)==0,"Costlier routes of the second neighbor replaced cheaper ones");
+
+    // Neighbor 1 dies, 7 moves to neighbor 2 at once and 8 has no loop free alternate
+    UninstallRoutesOnNbrDeath(1);
+    int i, j;
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 7; i++);
+    MyAssert((i<NumRoutes && routingTable[i].next_hop==2 && routingTable[i].cost==7),"Route did not fail over to the other neighbor");
+    for(j=0; j<NumRoutes && routingTable[j].dest_id != 8; j++);
+    MyAssert((j<NumRoutes && routingTable[j].cost==INFINITY),"Route failed over to a neighbor that may loop back");
+#ifdef PATHVECTOR
+    MyAssert((PathNode(routingTable[i].path)->length==2 && PathContains(routingTable[i].path, 2)),"Failed over route kept the dead neighbor's path");
+#endif
+
+    // A cheaper link to neighbor 2 recosts its routes without it resending them
+    unsigned int tableVersion = GetTableVersion();
+    MyAssert(UpdateNbrCost(2, 1, MyRouterId)==1,"Recosting a neighbor's routes changed nothing");
+    MyAssert((routingTable[i].next_hop==2 && routingTable[i].cost==5),"Route was not recosted with the link");
+    for(j=0; j<NumRoutes && routingTable[j].dest_id != 2; j++);
+    MyAssert((j<NumRoutes && routingTable[j].cost==1 && GetTableVersion()>tableVersion),"Direct route did not follow the link cost");
+    DestroyRoutingCtx(ctx);
+
+#ifndef PATHVECTOR
+    // Neighbor 1 reaches 11 for 1, 5 in all, and neighbor 2 advertises 6, which may go through this
+    // router. 11 gets worse twice, the second time past what neighbor 2 offers, yet neighbor 2 never
+    // advertised less than the 5 this router paid and stays no alternate.
+    ctx = CreateRoutingCtx();
+    SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.no_routes = 1;
+    updpkt.sender_id = 1;
+    updpkt.route[0].dest_id = 11;
+    updpkt.route[0].next_hop = 11;
+    updpkt.route[0].cost = 1;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    updpkt.sender_id = 2;
+    updpkt.route[0].cost = 6;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    updpkt.sender_id = 1;
+    updpkt.route[0].cost = 4;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 11; i++);
+    MyAssert((i<NumRoutes && routingTable[i].next_hop==1 && routingTable[i].cost==8),"Route failed over to a neighbor that may loop back");
+    updpkt.route[0].cost = 8;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    MyAssert((routingTable[i].next_hop==1 && routingTable[i].cost==12),"Route worsened twice failed over to a neighbor it may have paid more than");
+    DestroyRoutingCtx(ctx);
+#endif
+
+    SelectRoutingCtx(previous);
+    return 0;
+}
+
+int TestEqualCostHops() {
+
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // Both neighbors reach 9 for a total of 6
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 9;
+    updpkt.route[0].next_hop = 9;
+#ifdef PATHVECTOR
+    updpkt.route[0].path_len = 1;
+    RT_UPDATE_PATHS(&updpkt)[0] = 9;
+#endif
+    updpkt.sender_id = 1;
+    updpkt.route[0].cost = 2;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+    updpkt.sender_id = 2;
+    updpkt.route[0].cost = 3;
+    unsigned int tableVersion = GetTableVersion();
+    MyAssert(UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId)==0,"An equal cost next hop counted as a route change");
+    MyAssert(GetTableVersion()>tableVersion,"An equal cost next hop was not stamped for the FIB");
+    unsigned int hops[MAX_NEXT_HOPS];
+    MyAssert((GetNextHops(9, hops)==2 && hops[0]==1 && hops[1]==2),"Equal cost next hops are wrong");
+
+    // The FIB keeps a flow on one next hop and spreads flows over both
+    struct fib *fib = FibCreate();
+    FibSync(fib);
+    MyAssert(FibLookup(fib, 9)==1,"FIB lookup did not return the route's next hop");
+    int i, perHop[3] = {0, 0, 0};
+    for(i=0; i<1000; i++) {
+        unsigned int hop = FibLookupFlow(fib, 9, i);
+        MyAssert((hop==1 || hop==2) && FibLookupFlow(fib, 9, i)==hop,"Flow lookup left the hop set or moved a flow");
+        perHop[hop] += 1;
+    }
+    MyAssert((perHop[1]>400 && perHop[2]>400),"Flows were not spread over the equal cost next hops");
+
+    // A costlier route takes neighbor 2 out of the set
+    updpkt.route[0].cost = 5;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    MyAssert((GetNextHops(9, hops)==1 && FibSync(fib)==1 && FibLookupFlow(fib, 9, 7)==1),"A next hop stayed after it got costlier");
+
+    // Once neighbor 1 dies its equal cost peer carries the route at the same cost
+    updpkt.route[0].cost = 3;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    UninstallRoutesOnNbrDeath(1);
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 9; i++);
+    MyAssert((GetNextHops(9, hops)==1 && hops[0]==2 && routingTable[i].cost==6),"Route did not move to its equal cost next hop");
+    FibSync(fib);
+    MyAssert(FibLookupFlow(fib, 9, 7)==2,"FIB kept the dead next hop");
+
+    FibDestroy(fib);
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    return 0;
+}
+
+#ifndef PATHVECTOR
+int TestSummaries() {
+
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // 20 to 29 go through 50 at cost 3, then 30 costs more and 31 and 32 go elsewhere
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 1;
+    int i;
+    for(i=0; i<13; i++) {
+        updpkt.route[i].dest_id = 20 + i;
+        updpkt.route[i].next_hop = (i < 11) ? 50 : 51;
+        updpkt.route[i].cost = (i < 10) ? 3 : 4;
+    }
+    updpkt.route[13].dest_id = 40;
+    updpkt.route[13].next_hop = 50;
+    updpkt.route[13].cost = 3;
+    updpkt.no_routes = 14;
+    MyAssert(SummarizeFragment(&updpkt)==4,"Fragment was not summarized into four routes");
+    MyAssert((updpkt.route[0].dest_id==20 && ROUTE_RANGE(&updpkt.route[0])==9 && ROUTE_COST(&updpkt.route[0])==3),"Summary of 20 to 29 is wrong");
+    MyAssert((updpkt.route[1].dest_id==30 && ROUTE_RANGE(&updpkt.route[1])==0),"Costlier route joined the summary");
+    MyAssert((updpkt.route[2].dest_id==31 && ROUTE_RANGE(&updpkt.route[2])==1 && updpkt.route[3].dest_id==40),"Routes after the summary are wrong");
+
+    // The receiver installs every destination a summary covers
+    MyAssert(UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId)==1,"Summaries did not change the table");
+    MyAssert(NumRoutes==3+14,"Summaries were not expanded into a route per destination");
+    for(i=0; i<NumRoutes; i++) {
+        unsigned int dest = routingTable[i].dest_id;
+        if(dest >= 20) {
+            MyAssert((routingTable[i].next_hop==1 && routingTable[i].cost==((dest < 30 || dest == 40) ? 7u : 8u)),"Expanded route is wrong");
+        }
+    }
+
+    // Sent to neighbor 2, 20 to 29 cost 7. Poisoned for neighbor 1, 20 to 32 all cost INFINITY.
+    struct route_snapshot *snapshot = SnapshotRoutingTbl();
+    int cursor = -1;
+    size_t pktSize;
+    struct pkt_RT_UPDATE resultpkt;
+    int routeCount = EncodeSnapshotFragment(snapshot, &resultpkt, 0, &cursor, 2, 1, &pktSize);
+    MyAssert((cursor==snapshot->num_routes && routeCount<snapshot->num_routes && pktSize==RT_UPDATE_PKTSIZE(routeCount)),"Snapshot was not summarized");
+    for(i=0; i<routeCount && ntohl(resultpkt.route[i].dest_id)!=20; i++);
+    unsigned int cost = ntohl(resultpkt.route[i].cost);
+    MyAssert((i<routeCount && cost>>ROUTE_RANGE_SHIFT==9 && (cost & ((1u << ROUTE_RANGE_SHIFT) - 1))==7),"Snapshot summary of 20 to 29 is wrong");
+    cursor = -1;
+    routeCount = EncodeSnapshotFragment(snapshot, &resultpkt, 0, &cursor, 1, 1, &pktSize);
+    for(i=0; i<routeCount && ntohl(resultpkt.route[i].dest_id)!=20; i++);
+    MyAssert((i<routeCount && ntohl(resultpkt.route[i].cost)==((12u << ROUTE_RANGE_SHIFT) | INFINITY)),"Poisoned summary is wrong");
+    FreeRouteSnapshot(snapshot);
+
+    // Past the limit a summary of the widest block adds nothing, routes already known are still applied
+    SetSummaryLimit(NumRoutes + 5);
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 2;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 20;
+    updpkt.route[0].next_hop = 60;
+    updpkt.route[0].cost = (MAX_ROUTE_RANGE << ROUTE_RANGE_SHIFT) | 1;
+    MyAssert(UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId)==1,"Clamped summary did not change the table");
+    MyAssert((NumRoutes==3+14+5 && CountClampedSummaries()==1),"Summary added routes past the limit");
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 32; i++);
+    MyAssert((i<NumRoutes && routingTable[i].next_hop==2 && routingTable[i].cost==4),"Known route in a clamped summary was not applied");
+
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    return 0;
+}
+#endif
+
+#ifdef PATHVECTOR
+int TestPaths() {
+
+    unsigned int hops[4];
+    int pathsBefore = PathCount();
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // Neighbor 1 reaches 3 directly and 5 through 3, both paths share the same words
+    struct pkt_RT_UPDATE updpkt, resultpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 1;
+    updpkt.no_routes = 2;
+    updpkt.route[0].dest_id = 3;
+    updpkt.route[0].next_hop = 3;
+    updpkt.route[0].cost = 1;
+    updpkt.route[0].path_len = 1;
+    updpkt.route[1].dest_id = 5;
+    updpkt.route[1].next_hop = 3;
+    updpkt.route[1].cost = 2;
+    updpkt.route[1].path_len = 2;
+    RT_UPDATE_PATHS(&updpkt)[0] = 3;
+    RT_UPDATE_PATHS(&updpkt)[1] = 5;
+    MyAssert(size_pkt_RT_UPDATE(&updpkt)==RT_UPDATE_PKTSIZE(2) + 2 * sizeof(unsigned int),"Incorrect size of an update with paths");
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+
+    struct route_entry *to3 = NULL, *to5 = NULL;
+    int i;
+    for(i=0; i<NumRoutes; i++) {
+        if(routingTable[i].dest_id == 3)
+            to3 = &routingTable[i];
+        if(routingTable[i].dest_id == 5)
+            to5 = &routingTable[i];
+    }
+    MyAssert((to3 != NULL && to5 != NULL && to5->path_len == 3),"Route with a path not installed");
+    PathCopyHops(to5->path, hops);
+    MyAssert((hops[0]==1 && hops[1]==3 && hops[2]==5),"Installed path does not go through the sender");
+    MyAssert(PathNode(to5->path)->parent==to3->path,"Paths starting alike are not shared");
+
+    // Sent on, the path to 5 extends the words of the path to 3: 1, 2, 1 3 5
+    int cursor = -1;
+    ConvertChangestoFragment(&resultpkt, MyRouterId, 0, &cursor);
+    MyAssert(size_pkt_RT_UPDATE(&resultpkt)==RT_UPDATE_PKTSIZE(resultpkt.no_routes) + 5 * sizeof(unsigned int),"Paths in an update were not shared");
+    resultpkt.dest_id = 2;
+    hton_pkt_RT_UPDATE(&resultpkt);
+    ntoh_pkt_RT_UPDATE(&resultpkt);
+
+    // Neighbor 2 learns the path through this router
+    struct routing_ctx *nbrCtx = CreateRoutingCtx();
+    SelectRoutingCtx(nbrCtx);
+    bzero((char *)&updpkt, sizeof(updpkt));
+    InitRoutingTbl((struct pkt_INIT_RESPONSE *)&updpkt, 2);
+    UpdateRoutes(&resultpkt, 1, 2);
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 5; i++);
+    MyAssert((i < NumRoutes && routingTable[i].path_len == 4),"Path lost on the wire");
+    PathCopyHops(routingTable[i].path, hops);
+    MyAssert((hops[0]==0 && hops[1]==1 && hops[2]==3 && hops[3]==5),"Incorrect path after a round trip");
+
+    DestroyRoutingCtx(nbrCtx);
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    MyAssert(PathCount()==pathsBefore,"Paths of destroyed routing tables were not freed");
+    return 0;
+}
+
+int TestPathLoops() {
+
+    struct routing_ctx *ctx = CreateRoutingCtx();
+    struct routing_ctx *previous = SelectRoutingCtx(ctx);
+    InitRoutingTbl(&nbrs, MyRouterId);
+
+    // Neighbor 1 reaches 7 directly
+    struct pkt_RT_UPDATE updpkt;
+    bzero((char *)&updpkt, sizeof(updpkt));
+    updpkt.sender_id = 1;
+    updpkt.no_routes = 1;
+    updpkt.route[0].dest_id = 7;
+    updpkt.route[0].next_hop = 7;
+    updpkt.route[0].cost = 1;
+    updpkt.route[0].path_len = 1;
+    RT_UPDATE_PATHS(&updpkt)[0] = 7;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[0].cost, MyRouterId);
+
+    // Neighbor 2 offers a cheaper route to 7 whose path comes back through this router
+    updpkt.sender_id = 2;
+    updpkt.route[0].next_hop = 1;
+    updpkt.route[0].cost = 0;
+    updpkt.route[0].path_len = 3;
+    RT_UPDATE_PATHS(&updpkt)[0] = MyRouterId;
+    RT_UPDATE_PATHS(&updpkt)[1] = 1;
+    RT_UPDATE_PATHS(&updpkt)[2] = 7;
+    MyAssert(UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId)==0,"A looping path replaced a loop free one");
+
+    // Once neighbor 1 dies the stale route of neighbor 2 must not be counted up from
+    UninstallRoutesOnNbrDeath(1);
+    updpkt.route[0].cost = 2;
+    UpdateRoutes(&updpkt, nbrs.nbrcost[1].cost, MyRouterId);
+    int i;
+    for(i=0; i<NumRoutes && routingTable[i].dest_id != 7; i++);
+    MyAssert((i < NumRoutes && routingTable[i].cost == INFINITY),"A route through a looping path was installed");
+    MyAssert(PathContains(routingTable[i].path, 1) && !PathContains(routingTable[i].path, MyRouterId + 128),"Path membership is wrong");
+
+    DestroyRoutingCtx(ctx);
+    SelectRoutingCtx(previous);
+    return 0;
+}
+#endif
 
 int main (int argc, char *argv[])
 {
@@ -186,6 +884,73 @@ int main (int argc, char *argv[])
     TestSplitHorizon();
     printf("Test Case 5: PASS Split horizon rule taken care\n");
 
+//Testing Growth Beyond MAX_ROUTERS
+
+    TestLargeTable();
+    printf("Test Case 6: PASS Routing table grew to %d routes\n", NumRoutes);
+
+//Testing Fragmentation of a Large Routing Table
+
+    TestFragments();
+    printf("Test Case 7: PASS Routing table split into fragments\n");
+
+//Testing Delta Updates
+
+    TestDeltaUpdate();
+    printf("Test Case 8: PASS Delta update carried only the changed route\n");
+
+//Testing Bulk Byte Order Conversion
+
+    TestSwapKernels();
+    printf("Test Case 9: PASS Byte swap kernels agree, using %s\n", swap_kernel_name());
+
+//Testing Detection of Worsened Routes
+
+    TestWorsenedVersion();
+    printf("Test Case 10: PASS Routes getting worse advance the worsened version\n");
+
+//Testing the Diff Only Routing Log
+
+    TestRouteLog();
+    printf("Test Case 11: PASS Routing log holds the table once, then only changes\n");
+
+//Testing the Forwarding Table
+
+    TestFib();
+    printf("Test Case 12: PASS FIB matches the routing table and syncs only changes\n");
+
+//Testing the Warm Start Checkpoint
+
+    TestCheckpoint();
+    printf("Test Case 13: PASS Checkpoint restores the table with routes stale until refreshed\n");
+
+//Testing Failover to Other Neighbors' Routes
+
+    TestFailover();
+    printf("Test Case 14: PASS Routes move to a loop free alternate as soon as their next hop dies\n");
+
+//Testing Equal Cost Multipath
+
+    TestEqualCostHops();
+    printf("Test Case 15: PASS Equal cost next hops are kept and flows spread over them\n");
+
+#ifdef PATHVECTOR
+//Testing Shared Path Storage
+
+    TestPaths();
+    printf("Test Case 16: PASS Paths are shared in memory and on the wire\n");
+
+//Testing Path Vector Loop Detection
+
+    TestPathLoops();
+    printf("Test Case 17: PASS Paths through this router are rejected as loops\n");
+#else
+//Testing Summary Routes
+
+    TestSummaries();
+    printf("Test Case 16: PASS Summaries stand for every destination of their block\n");
+#endif
+
 return 0;
 
 }